@@ -1,8 +1,8 @@
+// each particle's point sprite size in pixels comes in gl_Vertex.w
 void main() {
 
-    gl_Position   = gl_ModelViewProjectionMatrix * gl_Vertex;
-	float size    = gl_Normal.x;
-    gl_PointSize  = size;
+    gl_Position   = gl_ModelViewProjectionMatrix * vec4(gl_Vertex.xyz, 1.0);
+    gl_PointSize  = gl_Vertex.w;
     gl_FrontColor = gl_Color;
 
 }
\ No newline at end of file
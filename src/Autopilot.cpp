@@ -0,0 +1,340 @@
+#include "Autopilot.h"
+#include "BatchRunner.h"
+
+Autopilot::Autopilot() {
+	horizon = 600;
+	maxSteps = 60 * 90;
+	maxBatch = 8;
+	threads = max(1, (int)std::thread::hardware_concurrency() / 2);
+}
+
+Autopilot::~Autopilot() {
+	stopPool();
+}
+
+//  threads - 1 worker threads, waiting for the next round
+//
+void Autopilot::startPool() {
+	stopPool();
+	for (int t = 1; t < threads; t++)
+		pool.push_back(std::thread(&Autopilot::poolThread, this, t, round));
+}
+
+void Autopilot::stopPool() {
+	if (pool.empty()) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (int t = 0; t < pool.size(); t++)
+		pool[t].join();
+	pool.clear();
+	quit = false;
+}
+
+//  worker thread t: thread t's share of each round after "seen", until
+//  told to quit
+//
+void Autopilot::poolThread(int t, uint64_t seen) {
+	while (true) {
+		const LanderSim *sim;
+		float dt, now;
+		Clock::time_point deadline;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this, seen]() { return quit || round != seen; });
+			if (quit) return;
+			seen = round;
+			sim = roundSim;
+			dt = roundDt;
+			now = roundNow;
+			deadline = roundDeadline;
+		}
+		worker(t, *sim, dt, now, deadline);
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--running == 0) done.notify_one();
+	}
+}
+
+//  new plan for sim's lander: aim for the landing zone nearest to it, and
+//  fly the scripted pilot until improve() has something better
+//
+void Autopilot::start(const LanderSim &sim) {
+	float nearest = FLT_MAX;
+	for (int i = 0; i < sim.zones.size(); i++) {
+		glm::vec3 light = sim.zones[i].lightPos;
+		float d = glm::length(glm::vec3(light.x - sim.pos.x, 0, light.z - sim.pos.z));
+		if (d < nearest) {
+			nearest = d;
+			target = glm::vec3(light.x, 0, light.z);
+		}
+	}
+	best = AutopilotPlan();
+}
+
+//  cost of where a rollout ended.  Landing in a spotlight always beats not
+//  landing, and among landings the one with the most fuel left wins.
+//
+float Autopilot::cost(LanderOutcome outcome, float fuelLeft, const glm::vec3 &pos, const glm::vec3 &target) {
+	float dist = glm::length(glm::vec3(pos.x - target.x, 0, pos.z - target.z));
+	switch (outcome) {
+	case LanderLanded:   return -fuelLeft;
+	case LanderFlying:   return 1000 + dist;
+	case LanderMissed:   return 2000 + dist;
+	default:             return 3000 + dist;
+	}
+}
+
+//  search for a better plan from sim's state for budgetMs ms, on the
+//  caller's thread and the pool's.  now is sim's time (the end of its last
+//  step) and dt the step size.  True if the plan changed.
+//
+bool Autopilot::improve(const LanderSim &sim, float dt, float now, double budgetMs) {
+	Clock::time_point start = Clock::now();
+	if (sim.outcome() != LanderFlying)
+		return false;
+	Clock::time_point deadline = start + std::chrono::microseconds((int64_t)(budgetMs * 1000));
+
+	if (pool.size() != threads - 1)
+		startPool();
+	batches.resize(threads);
+	rolloutMs.resize(threads, 1.0);
+	float before = best.cost;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		roundSim = &sim;
+		roundDt = dt;
+		roundNow = now;
+		roundDeadline = deadline;
+		running = pool.size();
+		round++;
+	}
+	wake.notify_all();
+	worker(0, sim, dt, now, deadline);
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this]() { return running == 0; });
+	}
+	calls++;
+
+	lastMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	return best.cost != before;
+}
+
+//  a change to a plan: a control on or off for a span of steps, or another
+//  descent rate for the scripted pilot, who then takes over sooner
+//
+AutopilotPlan Autopilot::mutate(const AutopilotPlan &plan, Rng &rng) const {
+	AutopilotPlan m;
+	m.inputs = plan.inputs;
+	m.descentRate = plan.descentRate;
+	int n = m.inputs.size();
+	int kind = n > 0 ? rng.next() % 4 : 3;
+	if (kind < 3) {
+		int first = rng.next() % n;
+		int last = min(n, first + 1 + (int)(rng.next() % 60));
+		uint8_t bit = kind == 0 ? 1 << (rng.next() % 5) : LanderInput::Thrust;
+		for (int k = first; k < last; k++) {
+			if (kind == 0) m.inputs[k] ^= bit;
+			else if (kind == 1) m.inputs[k] &= ~bit;
+			else m.inputs[k] |= bit;
+		}
+	}
+	else {
+		m.descentRate = ofClamp(plan.descentRate + rng.uniform(-0.1, 0.1), 0.05, 1);
+		m.inputs.resize(n > 0 ? rng.next() % n : 0);
+	}
+	return m;
+}
+
+//  thread t's share of improve(): rounds of rollouts until the deadline,
+//  as many in a round as the time left allows.  Once a round has finished,
+//  one that can't isn't started.
+//
+void Autopilot::worker(int t, const LanderSim &sim, float dt, float now, Clock::time_point deadline) {
+	LanderBatch &batch = batches[t];
+	batch.shared = sim;
+	batch.shared.measureAltitude = true;    // the scripted pilot steers by it
+	Rng rng(Rng::defaultSeed ^ (calls * threads + t));
+
+	vector<AutopilotPlan> plans;
+	bool finished = false;
+	while (Clock::now() < deadline) {
+		double leftMs = std::chrono::duration<double, std::milli>(deadline - Clock::now()).count();
+		if (finished && leftMs < rolloutMs[t])
+			break;
+		int n = ofClamp(leftMs / rolloutMs[t], 1, maxBatch);
+
+		AutopilotPlan current;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			current = best;
+		}
+		plans.clear();
+		for (int i = 0; i < n; i++) {
+			if (t == 0 && i == 0 && !current.evaluated())
+				plans.push_back(current);
+			else if (!current.evaluated() || rng.uniform() < 0.25) {
+				plans.push_back(AutopilotPlan());
+				plans.back().descentRate = rng.uniform(0.1, 0.6);
+			}
+			else
+				plans.push_back(mutate(current, rng));
+		}
+
+		// fly them together, recording the scripted pilot's inputs up to
+		// the horizon
+		//
+		Clock::time_point roundStart = Clock::now();
+		batch.resize(n);
+		for (int i = 0; i < n; i++) {
+			batch.fromSim(i, sim);
+			batch.id[i] = i;
+		}
+		int flying = n;
+		float time = now;
+		bool cut = false;
+		for (int k = 0; k < maxSteps && flying > 0; k++) {
+			if (Clock::now() > deadline) {
+				cut = true;
+				break;
+			}
+			time += dt;
+			for (int i = 0; i < flying; i++) {
+				AutopilotPlan &plan = plans[batch.id[i]];
+				if (k < plan.inputs.size())
+					batch.input[i] = plan.inputs[k];
+				else {
+					batch.input[i] = BatchRunner::scriptedInput(batch, i, target, plan.descentRate).bits();
+					if (k < horizon)
+						plan.inputs.push_back(batch.input[i]);
+				}
+			}
+			batch.step(0, flying, dt, time);
+			int still = batch.compact(0, flying);
+			for (int i = still; i < flying; i++)
+				plans[batch.id[i]].steps = k + 1;
+			flying = still;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (cut) {
+			abandoned += n;
+			break;
+		}
+		rolloutMs[t] = max(0.01, std::chrono::duration<double, std::milli>(Clock::now() - roundStart).count() / n);
+		rollouts += n;
+		finished = true;
+		for (int i = 0; i < n; i++) {
+			AutopilotPlan &plan = plans[batch.id[i]];
+			if (batch.outcome(i) == LanderFlying)
+				plan.steps = maxSteps;
+			plan.outcome = batch.outcome(i);
+			plan.fuelLeft = batch.fuelLevel[i];
+			plan.cost = cost(plan.outcome, plan.fuelLeft, batch.position(i), target);
+			if (plan.inputs.size() > plan.steps)
+				plan.inputs.resize(plan.steps);
+			if (plan.cost < best.cost)
+				best = plan;
+		}
+	}
+}
+
+//  input for sim's next step, off the front of the plan.  With no plan
+//  the scripted pilot steers by sim.altitude, as in the rollouts, so sim
+//  should be measuring it (measureAltitude).
+//
+LanderInput Autopilot::next(const LanderSim &sim) {
+	if (best.inputs.empty())
+		return BatchRunner::scriptedInput(sim, target, best.descentRate);
+	uint8_t bits = best.inputs.front();
+	best.inputs.erase(best.inputs.begin());
+	best.steps--;
+	return LanderInput::fromBits(bits);
+}
+
+//  command line entry point for --autopilot
+//
+int Autopilot::main(int argc, char *argv[]) {
+	int runs = 5;
+	double budget = 4;
+	int threads = 0;
+	uint64_t seed = 1;
+	string terrainFile = ofToDataPath("geo/moonTerrain_size2.obj");
+
+	for (int i = 2; i + 1 < argc; i += 2) {
+		string opt = argv[i];
+		if (opt == "--runs") runs = atoi(argv[i + 1]);
+		else if (opt == "--budget") budget = atof(argv[i + 1]);
+		else if (opt == "--threads") threads = atoi(argv[i + 1]);
+		else if (opt == "--seed") seed = strtoull(argv[i + 1], NULL, 10);
+		else if (opt == "--terrain") terrainFile = argv[i + 1];
+		else {
+			cout << "unknown option: " << opt << endl;
+			return 1;
+		}
+	}
+
+	BatchRunner runner;
+	if (!runner.setup(terrainFile, ofToDataPath("geo/ufo.obj")))
+		return 1;
+	Autopilot autopilot;
+	if (threads > 0) autopilot.threads = threads;
+	cout << "flying " << runs << " landings with the autopilot (" << budget << " ms per step on "
+		<< autopilot.threads << " threads) and the scripted pilot" << endl;
+
+	LanderSim sim;
+	sim.setup(&runner.octree, runner.landerMin, runner.landerMax);
+	BatchStats autoStats, scriptedStats;
+	float autoFuel = 0, scriptedFuel = 0;
+	double worstMs = 0, totalMs = 0;
+	uint64_t calls = 0;
+	int asPlanned = 0;
+	for (int r = 0; r < runs; r++) {
+		uint64_t steps = 0;
+		LanderOutcome scripted = runner.fly(sim, seed + r, steps);
+		scriptedStats.add(scripted);
+		float scriptedLeft = sim.fuelLevel;
+
+		// the same start and turbulence
+		//
+		ScriptedLanding landing(seed + r, sim.zones);
+		sim.rng.setSeed(landing.simSeed);
+		sim.reset(landing.start);
+		autopilot.start(sim);
+		float fuel = sim.fuelLevel;
+		float now = 0;
+		AutopilotPlan planned;
+		steps = 0;
+		while (now < runner.maxTime && sim.outcome() == LanderFlying) {
+			autopilot.improve(sim, runner.stepSize, now, budget);
+			worstMs = max(worstMs, autopilot.lastMs);
+			totalMs += autopilot.lastMs;
+			calls++;
+			planned = autopilot.plan();
+
+			now += runner.stepSize;
+			sim.step(runner.stepSize, now, autopilot.next(sim));
+			steps++;
+		}
+		autoStats.add(sim.outcome());
+		autoStats.steps += steps;
+		float used = fuel - sim.fuelLevel;
+		float scriptedUsed = fuel - scriptedLeft;
+		if (sim.outcome() == LanderLanded) autoFuel += used;
+		if (scripted == LanderLanded) scriptedFuel += scriptedUsed;
+		if (planned.evaluated() && planned.outcome == sim.outcome() && planned.fuelLeft == sim.fuelLevel)
+			asPlanned++;
+
+		cout << "  landing " << r << ": autopilot " << LanderSim::outcomeName(sim.outcome()) << ", " << ofToString(used, 1)
+			<< " fuel in " << steps << " steps;  scripted " << LanderSim::outcomeName(scripted) << ", " << ofToString(scriptedUsed, 1) << " fuel" << endl;
+	}
+	cout << "autopilot: " << autoStats.landed << " of " << runs << " landed, " << ofToString(autoFuel / max(autoStats.landed, 1), 1)
+		<< " fuel per landing, " << asPlanned << " ended as last planned" << endl;
+	cout << "scripted:  " << scriptedStats.landed << " of " << runs << " landed, " << ofToString(scriptedFuel / max(scriptedStats.landed, 1), 1)
+		<< " fuel per landing" << endl;
+	cout << "planning: " << ofToString(totalMs / max(calls, (uint64_t)1), 2) << " ms mean, " << ofToString(worstMs, 2) << " ms worst per step, "
+		<< autopilot.rollouts << " rollouts, " << autopilot.abandoned << " cut off by the budget" << endl;
+	return 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "ofMain.h"
+#include "LanderSim.h"
+#include "LanderBatch.h"
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+//  Autopilot - lands in the nearest spotlight on as little fuel as it can
+//  find, by search on the simulation itself.
+//
+//  A plan is an input for each of the next "horizon" steps, after which
+//  the scripted pilot (BatchRunner::scriptedInput()) flies on towards the
+//  target with the plan's descent rate.  improve() rolls candidate plans
+//  out from the lander's current state, a LanderBatch per thread - the
+//  caller's and threads - 1 workers started by the first call, which wait
+//  between calls for the next one:
+//
+//      seeds       the scripted pilot at a random descent rate
+//      mutations   of the best plan so far - a control switched on or
+//                  off for a span of steps, or another descent rate
+//
+//  and keeps the cheapest (cost()).  The simulation is deterministic and
+//  the rollouts take the lander's Rng along, so flying the plan ends
+//  exactly as its rollout did - unless the lander is moved by hand.  The
+//  cost is of the state the plan ends in (fuel left, not fuel used), so
+//  it stays comparable while the plan is being flown and next() takes its
+//  inputs off the front.
+//
+//  improve() is anytime: it stops at its time budget, in the middle of a
+//  rollout if it has to, so a frame's time stays bounded, and there is
+//  always a plan to fly (before the first rollout, the scripted pilot's).
+//
+//      <app> --autopilot [--runs N] [--budget ms] [--threads T] [--seed S] [--terrain file.obj]
+//
+//  flies landings headless, calling improve() once per step as the game
+//  does once per frame, and compares them with the scripted pilot's from
+//  the same starts.
+//
+
+struct AutopilotPlan {
+	vector<uint8_t> inputs;     // LanderInput::bits() of the next steps
+	float descentRate = 0.3;    // of the scripted pilot after them
+
+	// what the rollout came to
+	//
+	float cost = FLT_MAX;
+	LanderOutcome outcome = LanderFlying;
+	float fuelLeft = 0;
+	int steps = 0;              // to the outcome, from now
+
+	bool evaluated() const { return cost < FLT_MAX; }
+};
+
+class Autopilot {
+public:
+	Autopilot();
+	~Autopilot();
+
+	void start(const LanderSim &sim);
+	bool improve(const LanderSim &sim, float dt, float now, double budgetMs);
+	LanderInput next(const LanderSim &sim);
+
+	const AutopilotPlan & plan() const { return best; }
+	static float cost(LanderOutcome outcome, float fuelLeft, const glm::vec3 &pos, const glm::vec3 &target);
+	static int main(int argc, char *argv[]);
+
+	glm::vec3 target;           // on the ground below the nearest landing zone's light
+	int horizon;                // steps of a plan given input by input
+	int maxSteps;               // length of a rollout
+	int maxBatch;               // rollouts a thread flies together
+	int threads;                // including the caller's
+
+	uint64_t rollouts = 0;      // finished
+	uint64_t abandoned = 0;     // cut off by the budget
+	double lastMs = 0;          // time the last improve() took
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	void worker(int t, const LanderSim &sim, float dt, float now, Clock::time_point deadline);
+	void poolThread(int t, uint64_t seen);
+	void startPool();
+	void stopPool();
+	AutopilotPlan mutate(const AutopilotPlan &plan, Rng &rng) const;
+
+	AutopilotPlan best;
+	std::mutex mutex;
+	vector<LanderBatch> batches;    // per thread, kept between calls
+	vector<double> rolloutMs;       // per thread, time a rollout took
+	uint64_t calls = 0;
+
+	// the worker threads and the improve() call they are on, under mutex
+	//
+	vector<std::thread> pool;
+	std::condition_variable wake;   // a new round, or quit
+	std::condition_variable done;   // running went to 0
+	uint64_t round = 0;             // improve() calls handed to the pool
+	int running = 0;                // pool threads not done with this round
+	bool quit = false;
+	const LanderSim *roundSim = NULL;
+	float roundDt = 0, roundNow = 0;
+	Clock::time_point roundDeadline;
+};
@@ -0,0 +1,306 @@
+
+#include "BatchRunner.h"
+#include "ObjLoader.h"
+#include <thread>
+#include <chrono>
+
+void BatchStats::add(LanderOutcome outcome) {
+	runs++;
+	switch (outcome) {
+	case LanderExploded: exploded++; break;
+	case LanderLanded:   landed++;   break;
+	case LanderMissed:   missed++;   break;
+	default:             timedOut++; break;
+	}
+}
+
+void BatchStats::add(const BatchStats &s) {
+	runs += s.runs;
+	exploded += s.exploded;
+	landed += s.landed;
+	missed += s.missed;
+	timedOut += s.timedOut;
+	steps += s.steps;
+}
+
+void BatchStats::print() const {
+	float n = runs > 0 ? runs : 1;
+	cout << "runs: " << runs << "  time: " << seconds << " sec  ("
+		<< runs / seconds << " landings/sec, " << steps / seconds << " steps/sec)" << endl;
+	cout << "  exploded:            " << exploded << " (" << 100 * exploded / n << "%)" << endl;
+	cout << "  landed in spotlight: " << landed << " (" << 100 * landed / n << "%)" << endl;
+	cout << "  missed:              " << missed << " (" << 100 * missed / n << "%)" << endl;
+	cout << "  timed out:           " << timedOut << " (" << 100 * timedOut / n << "%)" << endl;
+}
+
+BatchRunner::BatchRunner() {
+	stepSize = 1.0 / 60.0;
+	maxTime = 120;
+	blockSize = 64;
+	landerMin = glm::vec3(-1, -1, -1);
+	landerMax = glm::vec3(1, 1, 1);
+}
+
+//  load the terrain into the octree and take the lander bounds from its model
+//
+bool BatchRunner::setup(const string &terrainFile, const string &landerFile) {
+	ofMesh terrain, lander;
+	if (!ObjLoader::loadCached(terrainFile, terrain)) {
+		cout << "can't load terrain: " << terrainFile << endl;
+		return false;
+	}
+	if (!ObjLoader::load(landerFile, lander)) {
+		cout << "can't load lander: " << landerFile << endl;
+		return false;
+	}
+	Box b = Octree::meshBounds(lander);
+	landerMin = b.min().to<glm::vec3>();
+	landerMax = b.max().to<glm::vec3>();
+
+	// the octree takes over the terrain's positions, nothing else is needed
+	//
+	cout << "vertices: " << terrain.getNumVertices() << endl;
+	octree.create(std::make_shared<vector<glm::vec3>>(std::move(terrain.getVertices())), 20);
+	vector<int> remap;
+	octree.reorder(remap);
+	return true;
+}
+
+//  scripted pilot: turn towards the target, fly over it, then come down at
+//  a rate proportional to the altitude.  A larger descentRate lands harder.
+//
+LanderInput BatchRunner::scriptedInput(const glm::vec3 &pos, float rot, const glm::vec3 &velocity, float angularVelocity,
+	float altitude, const glm::vec3 &target, float descentRate) {
+	LanderInput input;
+
+	glm::vec3 to = target - pos;
+	to.y = 0;
+	float dist = glm::length(to);
+	glm::vec3 h = LanderSim::heading(rot);
+
+	// steer - positive rotation turns the heading from +x towards -z
+	//
+	float err = atan2(h.z * to.x - h.x * to.z, h.x * to.x + h.z * to.z);
+	float turnRate = ofClamp(glm::degrees(err) * 1.5, -90, 90);
+	input.left = angularVelocity < turnRate - 5;
+	input.right = angularVelocity > turnRate + 5;
+
+	// fly towards the target once roughly facing it
+	//
+	float speed = glm::dot(velocity, h);
+	float targetSpeed = (fabs(err) < glm::radians(30.0f)) ? min(dist * 0.3f, 8.0f) : 0;
+	input.forward = speed < targetSpeed - 0.5;
+	input.back = speed > targetSpeed + 0.5;
+
+	// hold height until over the target, then descend
+	//
+	float targetVy = -ofClamp(altitude * descentRate, 0.5, 6);
+	if (dist > 15 && altitude < 25) targetVy = 1;
+	input.thrust = velocity.y < targetVy;
+
+	return input;
+}
+
+LanderInput BatchRunner::scriptedInput(const LanderSim &sim, const glm::vec3 &target, float descentRate) {
+	return scriptedInput(sim.pos, sim.rot, sim.velocity, sim.angularVelocity, sim.altitude, target, descentRate);
+}
+
+LanderInput BatchRunner::scriptedInput(const LanderBatch &batch, int i, const glm::vec3 &target, float descentRate) {
+	return scriptedInput(batch.position(i), batch.rot[i], batch.velocity(i), batch.angularVelocity[i], batch.altitude[i],
+		target, descentRate);
+}
+
+//  random start over the terrain, one of the landing zones as target and a
+//  random descent rate
+//
+ScriptedLanding::ScriptedLanding(uint64_t seed, const vector<LandingZone> &zones) {
+	Rng rng(seed);
+	start = rng.uniform(ofVec3f(-150, 40, -150), ofVec3f(150, 80, 150));
+	const LandingZone &zone = zones[rng.next() % zones.size()];
+	target = glm::vec3(zone.lightPos.x, 0, zone.lightPos.z);
+	descentRate = rng.uniform(0.1, 0.6);
+	simSeed = seed ^ 0x5DEECE66DULL;
+}
+
+//  fly one scripted landing from a random start, return the outcome
+//
+LanderOutcome BatchRunner::fly(LanderSim &sim, uint64_t seed, uint64_t &steps) const {
+	ScriptedLanding landing(seed, sim.zones);
+	sim.rng.setSeed(landing.simSeed);
+	sim.reset(landing.start);
+
+	float now = 0;
+	while (now < maxTime) {
+		now += stepSize;
+		sim.step(stepSize, now, scriptedInput(sim, landing.target, landing.descentRate));
+		steps++;
+		if (sim.outcome() != LanderFlying)
+			return sim.outcome();
+	}
+	return LanderFlying;
+}
+
+//  fly "runs" landings split over "threads" threads.  Landing i always uses
+//  seed + i, so results don't depend on the thread count.
+//
+BatchStats BatchRunner::run(int runs, int threads, uint64_t seed) const {
+	if (threads < 1) threads = 1;
+	vector<BatchStats> results(threads);
+	vector<std::thread> workers;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int t = 0; t < threads; t++) {
+		workers.push_back(std::thread([this, t, threads, runs, seed, &results]() {
+			LanderSim sim;
+			sim.setup(&octree, landerMin, landerMax);
+			BatchStats &stats = results[t];
+			for (int i = t; i < runs; i += threads)
+				stats.add(fly(sim, seed + i, stats.steps));
+		}));
+	}
+	for (int t = 0; t < threads; t++)
+		workers[t].join();
+
+	BatchStats total;
+	for (int t = 0; t < threads; t++)
+		total.add(results[t]);
+	total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return total;
+}
+
+//  fly landings [begin, end) of batch together, landing i with seed + i.
+//  Each step is taken only by the landers still flying, which compact()
+//  keeps at the front of the range.
+//
+void BatchRunner::flyBatch(LanderBatch &batch, int begin, int end, uint64_t seed, BatchStats &stats) const {
+	vector<ScriptedLanding> landings;
+	for (int i = begin; i < end; i++) {
+		landings.push_back(ScriptedLanding(seed + i, batch.shared.zones));
+		batch.id[i] = i;
+		batch.rng[i].setSeed(landings.back().simSeed);
+		batch.reset(i, landings.back().start);
+	}
+
+	int flying = end;
+	float now = 0;
+	while (now < maxTime && flying > begin) {
+		now += stepSize;
+		for (int i = begin; i < flying; i++) {
+			const ScriptedLanding &landing = landings[batch.id[i] - begin];
+			batch.input[i] = scriptedInput(batch, i, landing.target, landing.descentRate).bits();
+		}
+		batch.step(begin, flying, stepSize, now);
+		stats.steps += flying - begin;
+		flying = batch.compact(begin, flying);
+	}
+	for (int i = begin; i < end; i++)
+		stats.add(batch.outcome(i));
+}
+
+//  as run(), on one LanderBatch of "runs" landers with a range per thread.
+//  A thread flies its range blockSize landers at a time: the octree queries
+//  dominate a step, and a block's worth of landers keeps the parts of the
+//  tree they use in cache where thousands in lockstep don't.
+//
+BatchStats BatchRunner::runBatched(int runs, int threads, uint64_t seed) const {
+	if (threads < 1) threads = 1;
+	vector<BatchStats> results(threads);
+	vector<std::thread> workers;
+
+	auto start = std::chrono::steady_clock::now();
+	LanderBatch batch;
+	batch.setup(&octree, landerMin, landerMax);
+	batch.resize(runs);
+	for (int t = 0; t < threads; t++) {
+		workers.push_back(std::thread([this, t, threads, runs, seed, &batch, &results]() {
+			int end = runs * (t + 1) / threads;
+			for (int begin = runs * t / threads; begin < end; begin += blockSize)
+				flyBatch(batch, begin, min(begin + blockSize, end), seed, results[t]);
+		}));
+	}
+	for (int t = 0; t < threads; t++)
+		workers[t].join();
+
+	BatchStats total;
+	for (int t = 0; t < threads; t++)
+		total.add(results[t]);
+	total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return total;
+}
+
+//  fly the first "runs" landings on a LanderSim each and together on a
+//  LanderBatch, and count the landers whose final states differ
+//
+int BatchRunner::check(int runs, uint64_t seed) const {
+	LanderBatch batch;
+	batch.setup(&octree, landerMin, landerMax);
+	batch.resize(runs);
+	BatchStats stats;
+	flyBatch(batch, 0, runs, seed, stats);
+
+	vector<uint64_t> batchHash(runs);
+	LanderSim sim;
+	for (int i = 0; i < runs; i++) {
+		batch.toSim(i, sim);
+		batchHash[batch.id[i]] = sim.stateHash();
+	}
+
+	int differ = 0;
+	sim.setup(&octree, landerMin, landerMax);
+	for (int i = 0; i < runs; i++) {
+		uint64_t steps = 0;
+		fly(sim, seed + i, steps);
+		if (sim.stateHash() != batchHash[i]) {
+			if (differ == 0)
+				cout << "  landing " << i << " differs" << endl;
+			differ++;
+		}
+	}
+	cout << "check: " << runs - differ << " of " << runs << " landings identical on LanderSim and LanderBatch" << endl;
+	return differ;
+}
+
+//  command line entry point for --batch
+//
+int BatchRunner::main(int argc, char *argv[]) {
+	int runs = 1000;
+	int threads = std::thread::hardware_concurrency();
+	uint64_t seed = 1;
+	int checkRuns = 0;
+	int blockSize = 0;
+	string engine = "sim";
+	string terrainFile = ofToDataPath("geo/moonTerrain_size2.obj");
+
+	for (int i = 2; i + 1 < argc; i += 2) {
+		string opt = argv[i];
+		if (opt == "--runs") runs = atoi(argv[i + 1]);
+		else if (opt == "--threads") threads = atoi(argv[i + 1]);
+		else if (opt == "--seed") seed = strtoull(argv[i + 1], NULL, 10);
+		else if (opt == "--terrain") terrainFile = argv[i + 1];
+		else if (opt == "--engine") engine = argv[i + 1];
+		else if (opt == "--check") checkRuns = atoi(argv[i + 1]);
+		else if (opt == "--block") blockSize = max(1, atoi(argv[i + 1]));
+		else {
+			cout << "unknown option: " << opt << endl;
+			return 1;
+		}
+	}
+
+	BatchRunner runner;
+	if (!runner.setup(terrainFile, ofToDataPath("geo/ufo.obj")))
+		return 1;
+	if (blockSize > 0)
+		runner.blockSize = blockSize;
+
+	if (engine != "sim" && engine != "soa") {
+		cout << "unknown engine: " << engine << " (sim or soa)" << endl;
+		return 1;
+	}
+	if (checkRuns > 0 && runner.check(checkRuns, seed) > 0)
+		return 2;
+
+	cout << "flying " << runs << " landings on " << threads << " threads (" << engine << ")" << endl;
+	BatchStats stats = engine == "sim" ? runner.run(runs, threads, seed) : runner.runBatched(runs, threads, seed);
+	stats.print();
+	return 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Octree.h"
+#include "LanderSim.h"
+#include "LanderBatch.h"
+
+//  Headless batch runner.  Flies scripted landings on the simulation core
+//  across all cores, with no window or GL context, and reports how they
+//  ended.  Started from the command line:
+//
+//      <app> --batch [--runs N] [--threads T] [--seed S] [--terrain file.obj]
+//                    [--engine sim|soa] [--block N] [--check N]
+//
+//  --engine sim flies each landing on a LanderSim, one after the other;
+//  soa flies a thread's landings on a LanderBatch, --block of them at a
+//  time.  Both give the same results.  --check N flies the first N
+//  landings on both and compares their final states.
+//
+
+//  Outcome counts for a batch
+//
+struct BatchStats {
+	int runs = 0;
+	int exploded = 0;
+	int landed = 0;         // landed in a spotlight
+	int missed = 0;         // landed outside the spotlights
+	int timedOut = 0;       // still flying at maxTime
+	uint64_t steps = 0;
+	double seconds = 0;     // wall clock time for the batch
+
+	void add(LanderOutcome outcome);
+	void add(const BatchStats &s);
+	void print() const;
+};
+
+//  Start and target of a scripted landing, made from its seed
+//
+struct ScriptedLanding {
+	ScriptedLanding(uint64_t seed, const vector<LandingZone> &zones);
+
+	glm::vec3 start;
+	glm::vec3 target;
+	float descentRate;
+	uint64_t simSeed;       // for the lander's Rng
+};
+
+class BatchRunner {
+public:
+	BatchRunner();
+
+	bool setup(const string &terrainFile, const string &landerFile);
+	BatchStats run(int runs, int threads, uint64_t seed) const;
+	BatchStats runBatched(int runs, int threads, uint64_t seed) const;
+	LanderOutcome fly(LanderSim &sim, uint64_t seed, uint64_t &steps) const;
+	void flyBatch(LanderBatch &batch, int begin, int end, uint64_t seed, BatchStats &stats) const;
+	int check(int runs, uint64_t seed) const;
+
+	static LanderInput scriptedInput(const LanderSim &sim, const glm::vec3 &target, float descentRate);
+	static LanderInput scriptedInput(const LanderBatch &batch, int i, const glm::vec3 &target, float descentRate);
+	static LanderInput scriptedInput(const glm::vec3 &pos, float rot, const glm::vec3 &velocity, float angularVelocity,
+		float altitude, const glm::vec3 &target, float descentRate);
+	static int main(int argc, char *argv[]);
+
+	Octree octree;
+	glm::vec3 landerMin, landerMax;
+	float stepSize;     // sec
+	float maxTime;      // sec of simulation time per landing
+	int blockSize;      // landers flown together per LanderBatch range
+};
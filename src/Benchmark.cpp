@@ -0,0 +1,874 @@
+
+#include "Benchmark.h"
+#include "ObjLoader.h"
+#include "GeomBatch.h"
+#include "Octree.h"
+#include "Util.h"
+#include "ParticleBatch.h"
+#include "SpatialHash.h"
+#include "HeightField.h"
+#include "ParticleBackend.h"
+#include <fstream>
+#include "Random.h"
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <filesystem>
+#include "assimp/Importer.hpp"
+#include "assimp/scene.h"
+#include "assimp/postprocess.h"
+
+//  best and mean wall clock time of "iterations" runs of f, in ms
+//
+static void timeRuns(int iterations, const std::function<bool()> &f, double &best, double &mean) {
+	best = DBL_MAX;
+	mean = 0;
+	for (int i = 0; i < iterations; i++) {
+		auto start = std::chrono::steady_clock::now();
+		if (!f()) cout << "  run failed" << endl;
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		best = min(best, ms);
+		mean += ms / iterations;
+	}
+}
+
+static void report(const string &name, double megabytes, double best, double mean) {
+	cout << "  " << name;
+	for (int i = name.size(); i < 24; i++) cout << " ";
+	cout << ofToString(best, 1) << " ms best, " << ofToString(mean, 1) << " ms mean, "
+		<< ofToString(megabytes / (best / 1000), 1) << " MB/s" << endl;
+}
+
+//  time per item, for kernels run over "items" points or boxes per run
+//
+static void reportItems(const string &name, int items, double best, double mean) {
+	cout << "  " << name;
+	for (int i = name.size(); i < 28; i++) cout << " ";
+	cout << ofToString(best * 1e6 / items, 2) << " ns best, " << ofToString(mean * 1e6 / items, 2) << " ns mean" << endl;
+}
+
+//  true if the batch kernels found the same points and boxes as the scalar
+//  ones
+//
+bool Benchmark::mathKernels(int iterations) {
+	const int n = 1 << 20;
+	cout << "math kernels (" << geomBatchSimd() << "), " << n << " items, " << iterations << " iterations" << endl;
+
+	// random points and boxes in a unit cube; the points are read through
+	// shuffled indices, as the octree build does
+	//
+	Rng rng(1234);
+	vector<glm::vec3> points(n);
+	vector<Vector3> vpoints(n);
+	vector<int> indices(n);
+	for (int i = 0; i < n; i++) {
+		points[i] = glm::vec3(rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1));
+		vpoints[i] = Vector3(points[i].x, points[i].y, points[i].z);
+		indices[i] = i;
+	}
+	for (int i = n - 1; i > 0; i--)
+		std::swap(indices[i], indices[rng.next() % (i + 1)]);
+
+	vector<Box> boxes(n);
+	vector<float> bounds[6];
+	for (int k = 0; k < 6; k++) bounds[k].resize(n);
+	for (int i = 0; i < n; i++) {
+		Vector3 c(rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1));
+		Vector3 h(rng.uniform(0.01, 0.2), rng.uniform(0.01, 0.2), rng.uniform(0.01, 0.2));
+		boxes[i] = Box(c - h, c + h);
+		for (int k = 0; k < 3; k++) {
+			bounds[k][i] = boxes[i].parameters[0][k];
+			bounds[k + 3][i] = boxes[i].parameters[1][k];
+		}
+	}
+	BoxArray array = { bounds[0].data(), bounds[1].data(), bounds[2].data(),
+		bounds[3].data(), bounds[4].data(), bounds[5].data(), n };
+
+	Box box(Vector3(-0.6, -0.6, -0.6), Vector3(0.6, 0.6, 0.6));
+	Ray ray(Vector3(-1.5, 0.1, -1.2), Vector3(1, 0.05, 0.8));
+	vector<int> out(n), outScalar(n);
+	vector<uint8_t> hit(n), hitScalar(n);
+	volatile int sink = 0;
+	double best, mean;
+
+	timeRuns(iterations, [&]() {
+		int count = 0;
+		for (int i = 0; i < n; i++) count += box.insideScalar(vpoints[i]);
+		sink = count;
+		return true;
+	}, best, mean);
+	reportItems("Box::inside, scalar", n, best, mean);
+	timeRuns(iterations, [&]() {
+		int count = 0;
+		for (int i = 0; i < n; i++) count += box.inside(vpoints[i]);
+		sink = count;
+		return true;
+	}, best, mean);
+	reportItems("Box::inside", n, best, mean);
+
+	timeRuns(iterations, [&]() {
+		int count = 0;
+		for (int i = 0; i < n; i++) count += box.overlapScalar(boxes[i]);
+		sink = count;
+		return true;
+	}, best, mean);
+	reportItems("Box::overlap, scalar", n, best, mean);
+	timeRuns(iterations, [&]() {
+		int count = 0;
+		for (int i = 0; i < n; i++) count += box.overlap(boxes[i]);
+		sink = count;
+		return true;
+	}, best, mean);
+	reportItems("Box::overlap", n, best, mean);
+
+	timeRuns(iterations, [&]() {
+		int count = 0;
+		for (int i = 0; i < n; i++) count += boxes[i].intersectScalar(ray, 0, FLT_MAX);
+		sink = count;
+		return true;
+	}, best, mean);
+	reportItems("Box::intersect, scalar", n, best, mean);
+	timeRuns(iterations, [&]() {
+		int count = 0;
+		for (int i = 0; i < n; i++) count += boxes[i].intersect(ray, 0, FLT_MAX);
+		sink = count;
+		return true;
+	}, best, mean);
+	reportItems("Box::intersect", n, best, mean);
+
+	int inside[2];
+	timeRuns(iterations, [&]() {
+		inside[0] = pointsInBoxScalar(points.data(), indices.data(), n, box, outScalar.data());
+		return true;
+	}, best, mean);
+	reportItems("pointsInBox, scalar", n, best, mean);
+	timeRuns(iterations, [&]() {
+		inside[1] = pointsInBox(points.data(), indices.data(), n, box, out.data());
+		return true;
+	}, best, mean);
+	reportItems("pointsInBox", n, best, mean);
+	bool same = inside[0] == inside[1] && std::equal(out.begin(), out.begin() + inside[1], outScalar.begin());
+	timeRuns(iterations, [&]() {
+		inside[1] = pointsInBox(points.data(), NULL, n, box, out.data());
+		return true;
+	}, best, mean);
+	reportItems("pointsInBox, contiguous", n, best, mean);
+
+	int hits[2] = { 0, 0 };
+	timeRuns(iterations, [&]() {
+		rayHitsBoxesScalar(ray, array, 0, FLT_MAX, hitScalar.data());
+		return true;
+	}, best, mean);
+	for (int i = 0; i < n; i++) hits[0] += hitScalar[i];
+	reportItems("rayHitsBoxes, scalar", n, best, mean);
+	timeRuns(iterations, [&]() {
+		rayHitsBoxes(ray, array, 0, FLT_MAX, hit.data());
+		return true;
+	}, best, mean);
+	for (int i = 0; i < n; i++) hits[1] += hit[i];
+	reportItems("rayHitsBoxes", n, best, mean);
+
+	cout << "  " << inside[0] << " / " << inside[1] << " points inside, "
+		<< hits[0] << " / " << hits[1] << " boxes hit (scalar / batch)" << endl;
+
+	int boxesDiffer = 0;
+	for (int i = 0; i < n; i++) boxesDiffer += hit[i] != hitScalar[i];
+	if (!same) cout << "  pointsInBox MISMATCH with scalar" << endl;
+	if (boxesDiffer > 0) cout << "  rayHitsBoxes MISMATCH with scalar at " << boxesDiffer << " boxes" << endl;
+	return same && boxesDiffer == 0;
+}
+
+//  difference of b from a, relative to a (absolute below 1); NaN if
+//  either is NaN
+//
+static float difference(float a, float b) {
+	if (std::isnan(a) || std::isnan(b)) return NAN;
+	return fabs(a - b) / max(1.0f, fabs(a));
+}
+
+//  largest difference between a and b's positions, velocities and forces,
+//  and how many of those values differ
+//
+static float maxDifference(const vector<Particle> &a, const vector<Particle> &b, int &differ) {
+	float most = 0;
+	differ = 0;
+	for (int i = 0; i < a.size(); i++) {
+		const ofVec3f *va[3] = { &a[i].position, &a[i].velocity, &a[i].forces };
+		const ofVec3f *vb[3] = { &b[i].position, &b[i].velocity, &b[i].forces };
+		for (int k = 0; k < 3; k++) {
+			for (int c = 0; c < 3; c++) {
+				float d = difference((*va[k])[c], (*vb[k])[c]);
+				most = std::isnan(d) ? d : max(most, d);
+				differ += !(d == 0);
+			}
+		}
+	}
+	return most;
+}
+
+static float maxDifference(const vector<ofVec3f> &a, const vector<ofVec3f> &b, int &differ) {
+	float most = 0;
+	differ = 0;
+	for (int i = 0; i < a.size(); i++) {
+		for (int c = 0; c < 3; c++) {
+			float d = difference(a[i][c], b[i][c]);
+			most = std::isnan(d) ? d : max(most, d);
+			differ += !(d == 0);
+		}
+	}
+	return most;
+}
+
+//  true if the difference is within particleTolerance
+//
+static bool reportDifference(const string &name, float most, int differ) {
+	cout << "  " << name;
+	for (int i = name.size(); i < 28; i++) cout << " ";
+	bool within = most <= Benchmark::particleTolerance;     // false for NaN
+	if (differ == 0) cout << "same as scalar" << endl;
+	else cout << differ << " values differ from scalar, by up to " << most
+		<< (within ? " (within " : " - OVER the tolerance of ") << Benchmark::particleTolerance << (within ? ")" : "") << endl;
+	return within;
+}
+
+//  the particle backends' kernels over the same n random particles.  Each
+//  kernel is run "iterations" times over one array, so the results carry
+//  any difference along and are compared with the scalar backend's at the
+//  end.  True if every backend is within particleTolerance of it.
+//
+bool Benchmark::particleKernels(int n, int iterations) {
+	vector<const ParticleBackend *> backends = ParticleBackend::available();
+	cout << "particle kernels (best: " << ParticleBackend::best().name() << "), " << n << " particles, "
+		<< iterations << " iterations" << endl;
+
+	Rng rng(99);
+	vector<Particle> particles(n);
+	vector<ofVec3f> vectors(n);
+	for (int i = 0; i < n; i++) {
+		Particle &p = particles[i];
+		p.position = rng.uniform(ofVec3f(-100, 0, -100), ofVec3f(100, 50, 100));
+		p.velocity = rng.uniform(ofVec3f(-5, -5, -5), ofVec3f(5, 5, 5));
+		p.acceleration = rng.uniform(ofVec3f(-1, -1, -1), ofVec3f(1, 1, 1));
+		p.forces = rng.uniform(ofVec3f(-10, -10, -10), ofVec3f(10, 10, 10));
+		p.mass = rng.uniform(0.5, 2);
+		p.damping = rng.uniform(0.9, 1);
+		vectors[i] = rng.uniform(ofVec3f(-1, -1, -1), ofVec3f(1, 1, 1));
+	}
+	if (n > 0) vectors[0] = ofVec3f(0, 0, 0);     // normalize() keeps it zero
+
+	vector<Particle> integrated[2], gravity[2], forced[2];
+	vector<ofVec3f> normalized[2];
+	double best, mean;
+	bool within = true;
+	for (int b = 0; b < backends.size(); b++) {
+		const ParticleBackend &backend = *backends[b];
+		string name = backend.name();
+		int r = b > 0;      // results: 0 scalar, 1 this backend
+
+		integrated[r] = particles;
+		timeRuns(iterations, [&]() { backend.integrate(integrated[r].data(), n, 1 / 60.0); return true; }, best, mean);
+		reportItems("integrate, " + name, n, best, mean);
+
+		gravity[r] = particles;
+		timeRuns(iterations, [&]() { backend.addForce(gravity[r].data(), n, ofVec3f(0, -2, 0)); return true; }, best, mean);
+		reportItems("addForce, " + name, n, best, mean);
+
+		forced[r] = particles;
+		timeRuns(iterations, [&]() { backend.addForces(forced[r].data(), n, vectors.data()); return true; }, best, mean);
+		reportItems("addForces, " + name, n, best, mean);
+
+		normalized[r] = vectors;
+		timeRuns(iterations, [&]() { backend.normalize(normalized[r].data(), n, 1.5); return true; }, best, mean);
+		reportItems("normalize, " + name, n, best, mean);
+
+		if (b > 0) {
+			int differ;
+			float most = maxDifference(integrated[0], integrated[1], differ);
+			within &= reportDifference("integrate, " + name, most, differ);
+			most = maxDifference(gravity[0], gravity[1], differ);
+			within &= reportDifference("addForce, " + name, most, differ);
+			most = maxDifference(forced[0], forced[1], differ);
+			within &= reportDifference("addForces, " + name, most, differ);
+			most = maxDifference(normalized[0], normalized[1], differ);
+			within &= reportDifference("normalize, " + name, most, differ);
+		}
+	}
+	return within;
+}
+
+void Benchmark::conversions(const string &file, int iterations) {
+	ofMesh terrain;
+	if (!ObjLoader::loadCached(file, terrain)) {
+		cout << "can't read " << file << endl;
+		return;
+	}
+	Octree octree;
+	octree.create(std::make_shared<vector<glm::vec3>>(std::move(terrain.getVertices())), 20);
+	vector<int> remap;
+	octree.reorder(remap);
+
+	// lander positions above the terrain
+	//
+	const int n = 100000;
+	Vector3 tmin = octree.root.box.min(), tmax = octree.root.box.max();
+	Rng rng(1234);
+	vector<glm::vec3> positions(n);
+	for (int i = 0; i < n; i++)
+		positions[i] = glm::vec3(rng.uniform(tmin.x(), tmax.x()), rng.uniform(tmin.y(), tmax.y() + 20),
+			rng.uniform(tmin.z(), tmax.z()));
+	glm::vec3 boundsMin(-1, 0, -1), boundsMax(1, 2, 1);
+	cout << "lander queries, " << n << " positions, " << iterations << " iterations" << endl;
+
+	vector<Box> boxes;
+	volatile float sink = 0;
+	double best, mean;
+
+	timeRuns(iterations, [&]() {
+		float sum = 0;
+		for (int i = 0; i < n; i++) {
+			ofVec3f pos = positions[i];
+			ofVec3f min = pos + boundsMin;
+			ofVec3f max = pos + boundsMax;
+			Box b = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+			TreeNode node;
+			if (octree.intersect(Ray(Vector3(pos.x, pos.y, pos.z), Vector3(0, -1, 0)), octree.root, node)) {
+				Vector3 center = node.box.center();
+				sum += glm::distance(glm::vec3(pos.x, pos.y, pos.z), glm::vec3(center.x(), center.y(), center.z()));
+			}
+			boxes.clear();
+			octree.intersect(b, octree.root, boxes);
+			for (int k = 0; k < boxes.size(); k++) {
+				Vector3 c = boxes[k].center();
+				sum += glm::vec3(c.x(), c.y(), c.z()).y;
+			}
+		}
+		sink = sum;
+		return true;
+	}, best, mean);
+	reportItems("per component", n, best, mean);
+	float before = sink;
+
+	timeRuns(iterations, [&]() {
+		float sum = 0;
+		for (int i = 0; i < n; i++) {
+			const glm::vec3 &pos = positions[i];
+			Box b(pos + boundsMin, pos + boundsMax);
+			const TreeNode *node = octree.intersect(Ray(pos, Vector3(0, -1, 0)));
+			if (node)
+				sum += glm::distance(pos, node->box.center().to<glm::vec3>());
+			boxes.clear();
+			octree.intersect(b, octree.root, boxes);
+			for (int k = 0; k < boxes.size(); k++)
+				sum += boxes[k].center().to<glm::vec3>().y;
+		}
+		sink = sum;
+		return true;
+	}, best, mean);
+	reportItems("direct", n, best, mean);
+	cout << "  checksum " << before << " / " << sink << endl;
+}
+
+template <class Tree, class Source>
+static void timeBuild(const string &name, const Source &source, int levels, int iterations) {
+	Tree tree;
+	double best, mean;
+	timeRuns(iterations, [&]() {
+		tree.create(source, levels);
+		return true;
+	}, best, mean);
+	const OctreeBuildStats &s = tree.buildStats;
+	cout << "  " << name;
+	for (int i = name.size(); i < 28; i++) cout << " ";
+	cout << ofToString(best, 1) << " ms best, " << ofToString(mean, 1) << " ms mean, "
+		<< s.nodes << " nodes, " << s.leaves << " leaves, depth " << s.maxDepth << endl;
+}
+
+//  vertical rays and lander sized boxes at n seeded positions over the
+//  tree, counted into its queryStats
+//
+static void countQueries(Octree &octree, int n) {
+	Vector3 bmin = octree.root.box.min(), bmax = octree.root.box.max();
+	float size = max(bmax.x() - bmin.x(), bmax.z() - bmin.z()) * 0.01f;
+	Rng rng(42);
+	vector<Box> boxList;
+	octree.queryStats.reset();
+	octree.bQueryStats = true;
+	for (int i = 0; i < n; i++) {
+		glm::vec3 p(rng.uniform(bmin.x(), bmax.x()), rng.uniform(bmin.y(), bmax.y()), rng.uniform(bmin.z(), bmax.z()));
+		octree.intersect(Ray(glm::vec3(p.x, bmax.y() + 1, p.z), Vector3(0, -1, 0)));
+		boxList.clear();
+		octree.intersect(Box(p - glm::vec3(size), p + glm::vec3(size)), octree.root, boxList);
+	}
+	octree.bQueryStats = false;
+}
+
+void Benchmark::octreeBuild(const string &file, int iterations) {
+	ofMesh terrain;
+	if (!ObjLoader::loadCached(file, terrain)) {
+		cout << "can't read " << file << endl;
+		return;
+	}
+	auto positions = std::make_shared<const vector<glm::vec3>>(terrain.getVertices());
+	Box bounds = Octree::meshBounds(terrain);
+
+	// particles scattered over the terrain, actors as small boxes
+	//
+	const int n = 100000;
+	Vector3 bmin = bounds.min(), bmax = bounds.max();
+	Rng rng(1234);
+	auto particles = std::make_shared<vector<glm::vec3>>(n);
+	for (int i = 0; i < n; i++)
+		(*particles)[i] = glm::vec3(rng.uniform(bmin.x(), bmax.x()), rng.uniform(bmin.y(), bmax.y()),
+			rng.uniform(bmin.z(), bmax.z()));
+	vector<Box> actors(1000);
+	for (int i = 0; i < actors.size(); i++) {
+		glm::vec3 p = (*particles)[i];
+		actors[i] = Box(p - glm::vec3(1), p + glm::vec3(1));
+	}
+
+	cout << "octree builds, " << iterations << " iterations" << endl;
+	timeBuild<Octree>("terrain points", positions, 20, iterations);
+	timeBuild<OctreeT<PointItems, 8>>("terrain points, 8 per leaf", positions, 20, iterations);
+	timeBuild<TriangleOctree>("terrain triangles", terrain, 8, iterations);
+	timeBuild<ParticleOctree>(ofToString(n) + " particles", particles, 20, iterations);
+	timeBuild<ObjectOctree>(ofToString(actors.size()) + " actors", BoxItems(actors), 20, iterations);
+
+	// the terrain tree as the game builds it, then the levels limit against
+	// its cost per query
+	//
+	const int queries = 10000;
+	Octree octree;
+	octree.create(positions, 20);
+	vector<int> remap;
+	octree.reorder(remap);
+	countQueries(octree, queries);
+	cout << endl;
+	octree.dumpStats();
+
+	cout << endl << "terrain points by levels, " << queries << " ray and box queries" << endl;
+	int levels[] = { 6, 8, 10, 12, 14, 20 };
+	for (int levelsLimit : levels) {
+		octree.create(positions, levelsLimit);
+		countQueries(octree, queries);
+		const OctreeBuildStats &s = octree.buildStats;
+		const OctreeQueryStats &q = octree.queryStats;
+		cout << "  " << levelsLimit << " levels: " << s.nodes << " nodes, " << s.leaves << " leaves, up to "
+			<< s.leafItems.size() - 1 << " items per leaf, " << ofToString(s.subdivideMs, 1) << " ms build, "
+			<< ofToString((double)q.nodesVisited / q.queries(), 1) << " nodes visited, "
+			<< ofToString(q.ns / (double)q.queries(), 0) << " ns per query" << endl;
+	}
+}
+
+void Benchmark::objLoading(const string &file, int iterations) {
+	std::error_code err;
+	double megabytes = std::filesystem::file_size(file, err) / (1024.0 * 1024.0);
+	if (err) {
+		cout << "can't read " << file << endl;
+		return;
+	}
+	int threads = max(1u, std::thread::hardware_concurrency());
+	cout << "loading " << file << " (" << ofToString(megabytes, 1) << " MB), "
+		<< iterations << " iterations" << endl;
+
+	double best, mean;
+	timeRuns(iterations, [&]() {
+		Assimp::Importer importer;
+		const aiScene *scene = importer.ReadFile(file, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices);
+		return scene != NULL;
+	}, best, mean);
+	report("assimp", megabytes, best, mean);
+
+	ofMesh mesh;
+	timeRuns(iterations, [&]() { return ObjLoader::load(file, mesh, 1); }, best, mean);
+	report("ObjLoader, 1 thread", megabytes, best, mean);
+
+	timeRuns(iterations, [&]() { return ObjLoader::load(file, mesh, threads); }, best, mean);
+	report("ObjLoader, " + ofToString(threads) + " threads", megabytes, best, mean);
+
+	// the cache is smaller than the .obj - throughput is still given in
+	// .obj megabytes so the rows compare
+	//
+	string cache = ObjLoader::cachePath(file);
+	ObjLoader::writeCache(cache, mesh);
+	timeRuns(iterations, [&]() { return ObjLoader::readCache(cache, mesh); }, best, mean);
+	report("mesh cache", megabytes, best, mean);
+	cout << "  " << mesh.getNumVertices() << " vertices, " << mesh.getNumIndices() / 3 << " triangles" << endl;
+}
+
+double BenchResult::percentile(double p) const {
+	if (samples.empty()) return 0;
+	vector<double> sorted = samples;
+	std::sort(sorted.begin(), sorted.end());
+	double k = p / 100 * (sorted.size() - 1);
+	int i = (int)k;
+	if (i + 1 >= sorted.size()) return sorted.back();
+	return sorted[i] + (sorted[i + 1] - sorted[i]) * (k - i);
+}
+
+double BenchResult::mean() const {
+	double sum = 0;
+	for (int i = 0; i < samples.size(); i++) sum += samples[i];
+	return samples.empty() ? 0 : sum / samples.size();
+}
+
+//  wall clock ms of f
+//
+template <class F>
+static double timeMs(F f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//  octree build, ray and box queries, height field build and lookups over
+//  one terrain
+//
+static void terrainBenchmarks(const string &dataset, const ofMesh &mesh, int iterations, vector<BenchResult> &results) {
+	auto positions = std::make_shared<const vector<glm::vec3>>(mesh.getVertices());
+	BenchResult build = { "octree build", dataset, "ms" };
+	Octree octree;
+	for (int i = 0; i < iterations; i++)
+		build.samples.push_back(timeMs([&]() { octree.create(positions, 20); }));
+	results.push_back(build);
+
+	// queries from the same seeded positions every run: vertical rays from
+	// above the terrain, and lander sized boxes inside its bounds.  Each
+	// sample is the mean over a batch of queries.
+	//
+	const int batches = 50, batchSize = 200;
+	Vector3 bmin = octree.root.box.min(), bmax = octree.root.box.max();
+	float size = max(bmax.x() - bmin.x(), bmax.z() - bmin.z()) * 0.01f;
+	Rng rng(42);
+	vector<glm::vec3> points(batches * batchSize);
+	for (int i = 0; i < points.size(); i++)
+		points[i] = glm::vec3(rng.uniform(bmin.x(), bmax.x()), rng.uniform(bmin.y(), bmax.y()), rng.uniform(bmin.z(), bmax.z()));
+
+	BenchResult rays = { "ray query", dataset, "ns/query" };
+	int hits = 0;
+	for (int b = 0; b < batches; b++) {
+		double ms = timeMs([&]() {
+			for (int i = b * batchSize; i < (b + 1) * batchSize; i++) {
+				glm::vec3 origin(points[i].x, bmax.y() + 1, points[i].z);
+				hits += octree.intersect(Ray(origin, Vector3(0, -1, 0))) != NULL;
+			}
+		});
+		rays.samples.push_back(ms * 1e6 / batchSize);
+	}
+	results.push_back(rays);
+
+	BenchResult boxes = { "box query", dataset, "ns/query" };
+	vector<Box> boxList;
+	int leaves = 0;
+	for (int b = 0; b < batches; b++) {
+		double ms = timeMs([&]() {
+			for (int i = b * batchSize; i < (b + 1) * batchSize; i++) {
+				boxList.clear();
+				octree.intersect(Box(points[i] - glm::vec3(size), points[i] + glm::vec3(size)), octree.root, boxList);
+				leaves += boxList.size();
+			}
+		});
+		boxes.samples.push_back(ms * 1e6 / batchSize);
+	}
+	results.push_back(boxes);
+
+	BenchResult fieldBuild = { "height field build", dataset, "ms" };
+	HeightField field;
+	for (int i = 0; i < iterations; i++)
+		fieldBuild.samples.push_back(timeMs([&]() { field.build(mesh.getVertices(), mesh.getIndices()); }));
+	results.push_back(fieldBuild);
+
+	BenchResult lookups = { "height lookup", dataset, "ns/query" };
+	int found = 0;
+	for (int b = 0; b < batches; b++) {
+		double ms = timeMs([&]() {
+			float h;
+			glm::vec3 normal;
+			for (int i = b * batchSize; i < (b + 1) * batchSize; i++)
+				found += field.lookup(points[i].x, points[i].z, h, normal);
+		});
+		lookups.samples.push_back(ms * 1e6 / batchSize);
+	}
+	results.push_back(lookups);
+	cout << "  " << dataset << ": " << mesh.getNumVertices() << " vertices, " << hits << " ray hits, "
+		<< leaves << " leaves in boxes, " << found << " heights, " << field.nx << "x" << field.nz << " height field" << endl;
+}
+
+//  particle update and VBO packing, n particles over six emitters as in the
+//  game.  Then the spatial hash over all of them and neighbour queries
+//  (checked against brute force on a sample), and the update again with
+//  the particles colliding with a rolling ground, and the integration on
+//  each particle backend.  False if a neighbour query doesn't match brute
+//  force.
+//
+static bool particleBenchmarks(int n, int iterations, vector<BenchResult> &results) {
+	string dataset = ofToString(n) + " particles";
+	GravityForce gravity(ofVec3f(0, -2, 0));
+	TurbulenceForce turbulence(ofVec3f(-10, -10, -10), ofVec3f(10, 10, 10));
+	vector<std::unique_ptr<ParticleEmitter>> emitters;
+	ParticleBatch batch;
+	Rng rng(7);
+	for (int e = 0; e < 6; e++) {
+		emitters.emplace_back(new ParticleEmitter());
+		ParticleSystem *sys = emitters.back()->sys;
+		sys->addForce(&gravity);
+		sys->addForce(&turbulence);
+		for (int i = e; i < n; i += 6) {
+			Particle p;
+			p.position = rng.uniform(ofVec3f(-100, 0, -100), ofVec3f(100, 50, 100));
+			p.velocity = rng.uniform(ofVec3f(-5, -5, -5), ofVec3f(5, 5, 5));
+			p.lifespan = -1;
+			sys->add(p);
+		}
+		batch.add(emitters.back().get(), ofColor::white);
+	}
+
+	const int frames = max(iterations, 30);
+	SimClock clock;
+	BenchResult update = { "particle update", dataset, "ms" };
+	for (int f = 0; f < frames; f++) {
+		clock.step(1 / 60.0);
+		update.samples.push_back(timeMs([&]() {
+			for (int e = 0; e < emitters.size(); e++)
+				emitters[e]->sys->update(clock);
+		}));
+	}
+	results.push_back(update);
+
+	BenchResult capture = { "particle capture", dataset, "ms" };
+	for (int f = 0; f < frames; f++)
+		capture.samples.push_back(timeMs([&]() { batch.capture(); }));
+	results.push_back(capture);
+
+	vector<ParticleVertex> vertices(n);
+	BenchResult pack = { "vbo pack", dataset, "ms" };
+	int packed = 0;
+	for (int f = 0; f < frames; f++)
+		pack.samples.push_back(timeMs([&]() { packed = batch.pack(vertices.data(), vertices.size()); }));
+	results.push_back(pack);
+
+	vector<glm::vec3> positions;
+	for (int e = 0; e < emitters.size(); e++) {
+		const vector<Particle> &particles = emitters[e]->sys->particles;
+		for (int i = 0; i < particles.size(); i++)
+			positions.push_back(glm::vec3(particles[i].position.x, particles[i].position.y, particles[i].position.z));
+	}
+	const float radius = 2;
+	SpatialHash hash;
+	BenchResult hashBuild = { "spatial hash build", dataset, "ms" };
+	for (int f = 0; f < frames; f++)
+		hashBuild.samples.push_back(timeMs([&]() { hash.build(positions.data(), positions.size(), radius); }));
+	results.push_back(hashBuild);
+
+	const int batches = 50, batchSize = 200;
+	BenchResult queries = { "neighbour query", dataset, "ns/query" };
+	int neighbours = 0;
+	for (int b = 0; b < batches && !positions.empty(); b++) {
+		double ms = timeMs([&]() {
+			for (int i = b * batchSize; i < (b + 1) * batchSize; i++)
+				hash.forEachNear(positions[i % positions.size()], radius, [&](int) { neighbours++; });
+		});
+		queries.samples.push_back(ms * 1e6 / batchSize);
+	}
+	results.push_back(queries);
+
+	int mismatches = 0, checked = min((int)positions.size(), 100);
+	for (int i = 0; i < checked; i++) {
+		int near = 0, brute = 0;
+		hash.forEachNear(positions[i], radius, [&](int) { near++; });
+		for (int j = 0; j < positions.size(); j++)
+			brute += glm::dot(positions[j] - positions[i], positions[j] - positions[i]) <= radius * radius;
+		mismatches += near != brute;
+	}
+	if (mismatches > 0)
+		cout << "  " << dataset << ": neighbour query MISMATCH with brute force at " << mismatches << " of " << checked << " points" << endl;
+
+	ofMesh ground;
+	const int cells = 64;
+	for (int z = 0; z <= cells; z++)
+		for (int x = 0; x <= cells; x++) {
+			float px = -100 + 200.0f * x / cells, pz = -100 + 200.0f * z / cells;
+			ground.addVertex(glm::vec3(px, 5 * sin(px / 10) * cos(pz / 10), pz));
+		}
+	for (int z = 0; z < cells; z++)
+		for (int x = 0; x < cells; x++) {
+			int v = z * (cells + 1) + x;
+			ground.addTriangle(v, v + 1, v + cells + 1);
+			ground.addTriangle(v + 1, v + cells + 2, v + cells + 1);
+		}
+	HeightField field;
+	field.build(ground.getVertices(), ground.getIndices());
+	GroundHeight groundHeight;
+	groundHeight.fields.push_back(&field);
+	for (int e = 0; e < emitters.size(); e++)
+		emitters[e]->sys->ground = &groundHeight;
+	BenchResult collide = { "particle ground", dataset, "ms" };
+	for (int f = 0; f < frames; f++) {
+		clock.step(1 / 60.0);
+		collide.samples.push_back(timeMs([&]() {
+			for (int e = 0; e < emitters.size(); e++)
+				emitters[e]->sys->update(clock);
+		}));
+	}
+	results.push_back(collide);
+
+	// the integration step alone on every backend, over the same particles
+	//
+	vector<Particle> all;
+	for (int e = 0; e < emitters.size(); e++)
+		all.insert(all.end(), emitters[e]->sys->particles.begin(), emitters[e]->sys->particles.end());
+	vector<const ParticleBackend *> backends = ParticleBackend::available();
+	for (int b = 0; b < backends.size(); b++) {
+		BenchResult integrate = { "particle integrate", dataset + ", " + backends[b]->name(), "ms" };
+		vector<Particle> copy = all;
+		for (int f = 0; f < frames; f++)
+			integrate.samples.push_back(timeMs([&]() { backends[b]->integrate(copy.data(), copy.size(), 1 / 60.0); }));
+		results.push_back(integrate);
+	}
+
+	int below = 0;
+	for (int e = 0; e < emitters.size(); e++) {
+		const vector<Particle> &particles = emitters[e]->sys->particles;
+		for (int i = 0; i < particles.size(); i++)
+			below += particles[i].position.y < field.height(particles[i].position.x, particles[i].position.z) - 1e-3f;
+	}
+	cout << "  " << dataset << ": " << packed << " packed, " << neighbours << " neighbours, "
+		<< below << " below the ground" << endl;
+	return mismatches == 0;
+}
+
+//  the suite's results; passed is false if one of its checks failed
+//
+vector<BenchResult> Benchmark::suite(const SuiteOptions &options, bool &passed) {
+	vector<BenchResult> results;
+	passed = true;
+	int iterations = max(1, options.iterations);
+	for (int i = 0; i < options.terrainSizes.size(); i++) {
+		int size = options.terrainSizes[i];
+		ofMesh mesh = makeTerrainMesh(size, 2000, 150, 1234 + size);
+		terrainBenchmarks("terrain " + ofToString(size) + "x" + ofToString(size), mesh, iterations, results);
+	}
+	for (int i = 0; i < options.files.size(); i++) {
+		ofMesh mesh;
+		if (!ObjLoader::loadCached(options.files[i], mesh)) {
+			cout << "can't read " << options.files[i] << endl;
+			continue;
+		}
+		terrainBenchmarks(std::filesystem::path(options.files[i]).filename().string(), mesh, iterations, results);
+	}
+	for (int i = 0; i < options.particleCounts.size(); i++)
+		passed &= particleBenchmarks(options.particleCounts[i], iterations, results);
+
+	cout << endl;
+	cout << "benchmark          dataset                      unit           p50         p90         p99        mean" << endl;
+	for (int i = 0; i < results.size(); i++) {
+		const BenchResult &r = results[i];
+		char line[256];
+		snprintf(line, sizeof(line), "%-18s %-28s %-10s %11.3f %11.3f %11.3f %11.3f", r.benchmark.c_str(), r.dataset.c_str(),
+			r.unit.c_str(), r.percentile(50), r.percentile(90), r.percentile(99), r.mean());
+		cout << line << endl;
+	}
+
+	if (!options.jsonFile.empty() && writeJson(options.jsonFile, results))
+		cout << "wrote " << options.jsonFile << endl;
+	if (!options.csvFile.empty() && writeCsv(options.csvFile, results))
+		cout << "wrote " << options.csvFile << endl;
+	return results;
+}
+
+//  JSON: { "simd": ..., "particleBackend": ..., "threads": ..., "results": [
+//  { "benchmark", "dataset", "unit", "samples", "min", "p50", "p90", "p99",
+//  "max", "mean" }, ... ] }
+//
+bool Benchmark::writeJson(const string &file, const vector<BenchResult> &results) {
+	ofstream out(file);
+	if (!out) {
+		cout << "can't write " << file << endl;
+		return false;
+	}
+	out << "{\n  \"simd\": \"" << geomBatchSimd() << "\",\n  \"particleBackend\": \"" << ParticleBackend::best().name()
+		<< "\",\n  \"threads\": " << std::thread::hardware_concurrency()
+		<< ",\n  \"results\": [\n";
+	for (int i = 0; i < results.size(); i++) {
+		const BenchResult &r = results[i];
+		out << "    { \"benchmark\": \"" << r.benchmark << "\", \"dataset\": \"" << r.dataset
+			<< "\", \"unit\": \"" << r.unit << "\", \"samples\": " << r.samples.size()
+			<< ", \"min\": " << r.percentile(0) << ", \"p50\": " << r.percentile(50)
+			<< ", \"p90\": " << r.percentile(90) << ", \"p99\": " << r.percentile(99)
+			<< ", \"max\": " << r.percentile(100) << ", \"mean\": " << r.mean() << " }"
+			<< (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "  ]\n}\n";
+	return true;
+}
+
+bool Benchmark::writeCsv(const string &file, const vector<BenchResult> &results) {
+	ofstream out(file);
+	if (!out) {
+		cout << "can't write " << file << endl;
+		return false;
+	}
+	out << "benchmark,dataset,unit,samples,min,p50,p90,p99,max,mean\n";
+	for (int i = 0; i < results.size(); i++) {
+		const BenchResult &r = results[i];
+		out << r.benchmark << "," << r.dataset << "," << r.unit << "," << r.samples.size() << ","
+			<< r.percentile(0) << "," << r.percentile(50) << "," << r.percentile(90) << ","
+			<< r.percentile(99) << "," << r.percentile(100) << "," << r.mean() << "\n";
+	}
+	return true;
+}
+
+//  command line entry point for --bench
+//
+int Benchmark::main(int argc, char *argv[]) {
+	if (argc < 3) {
+		cout << "usage: --bench obj [file.obj] [--iterations N]" << endl;
+		cout << "       --bench math [--iterations N]" << endl;
+		cout << "       --bench particles [--particles N] [--iterations N]" << endl;
+		cout << "       --bench convert [file.obj] [--iterations N]" << endl;
+		cout << "       --bench octree [file.obj] [--iterations N]" << endl;
+		cout << "       --bench suite [file.obj ...] [--terrain-size N ...] [--particles N ...]" << endl;
+		cout << "                     [--iterations N] [--json out.json] [--csv out.csv]" << endl;
+		return 1;
+	}
+	string which = argv[2];
+	string file = ofToDataPath("geo/moonTerrain_size2.obj");
+	int iterations = 5;
+	SuiteOptions suiteOptions;
+	vector<int> sizes, counts;
+	for (int i = 3; i < argc; i++) {
+		string opt = argv[i];
+		if (opt == "--iterations" && i + 1 < argc) iterations = suiteOptions.iterations = atoi(argv[++i]);
+		else if (opt == "--terrain-size" && i + 1 < argc) sizes.push_back(atoi(argv[++i]));
+		else if (opt == "--particles" && i + 1 < argc) counts.push_back(atoi(argv[++i]));
+		else if (opt == "--json" && i + 1 < argc) suiteOptions.jsonFile = argv[++i];
+		else if (opt == "--csv" && i + 1 < argc) suiteOptions.csvFile = argv[++i];
+		else {
+			file = opt;
+			suiteOptions.files.push_back(opt);
+		}
+	}
+	if (!sizes.empty()) suiteOptions.terrainSizes = sizes;
+	if (!counts.empty()) suiteOptions.particleCounts = counts;
+
+	// the suite runs every geo/*.obj unless files are given
+	//
+	if (which == "suite" && suiteOptions.files.empty()) {
+		std::error_code err;
+		for (auto &entry : std::filesystem::directory_iterator(ofToDataPath("geo"), err))
+			if (entry.path().extension() == ".obj") suiteOptions.files.push_back(entry.path().string());
+		std::sort(suiteOptions.files.begin(), suiteOptions.files.end());
+	}
+
+	bool passed = true;
+	if (which == "obj") objLoading(file, iterations);
+	else if (which == "math") passed = mathKernels(iterations);
+	else if (which == "particles") passed = particleKernels(counts.empty() ? 1 << 20 : counts[0], iterations);
+	else if (which == "convert") conversions(file, iterations);
+	else if (which == "octree") octreeBuild(file, iterations);
+	else if (which == "suite") suite(suiteOptions, passed);
+	else {
+		cout << "unknown benchmark: " << which << endl;
+		return 1;
+	}
+	return passed ? 0 : 1;
+}
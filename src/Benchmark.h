@@ -0,0 +1,94 @@
+#pragma once
+
+#include "ofMain.h"
+
+//  Benchmarks, run from the command line with no window or GL context:
+//
+//      <app> --bench obj [file.obj] [--iterations N]
+//      <app> --bench math [--iterations N]
+//      <app> --bench particles [--particles N] [--iterations N]
+//      <app> --bench convert [file.obj] [--iterations N]
+//      <app> --bench octree [file.obj] [--iterations N]
+//      <app> --bench suite [file.obj ...] [--terrain-size N ...] [--particles N ...]
+//                          [--iterations N] [--json out.json] [--csv out.csv]
+//
+//  obj - load the terrain .obj with assimp (the import step behind
+//  ofxAssimpModelLoader::loadModel, without its GL upload) and with
+//  ObjLoader on one thread, on all threads and from its mesh cache, and
+//  report the time and parse throughput of each.
+//
+//  math - the Box tests and the GeomBatch kernels on random data, each
+//  against its scalar version, in ns per point or box.  The batch kernels
+//  must find the same points and boxes as the scalar ones.
+//
+//  particles - each particle backend's kernels (ParticleBackend) over the
+//  same random particles, in ns per particle, and how far each backend's
+//  results are from the scalar backend's, which must be within
+//  particleTolerance.
+//
+//  math, particles and suite (its neighbour query check) exit with 1 if a
+//  check fails, so they can gate a build.
+//
+//  convert - the lander's per step terrain queries (altitude ray, bounds
+//  vs octree, box centers) over the terrain's octree, written with
+//  explicit per component conversions between ofVec3f / glm::vec3 /
+//  Vector3 and a copied TreeNode as before, and passing the vectors
+//  directly, in ns per query.
+//
+//  octree - build time of each octree instantiation: the terrain's points
+//  and triangles, particle positions and actor boxes.  Then the terrain
+//  tree's build and query statistics (OctreeBase::dumpStats()), and its
+//  size and cost per query for a range of levels limits.
+//
+//  suite - the regression suite.  For each terrain - synthetic N x N
+//  grids (--terrain-size, seeded, so every run sees the same data) and
+//  the given .obj files, or every geo/*.obj - it times octree build, ray
+//  queries, box queries, height field build and height lookups; for each
+//  particle count it times the particle update, the snapshot copy
+//  (capture), the VBO packing of the particle batch, the spatial hash
+//  build, neighbour queries, the update with ground collision and the
+//  integration step on each particle backend.  Every
+//  measurement is a set of samples, reported as percentiles and optionally
+//  written as JSON and/or CSV so results can be compared between versions.
+//
+
+//  samples of one measurement, in "unit" (ms, ns/query ...)
+//
+struct BenchResult {
+	string benchmark;
+	string dataset;
+	string unit;
+	vector<double> samples;
+
+	BenchResult(const string &benchmark, const string &dataset, const string &unit)
+		: benchmark(benchmark), dataset(dataset), unit(unit) {}
+
+	double percentile(double p) const;
+	double mean() const;
+};
+
+struct SuiteOptions {
+	vector<string> files;
+	vector<int> terrainSizes = { 128, 512 };
+	vector<int> particleCounts = { 10000, 100000 };
+	int iterations = 10;
+	string jsonFile, csvFile;
+};
+
+class Benchmark {
+public:
+	static int main(int argc, char *argv[]);
+	static void objLoading(const string &file, int iterations);
+	static bool mathKernels(int iterations);
+	static bool particleKernels(int n, int iterations);
+	static void conversions(const string &file, int iterations);
+	static void octreeBuild(const string &file, int iterations);
+	static vector<BenchResult> suite(const SuiteOptions &options, bool &passed);
+	static bool writeJson(const string &file, const vector<BenchResult> &results);
+	static bool writeCsv(const string &file, const vector<BenchResult> &results);
+
+	// largest difference of a backend's results from the scalar backend's,
+	// relative to the value (absolute below 1)
+	//
+	static constexpr float particleTolerance = 1e-5f;
+};
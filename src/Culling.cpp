@@ -0,0 +1,111 @@
+
+#include "Culling.h"
+
+//  extract the planes (Gribb/Hartmann).  glm matrices are column major, so
+//  row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+//
+void Frustum::set(const glm::mat4 &m) {
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+	planes[0] = row[3] + row[0];
+	planes[1] = row[3] - row[0];
+	planes[2] = row[3] + row[1];
+	planes[3] = row[3] - row[1];
+	planes[4] = row[3] + row[2];
+	planes[5] = row[3] - row[2];
+	for (int i = 0; i < 6; i++)
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+//  false only if the box is entirely outside one of the planes.  Boxes near
+//  a frustum corner may pass when they are just outside, which is fine for
+//  culling.
+//
+bool Frustum::intersects(const glm::vec3 &min, const glm::vec3 &max) const {
+	for (int i = 0; i < 6; i++) {
+		const glm::vec4 &p = planes[i];
+
+		// corner of the box furthest along the plane normal
+		//
+		glm::vec3 v(p.x > 0 ? max.x : min.x, p.y > 0 ? max.y : min.y, p.z > 0 ? max.z : min.z);
+		if (p.x * v.x + p.y * v.y + p.z * v.z + p.w < 0)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::intersects(const Box &box, float margin) const {
+	return intersects(box.min().to<glm::vec3>() - margin, box.max().to<glm::vec3>() + margin);
+}
+
+//  set the view for this frame
+//
+void ViewCuller::setup(const glm::mat4 &viewProjection, const glm::vec3 &eyePos) {
+	frustum.set(viewProjection);
+	eye = eyePos;
+	stats = CullStats();
+}
+
+//  in the frustum and closer than farDistance
+//
+bool ViewCuller::visible(const glm::vec3 &min, const glm::vec3 &max) const {
+	glm::vec3 closest = glm::clamp(eye, min, max);
+	if (glm::distance(closest, eye) > farDistance)
+		return false;
+	return frustum.intersects(min, max);
+}
+
+//  collect the terrain chunks to draw.  Stats add up over all the terrains
+//  culled since setup().
+//
+void ViewCuller::cull(const Terrain &terrain, vector<int> &visibleChunks) {
+	visibleChunks.clear();
+	stats.chunks += terrain.chunks.size();
+	if (terrain.octree)
+		cullNode(terrain, terrain.octree->root, 0, visibleChunks);
+	stats.chunksDrawn += visibleChunks.size();
+}
+
+//  nodes above chunk level only have their own box, so they are tested with
+//  the margin chunk triangles can reach past it
+//
+void ViewCuller::cullNode(const Terrain &terrain, const TreeNode &node, int level, vector<int> &visibleChunks) {
+	if (level == terrain.chunkLevel || node.children.size() == 0) {
+		int i = terrain.chunkAt(node);
+		if (i >= 0 && visible(terrain.chunks[i].min, terrain.chunks[i].max))
+			visibleChunks.push_back(i);
+		return;
+	}
+	if (!visible(node.box.min().to<glm::vec3>() - terrain.margin,
+		node.box.max().to<glm::vec3>() + terrain.margin))
+		return;
+	for (int i = 0; i < node.children.size(); i++)
+		cullNode(terrain, node.children[i], level + 1, visibleChunks);
+}
+
+//  mark each emitter visible or not and set its LOD stride
+//
+void ViewCuller::cull(ParticleBatch &batch) {
+	stats.emitters = batch.entries.size();
+	stats.emittersDrawn = 0;
+	stats.particles = 0;
+	stats.particlesDrawn = 0;
+	for (int i = 0; i < batch.entries.size(); i++) {
+		ParticleBatch::Entry &e = batch.entries[i];
+		int n = e.positions.size();
+		stats.particles += n;
+
+		glm::vec3 min = e.boundsMin;
+		glm::vec3 max = e.boundsMax;
+		e.visible = n > 0 && visible(min, max);
+		e.stride = 1;
+		if (!e.visible) continue;
+
+		float dist = glm::distance(glm::clamp(eye, min, max), eye);
+		e.stride = ofClamp(1 + (int)(dist / lodDistance), 1, maxStride);
+		stats.emittersDrawn++;
+		stats.particlesDrawn += (n + e.stride - 1) / e.stride;
+	}
+}
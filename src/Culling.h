@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Terrain.h"
+#include "ParticleBatch.h"
+
+//  View frustum as six planes (normal . p + d >= 0 inside), taken from a
+//  view-projection matrix.  Plain math, no GL, so it works headless.
+//
+class Frustum {
+public:
+	void set(const glm::mat4 &viewProjection);
+	bool intersects(const glm::vec3 &min, const glm::vec3 &max) const;
+	bool intersects(const Box &box, float margin = 0) const;
+
+	glm::vec4 planes[6];    // left, right, bottom, top, near, far
+};
+
+//  Counts from the last cull
+//
+struct CullStats {
+	int chunks = 0;
+	int chunksDrawn = 0;
+	int emitters = 0;
+	int emittersDrawn = 0;
+	int particles = 0;
+	int particlesDrawn = 0;
+
+	float chunksCulled() const { return chunks > 0 ? 100.0 * (chunks - chunksDrawn) / chunks : 0; }
+	float particlesCulled() const { return particles > 0 ? 100.0 * (particles - particlesDrawn) / particles : 0; }
+};
+
+//  CPU cull stage run before drawing.  Terrain chunks are culled by walking
+//  the terrain octree top down and skipping every subtree outside the view,
+//  particles by the bounds of each emitter's particle system.  Particles
+//  beyond lodDistance are thinned out: at n * lodDistance only every
+//  (n + 1)th particle is drawn, up to maxStride.  Anything past farDistance
+//  is not drawn at all.
+//
+class ViewCuller {
+public:
+	void setup(const glm::mat4 &viewProjection, const glm::vec3 &eye);
+	void cull(const Terrain &terrain, vector<int> &visibleChunks);
+	void cull(ParticleBatch &batch);
+	bool visible(const glm::vec3 &min, const glm::vec3 &max) const;
+
+	Frustum frustum;
+	glm::vec3 eye;
+	float farDistance = 2000;
+	float lodDistance = 150;
+	int maxStride = 8;
+	CullStats stats;
+
+private:
+	void cullNode(const Terrain &terrain, const TreeNode &node, int level, vector<int> &visibleChunks);
+};
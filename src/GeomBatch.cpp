@@ -0,0 +1,210 @@
+#include "GeomBatch.h"
+#include <cmath>
+
+#if defined(__AVX__)
+#define GEOM_USE_AVX
+#include <immintrin.h>
+#elif defined(VECTOR3_USE_SSE)
+#define GEOM_USE_SSE
+#endif
+
+//  the point test for points [begin, n), one at a time
+//
+static int pointsInBoxTail(const glm::vec3 *points, const int *indices, int begin, int n, const Box &box, int *out) {
+	const Vector3 &bmin = box.parameters[0];
+	const Vector3 &bmax = box.parameters[1];
+	float x0 = bmin.x(), y0 = bmin.y(), z0 = bmin.z();
+	float x1 = bmax.x(), y1 = bmax.y(), z1 = bmax.z();
+
+	int count = 0;
+	for (int i = begin; i < n; i++) {
+		int index = indices ? indices[i] : i;
+		const glm::vec3 &v = points[index];
+		if (v.x >= x0 && v.x <= x1 && v.y >= y0 && v.y <= y1 && v.z >= z0 && v.z <= z1)
+			out[count++] = index;
+	}
+	return count;
+}
+
+int pointsInBoxScalar(const glm::vec3 *points, const int *indices, int n, const Box &box, int *out) {
+	return pointsInBoxTail(points, indices, 0, n, box, out);
+}
+
+//  the points are gathered into one register per axis, W at a time; the
+//  indices of the ones inside are then written out without branches (each
+//  is stored, and the count only moves past it if it is inside)
+//
+#if defined(GEOM_USE_AVX)
+int pointsInBox(const glm::vec3 *points, const int *indices, int n, const Box &box, int *out) {
+	const Vector3 &bmin = box.parameters[0];
+	const Vector3 &bmax = box.parameters[1];
+	__m256 x0 = _mm256_set1_ps(bmin.x()), y0 = _mm256_set1_ps(bmin.y()), z0 = _mm256_set1_ps(bmin.z());
+	__m256 x1 = _mm256_set1_ps(bmax.x()), y1 = _mm256_set1_ps(bmax.y()), z1 = _mm256_set1_ps(bmax.z());
+
+	int count = 0;
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		int index[8];
+		for (int k = 0; k < 8; k++) index[k] = indices ? indices[i + k] : i + k;
+		const glm::vec3 *p[8];
+		for (int k = 0; k < 8; k++) p[k] = &points[index[k]];
+		__m256 x = _mm256_set_ps(p[7]->x, p[6]->x, p[5]->x, p[4]->x, p[3]->x, p[2]->x, p[1]->x, p[0]->x);
+		__m256 y = _mm256_set_ps(p[7]->y, p[6]->y, p[5]->y, p[4]->y, p[3]->y, p[2]->y, p[1]->y, p[0]->y);
+		__m256 z = _mm256_set_ps(p[7]->z, p[6]->z, p[5]->z, p[4]->z, p[3]->z, p[2]->z, p[1]->z, p[0]->z);
+		__m256 in = _mm256_and_ps(_mm256_cmp_ps(x, x0, _CMP_GE_OQ), _mm256_cmp_ps(x, x1, _CMP_LE_OQ));
+		in = _mm256_and_ps(in, _mm256_and_ps(_mm256_cmp_ps(y, y0, _CMP_GE_OQ), _mm256_cmp_ps(y, y1, _CMP_LE_OQ)));
+		in = _mm256_and_ps(in, _mm256_and_ps(_mm256_cmp_ps(z, z0, _CMP_GE_OQ), _mm256_cmp_ps(z, z1, _CMP_LE_OQ)));
+		int mask = _mm256_movemask_ps(in);
+		for (int k = 0; k < 8; k++) {
+			out[count] = index[k];
+			count += (mask >> k) & 1;
+		}
+	}
+	return count + pointsInBoxTail(points, indices, i, n, box, out + count);
+}
+#elif defined(GEOM_USE_SSE)
+int pointsInBox(const glm::vec3 *points, const int *indices, int n, const Box &box, int *out) {
+	const Vector3 &bmin = box.parameters[0];
+	const Vector3 &bmax = box.parameters[1];
+	__m128 x0 = _mm_set1_ps(bmin.x()), y0 = _mm_set1_ps(bmin.y()), z0 = _mm_set1_ps(bmin.z());
+	__m128 x1 = _mm_set1_ps(bmax.x()), y1 = _mm_set1_ps(bmax.y()), z1 = _mm_set1_ps(bmax.z());
+
+	int count = 0;
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		int index[4];
+		for (int k = 0; k < 4; k++) index[k] = indices ? indices[i + k] : i + k;
+		const glm::vec3 &a = points[index[0]], &b = points[index[1]];
+		const glm::vec3 &c = points[index[2]], &d = points[index[3]];
+		__m128 x = _mm_set_ps(d.x, c.x, b.x, a.x);
+		__m128 y = _mm_set_ps(d.y, c.y, b.y, a.y);
+		__m128 z = _mm_set_ps(d.z, c.z, b.z, a.z);
+		__m128 in = _mm_and_ps(_mm_cmpge_ps(x, x0), _mm_cmple_ps(x, x1));
+		in = _mm_and_ps(in, _mm_and_ps(_mm_cmpge_ps(y, y0), _mm_cmple_ps(y, y1)));
+		in = _mm_and_ps(in, _mm_and_ps(_mm_cmpge_ps(z, z0), _mm_cmple_ps(z, z1)));
+		int mask = _mm_movemask_ps(in);
+		for (int k = 0; k < 4; k++) {
+			out[count] = index[k];
+			count += (mask >> k) & 1;
+		}
+	}
+	return count + pointsInBoxTail(points, indices, i, n, box, out + count);
+}
+#else
+int pointsInBox(const glm::vec3 *points, const int *indices, int n, const Box &box, int *out) {
+	return pointsInBoxScalar(points, indices, n, box, out);
+}
+#endif
+
+//  The slab test of Box::intersect() for one ray and many boxes.  The ray's
+//  direction is the same for every box, so the near and far planes of each
+//  slab are picked once, up front, instead of per box.
+//
+struct RaySlabs {
+	const float *nearX, *nearY, *nearZ;
+	const float *farX, *farY, *farZ;
+	float ox, oy, oz;
+	float ix, iy, iz;
+
+	RaySlabs(const Ray &ray, const BoxArray &b) {
+		nearX = ray.sign[0] ? b.maxX : b.minX;  farX = ray.sign[0] ? b.minX : b.maxX;
+		nearY = ray.sign[1] ? b.maxY : b.minY;  farY = ray.sign[1] ? b.minY : b.maxY;
+		nearZ = ray.sign[2] ? b.maxZ : b.minZ;  farZ = ray.sign[2] ? b.minZ : b.maxZ;
+		ox = ray.origin.x(); oy = ray.origin.y(); oz = ray.origin.z();
+		ix = ray.inv_direction.x(); iy = ray.inv_direction.y(); iz = ray.inv_direction.z();
+	}
+};
+
+//  boxes [begin, n) one at a time.  max / min are written the way the SSE
+//  max / min instructions work so the results match bit for bit.  As in
+//  Box::intersect(), a NaN distance (a ray in a slab's plane) is inside
+//  the slab: -inf if near, +inf if far.
+//
+static inline float nearT(float t) { return t == t ? t : -INFINITY; }
+static inline float farT(float t) { return t == t ? t : INFINITY; }
+
+static void rayHitsBoxesTail(const RaySlabs &s, int begin, int n, float t0, float t1, uint8_t *hit) {
+	for (int i = begin; i < n; i++) {
+		float nx = nearT((s.nearX[i] - s.ox) * s.ix), fx = farT((s.farX[i] - s.ox) * s.ix);
+		float ny = nearT((s.nearY[i] - s.oy) * s.iy), fy = farT((s.farY[i] - s.oy) * s.iy);
+		float nz = nearT((s.nearZ[i] - s.oz) * s.iz), fz = farT((s.farZ[i] - s.oz) * s.iz);
+		float tmin = nx > ny ? nx : ny;
+		tmin = tmin > nz ? tmin : nz;
+		float tmax = fx < fy ? fx : fy;
+		tmax = tmax < fz ? tmax : fz;
+		hit[i] = (tmin <= tmax) && (tmin < t1) && (tmax > t0);
+	}
+}
+
+void rayHitsBoxesScalar(const Ray &ray, const BoxArray &boxes, float t0, float t1, uint8_t *hit) {
+	rayHitsBoxesTail(RaySlabs(ray, boxes), 0, boxes.n, t0, t1, hit);
+}
+
+#if defined(GEOM_USE_AVX)
+void rayHitsBoxes(const Ray &ray, const BoxArray &boxes, float t0, float t1, uint8_t *hit) {
+	RaySlabs s(ray, boxes);
+	__m256 ox = _mm256_set1_ps(s.ox), oy = _mm256_set1_ps(s.oy), oz = _mm256_set1_ps(s.oz);
+	__m256 ix = _mm256_set1_ps(s.ix), iy = _mm256_set1_ps(s.iy), iz = _mm256_set1_ps(s.iz);
+	__m256 lo = _mm256_set1_ps(t0), hi = _mm256_set1_ps(t1);
+	__m256 ninf = _mm256_set1_ps(-INFINITY), pinf = _mm256_set1_ps(INFINITY);
+
+	// max / min with -inf / +inf replace NaN distances, as nearT() / farT()
+	//
+	int i = 0;
+	for (; i + 8 <= boxes.n; i += 8) {
+		__m256 nx = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(s.nearX + i), ox), ix), ninf);
+		__m256 ny = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(s.nearY + i), oy), iy), ninf);
+		__m256 nz = _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(s.nearZ + i), oz), iz), ninf);
+		__m256 fx = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(s.farX + i), ox), ix), pinf);
+		__m256 fy = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(s.farY + i), oy), iy), pinf);
+		__m256 fz = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(s.farZ + i), oz), iz), pinf);
+		__m256 tmin = _mm256_max_ps(_mm256_max_ps(nx, ny), nz);
+		__m256 tmax = _mm256_min_ps(_mm256_min_ps(fx, fy), fz);
+		__m256 h = _mm256_and_ps(_mm256_cmp_ps(tmin, tmax, _CMP_LE_OQ),
+			_mm256_and_ps(_mm256_cmp_ps(tmin, hi, _CMP_LT_OQ), _mm256_cmp_ps(tmax, lo, _CMP_GT_OQ)));
+		int mask = _mm256_movemask_ps(h);
+		for (int k = 0; k < 8; k++)
+			hit[i + k] = (mask >> k) & 1;
+	}
+	rayHitsBoxesTail(s, i, boxes.n, t0, t1, hit);
+}
+#elif defined(GEOM_USE_SSE)
+void rayHitsBoxes(const Ray &ray, const BoxArray &boxes, float t0, float t1, uint8_t *hit) {
+	RaySlabs s(ray, boxes);
+	__m128 ox = _mm_set1_ps(s.ox), oy = _mm_set1_ps(s.oy), oz = _mm_set1_ps(s.oz);
+	__m128 ix = _mm_set1_ps(s.ix), iy = _mm_set1_ps(s.iy), iz = _mm_set1_ps(s.iz);
+	__m128 lo = _mm_set1_ps(t0), hi = _mm_set1_ps(t1);
+	__m128 ninf = _mm_set1_ps(-INFINITY), pinf = _mm_set1_ps(INFINITY);
+
+	int i = 0;
+	for (; i + 4 <= boxes.n; i += 4) {
+		__m128 nx = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(s.nearX + i), ox), ix), ninf);
+		__m128 ny = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(s.nearY + i), oy), iy), ninf);
+		__m128 nz = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(s.nearZ + i), oz), iz), ninf);
+		__m128 fx = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(s.farX + i), ox), ix), pinf);
+		__m128 fy = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(s.farY + i), oy), iy), pinf);
+		__m128 fz = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(s.farZ + i), oz), iz), pinf);
+		__m128 tmin = _mm_max_ps(_mm_max_ps(nx, ny), nz);
+		__m128 tmax = _mm_min_ps(_mm_min_ps(fx, fy), fz);
+		__m128 h = _mm_and_ps(_mm_cmple_ps(tmin, tmax), _mm_and_ps(_mm_cmplt_ps(tmin, hi), _mm_cmpgt_ps(tmax, lo)));
+		int mask = _mm_movemask_ps(h);
+		for (int k = 0; k < 4; k++)
+			hit[i + k] = (mask >> k) & 1;
+	}
+	rayHitsBoxesTail(s, i, boxes.n, t0, t1, hit);
+}
+#else
+void rayHitsBoxes(const Ray &ray, const BoxArray &boxes, float t0, float t1, uint8_t *hit) {
+	rayHitsBoxesScalar(ray, boxes, t0, t1, hit);
+}
+#endif
+
+const char *geomBatchSimd() {
+#if defined(GEOM_USE_AVX)
+	return "AVX";
+#elif defined(GEOM_USE_SSE)
+	return "SSE";
+#else
+	return "none";
+#endif
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ofMain.h"
+#include "box.h"
+#include "ray.h"
+
+//  Batch versions of the Box tests, for the octree's inner loops: many
+//  points against one box, and one ray against many boxes.  They run 8
+//  wide with AVX or 4 wide with SSE, whichever the compiler targets, and
+//  fall back to plain C++.  The ...Scalar() versions are the plain C++
+//  ones and give the same results; they are kept for the benchmarks
+//  (--bench math).
+//
+
+//  boxes as separate coordinate arrays (structure of arrays), so a batch
+//  of them is read with straight vector loads
+//
+struct BoxArray {
+	const float *minX, *minY, *minZ;
+	const float *maxX, *maxY, *maxZ;
+	int n;
+};
+
+//  fixed storage for up to N boxes, e.g. the children of an octree node
+//
+template <int N>
+struct BoxBuffer {
+	alignas(32) float minX[N], minY[N], minZ[N];
+	alignas(32) float maxX[N], maxY[N], maxZ[N];
+	int n = 0;
+
+	void add(const Box &b) {
+		minX[n] = b.parameters[0].x(); minY[n] = b.parameters[0].y(); minZ[n] = b.parameters[0].z();
+		maxX[n] = b.parameters[1].x(); maxY[n] = b.parameters[1].y(); maxZ[n] = b.parameters[1].z();
+		n++;
+	}
+	BoxArray array() const { return { minX, minY, minZ, maxX, maxY, maxZ, n }; }
+};
+
+//  pointsInBox:  writes the index of each of the n points that is inside
+//  the box (borders included) to out, in order, and returns the count.
+//  The points are points[indices[i]], or points[i] if indices is NULL.
+//  out must have room for n entries.
+//
+int pointsInBox(const glm::vec3 *points, const int *indices, int n, const Box &box, int *out);
+int pointsInBoxScalar(const glm::vec3 *points, const int *indices, int n, const Box &box, int *out);
+
+//  rayHitsBoxes:  hit[i] = 1 if the ray hits box i within (t0, t1), else 0
+//
+void rayHitsBoxes(const Ray &ray, const BoxArray &boxes, float t0, float t1, uint8_t *hit);
+void rayHitsBoxesScalar(const Ray &ray, const BoxArray &boxes, float t0, float t1, uint8_t *hit);
+
+//  name of the instruction set the batch functions were built for
+//
+const char *geomBatchSimd();
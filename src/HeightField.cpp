@@ -0,0 +1,117 @@
+#include "HeightField.h"
+
+//  grid over the x/z bounds of the triangles (indexed, or every three
+//  points if there are no indices), cellSize apart.  A grid that would be
+//  too large is made coarser.  cellSize 0 is the mean x/z edge length.
+//
+void HeightField::build(const vector<glm::vec3> &points, const vector<ofIndexType> &indices, float size) {
+	heights.clear();
+	nx = nz = 0;
+	int numTriangles = indices.empty() ? points.size() / 3 : indices.size() / 3;
+	if (numTriangles == 0) return;
+	auto vertex = [&](int t, int k) -> const glm::vec3 & {
+		return points[indices.empty() ? 3 * t + k : indices[3 * t + k]];
+	};
+
+	if (size <= 0) {
+		double edges = 0;
+		for (int t = 0; t < numTriangles; t++) {
+			for (int k = 0; k < 3; k++) {
+				glm::vec3 e = vertex(t, (k + 1) % 3) - vertex(t, k);
+				edges += sqrt(e.x * e.x + e.z * e.z);
+			}
+		}
+		size = edges / (3 * numTriangles);
+	}
+
+	float maxX = -FLT_MAX, maxZ = -FLT_MAX;
+	minX = minZ = FLT_MAX;
+	for (int i = 0; i < points.size(); i++) {
+		minX = min(minX, points[i].x);
+		minZ = min(minZ, points[i].z);
+		maxX = max(maxX, points[i].x);
+		maxZ = max(maxZ, points[i].z);
+	}
+	const float maxPoints = 4096.0f * 4096.0f;
+	cellSize = max(size, sqrt((maxX - minX) * (maxZ - minZ) / maxPoints));
+	if (cellSize <= 0) cellSize = 1;
+	nx = (int)ceil((maxX - minX) / cellSize) + 1;
+	nz = (int)ceil((maxZ - minZ) / cellSize) + 1;
+	heights.assign(nx * nz, hole);
+
+	for (int t = 0; t < numTriangles; t++) {
+		const glm::vec3 &a = vertex(t, 0);
+		const glm::vec3 &b = vertex(t, 1);
+		const glm::vec3 &c = vertex(t, 2);
+
+		// barycentric coordinates in x/z; skip triangles seen edge on
+		//
+		float det = (b.z - c.z) * (a.x - c.x) + (c.x - b.x) * (a.z - c.z);
+		if (fabs(det) < 1e-12f) continue;
+
+		int x0 = max(0, (int)ceil((min(a.x, min(b.x, c.x)) - minX) / cellSize));
+		int x1 = min(nx - 1, (int)floor((max(a.x, max(b.x, c.x)) - minX) / cellSize));
+		int z0 = max(0, (int)ceil((min(a.z, min(b.z, c.z)) - minZ) / cellSize));
+		int z1 = min(nz - 1, (int)floor((max(a.z, max(b.z, c.z)) - minZ) / cellSize));
+		for (int z = z0; z <= z1; z++) {
+			float pz = minZ + z * cellSize;
+			for (int x = x0; x <= x1; x++) {
+				float px = minX + x * cellSize;
+				float l1 = ((b.z - c.z) * (px - c.x) + (c.x - b.x) * (pz - c.z)) / det;
+				float l2 = ((c.z - a.z) * (px - c.x) + (a.x - c.x) * (pz - c.z)) / det;
+				float l3 = 1 - l1 - l2;
+				const float eps = -1e-4f;
+				if (l1 < eps || l2 < eps || l3 < eps) continue;
+				float &h = heights[z * nx + x];
+				h = max(h, l1 * a.y + l2 * b.y + l3 * c.y);
+			}
+		}
+	}
+}
+
+//  heights at the four grid points around (x, z) - x, then z - and where
+//  (x, z) is between them.  False if outside the grid or over a hole;
+//  holes at some of the corners take the highest of the others.
+//
+bool HeightField::corners(float x, float z, float c[4], float &tx, float &tz) const {
+	if (nx < 2 || nz < 2 || !contains(x, z)) return false;
+	float fx = (x - minX) / cellSize, fz = (z - minZ) / cellSize;
+	int cx = min((int)fx, nx - 2), cz = min((int)fz, nz - 2);
+	tx = fx - cx;
+	tz = fz - cz;
+
+	const float *row = &heights[cz * nx + cx];
+	c[0] = row[0];
+	c[1] = row[1];
+	c[2] = row[nx];
+	c[3] = row[nx + 1];
+	float highest = max(max(c[0], c[1]), max(c[2], c[3]));
+	if (highest == hole) return false;
+	for (int k = 0; k < 4; k++)
+		if (c[k] == hole) c[k] = highest;
+	return true;
+}
+
+//  ground height at (x, z), hole if outside the grid or over a hole
+//
+float HeightField::height(float x, float z) const {
+	float c[4], tx, tz;
+	if (!corners(x, z, c, tx, tz)) return hole;
+	float hz0 = c[0] + (c[1] - c[0]) * tx;
+	float hz1 = c[2] + (c[3] - c[2]) * tx;
+	return hz0 + (hz1 - hz0) * tz;
+}
+
+//  height and normal at (x, z), false if outside the grid or over a hole
+//
+bool HeightField::lookup(float x, float z, float &h, glm::vec3 &normal) const {
+	float c[4], tx, tz;
+	if (!corners(x, z, c, tx, tz)) return false;
+	float hz0 = c[0] + (c[1] - c[0]) * tx;
+	float hz1 = c[2] + (c[3] - c[2]) * tx;
+	h = hz0 + (hz1 - hz0) * tz;
+	float dx = ((c[1] - c[0]) * (1 - tz) + (c[3] - c[2]) * tz) / cellSize;
+	float dz = (hz1 - hz0) / cellSize;
+	normal = glm::normalize(glm::vec3(-dx, 1, -dz));
+	return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ofMain.h"
+
+//  Terrain heights on a regular x/z grid, for "how high is the ground
+//  here" at the cost of four loads - fast enough to test every particle
+//  against the ground every step.
+//
+//  build() rasterizes the mesh's triangles into the grid: a grid point
+//  gets the height of the highest triangle over it, points no triangle
+//  covers are holes.  height() interpolates between the four grid points
+//  around (x, z), lookup() adds the normal of that surface.  The grid
+//  spacing defaults to the mean length of the triangles' edges in x/z.
+//
+class HeightField {
+public:
+	void build(const vector<glm::vec3> &points, const vector<ofIndexType> &indices, float cellSize = 0);
+	bool contains(float x, float z) const {
+		return x >= minX && z >= minZ && x <= minX + (nx - 1) * cellSize && z <= minZ + (nz - 1) * cellSize;
+	}
+	float height(float x, float z) const;
+	bool lookup(float x, float z, float &h, glm::vec3 &normal) const;
+	size_t memory() const { return heights.size() * sizeof(float); }
+
+	static constexpr float hole = -FLT_MAX;
+
+	float minX = 0, minZ = 0;   // grid point (0, 0)
+	float cellSize = 1;
+	int nx = 0, nz = 0;         // grid points
+	vector<float> heights;      // nx x nz, x first
+
+private:
+	bool corners(float x, float z, float c[4], float &tx, float &tz) const;
+};
+
+//  The ground over several height fields (one per resident terrain tile).
+//  Where fields overlap the highest wins.
+//
+struct GroundHeight {
+	vector<const HeightField *> fields;
+
+	float height(float x, float z) const {
+		float h = HeightField::hole;
+		for (int i = 0; i < fields.size(); i++)
+			h = max(h, fields[i]->height(x, z));
+		return h;
+	}
+	bool lookup(float x, float z, float &h, glm::vec3 &normal) const {
+		bool found = false;
+		for (int i = 0; i < fields.size(); i++) {
+			float fh;
+			glm::vec3 fn;
+			if (fields[i]->lookup(x, z, fh, fn) && (!found || fh > h)) {
+				h = fh;
+				normal = fn;
+				found = true;
+			}
+		}
+		return found;
+	}
+};
@@ -0,0 +1,32 @@
+#include "InputQueue.h"
+
+void KeyState::apply(const InputEvent &e) {
+	if (e.key < 0 || e.key >= numKeys) return;
+	if (e.pressed) {
+		held[e.key] = true;
+		tapped[e.key] = true;
+	}
+	else
+		held[e.key] = false;
+}
+
+//  called from the platform's event callbacks (the producer thread).  Key
+//  repeat sends more presses of a held key, they change nothing.
+//
+void InputQueue::push(int key, bool pressed) {
+	if (!events.push({ key, pressed, ofGetElapsedTimeMicros() }))
+		dropped++;
+}
+
+//  called by the simulation (the consumer thread) before each step: apply
+//  the events up to real time "until" (us) to keys, in order.  Taps from
+//  the previous fold are cleared first.
+//
+void InputQueue::fold(KeyState &keys, uint64_t until) {
+	keys.clearTaps();
+	while (const InputEvent *e = events.front()) {
+		if (e->time > until) break;
+		keys.apply(*e);
+		events.pop();
+	}
+}
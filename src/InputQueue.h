@@ -0,0 +1,98 @@
+#pragma once
+
+#include "ofMain.h"
+#include <atomic>
+#include <bitset>
+
+//  Keyboard input from the platform's event callbacks to the simulation.
+//
+//  keyPressed() / keyReleased() push timestamped events into a lock free
+//  single producer / single consumer ring; at the start of every fixed
+//  step the simulation folds the events that happened before the step's
+//  end (in real time) into a fixed size key state.  An input is applied
+//  to the step it happened in whatever the frame rate, and the two sides
+//  share no lock - the simulation can run on its own thread.
+//
+
+//  ring buffer for one producer thread and one consumer thread.  Capacity
+//  must be a power of two.
+//
+template <class T, int Capacity>
+class SpscQueue {
+public:
+	static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+	// producer
+	//
+	bool push(const T &item) {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) == Capacity)
+			return false;
+		items[h & (Capacity - 1)] = item;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer - the oldest item, NULL if empty, and removing it (or
+	// moving it out)
+	//
+	const T * front() const {
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire))
+			return NULL;
+		return &items[t & (Capacity - 1)];
+	}
+	void pop() {
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+	bool pop(T &item) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire))
+			return false;
+		item = std::move(items[t & (Capacity - 1)]);
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	alignas(64) std::atomic<size_t> head{ 0 };     // next slot to write
+	alignas(64) std::atomic<size_t> tail{ 0 };     // next slot to read
+	T items[Capacity];
+};
+
+struct InputEvent {
+	int key;
+	bool pressed;
+	uint64_t time;      // ofGetElapsedTimeMicros()
+};
+
+//  which keys are down.  oF's key codes are characters below 256, the
+//  special keys OF_KEY_MODIFIER (0x100) and up and the modifier keys up to
+//  OF_KEY_SUPER (0x1000) and its left/right variants, so numKeys bits hold
+//  all of them; others (unicode text input) are ignored.  A key pressed and
+//  released between two folds still counts as down for one step.
+//
+class KeyState {
+public:
+	static const int numKeys = 0x2000;
+
+	bool down(int key) const {
+		return key >= 0 && key < numKeys && (held[key] || tapped[key]);
+	}
+	void apply(const InputEvent &e);
+	void clearTaps() { tapped.reset(); }
+
+private:
+	std::bitset<numKeys> held, tapped;
+};
+
+class InputQueue {
+public:
+	void push(int key, bool pressed);
+	void fold(KeyState &keys, uint64_t until);
+
+	std::atomic<int> dropped{ 0 };     // events lost to a full queue
+
+private:
+	SpscQueue<InputEvent, 1024> events;
+};
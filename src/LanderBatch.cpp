@@ -0,0 +1,283 @@
+#include "LanderBatch.h"
+#include "Profiler.h"
+#include "SimClock.h"
+
+LanderBatch::LanderBatch() {
+}
+
+//  terrain is not owned and may be shared by any number of batches
+//
+void LanderBatch::setup(const Octree *terrain, const glm::vec3 &bmin, const glm::vec3 &bmax) {
+	shared.setup(terrain, bmin, bmax);
+}
+
+//  n landers; new ones are at rest at the shared sim's start position
+//
+void LanderBatch::resize(int n) {
+	int old = size();
+	id.resize(n);
+	px.resize(n); py.resize(n); pz.resize(n);
+	vx.resize(n); vy.resize(n); vz.resize(n);
+	fx.resize(n); fy.resize(n); fz.resize(n);
+	rot.resize(n); angularVelocity.resize(n); angularForce.resize(n);
+	altitude.resize(n);
+	fuelLevel.resize(n); initialFuel.resize(n); usedFuel.resize(n); fuelStart.resize(n);
+	thrust.resize(n); fuel.resize(n);
+	state.resize(n);
+	outcomeTime.resize(n);
+	input.resize(n);
+	rng.resize(n);
+	for (int i = old; i < n; i++) {
+		id[i] = i;
+		reset(i, shared.pos, shared.initialFuel);
+	}
+}
+
+//  put lander i at startPos, at rest with a full tank (as LanderSim::reset())
+//
+void LanderBatch::reset(int i, const glm::vec3 &startPos, float fuelAmount) {
+	px[i] = startPos.x; py[i] = startPos.y; pz[i] = startPos.z;
+	vx[i] = vy[i] = vz[i] = 0;
+	fx[i] = fy[i] = fz[i] = 0;
+	rot[i] = angularVelocity[i] = angularForce[i] = 0;
+	altitude[i] = FLT_MAX;
+
+	fuelLevel[i] = fuelAmount;
+	initialFuel[i] = fuelAmount;
+	usedFuel[i] = 0;
+	fuelStart[i] = 0;
+	fuel[i] = false;
+	thrust[i] = false;
+
+	state[i] = LanderFlying;
+	outcomeTime[i] = 0;
+	input[i] = 0;
+}
+
+//  advance landers [begin, end) by dt seconds with their input[].  now is
+//  the simulation time at the end of the step.  Each phase below is the
+//  matching part of LanderSim::step(), in the same order.
+//
+void LanderBatch::step(int begin, int end, float dt, float now) {
+	const vector<const Octree *> &terrain = shared.terrain;
+
+	// altitude above ground, from before the move
+	//
+	if (shared.measureAltitude && terrain.size() > 0) {
+		PROFILE_SCOPE("altitude ray");
+		for (int i = begin; i < end; i++) {
+			glm::vec3 pos(px[i], py[i], pz[i]);
+			Ray ray = Ray(pos, Vector3(0, -1, 0));
+			float a = FLT_MAX;
+			for (int t = 0; t < terrain.size(); t++) {
+				const TreeNode *node = terrain[t]->intersect(ray);
+				if (node)
+					a = min(a, glm::distance(pos, node->box.center().to<glm::vec3>()));
+			}
+			altitude[i] = a;
+		}
+	}
+
+	// integrate last step's forces - branch free loops over the arrays
+	//
+	float invMass = 1 / shared.mass;
+	float damping = SimClock::damping(shared.damping, dt);
+	for (int i = begin; i < end; i++) {
+		px[i] += vx[i] * dt;
+		py[i] += vy[i] * dt;
+		pz[i] += vz[i] * dt;
+	}
+	for (int i = begin; i < end; i++) {
+		vx[i] = (vx[i] + invMass * fx[i] * dt) * damping;
+		vy[i] = (vy[i] + invMass * fy[i] * dt) * damping;
+		vz[i] = (vz[i] + invMass * fz[i] * dt) * damping;
+	}
+	for (int i = begin; i < end; i++) {
+		rot[i] += angularVelocity[i] * dt;
+		angularVelocity[i] = (angularVelocity[i] + invMass * angularForce[i] * dt) * damping;
+	}
+
+	// new forces: gravity, then input and fuel for landers still flying
+	//
+	glm::vec3 weight = shared.gravity * shared.mass;
+	for (int i = begin; i < end; i++) {
+		glm::vec3 force(0, 0, 0);
+		float angular = 0;
+		force += weight;
+
+		if (state[i] == LanderFlying) {
+			LanderInput in = LanderInput::fromBits(input[i]);
+			if (in.thrust && fuelLevel[i] > 0) {
+				force += glm::vec3(0, 10, 0);
+				thrust[i] = true;
+				force += glm::vec3(rng[i].uniform(shared.turbMin, shared.turbMax));
+			}
+			else
+				thrust[i] = false;
+
+			if (fuelLevel[i] > 0) {
+				if (in.left)
+					angular += 100;
+				if (in.right)
+					angular -= 100;
+				if (in.forward)
+					force += LanderSim::heading(rot[i]) * 10;
+				if (in.back)
+					force -= LanderSim::heading(rot[i]) * 10;
+			}
+
+			if (in.any() && fuelLevel[i] > 0) {
+				if (!fuel[i])
+					fuelStart[i] = now;
+				fuel[i] = true;
+				usedFuel[i] = now - fuelStart[i];
+				fuelLevel[i] = initialFuel[i] - usedFuel[i];
+			}
+			else {
+				if (fuel[i])
+					initialFuel[i] -= usedFuel[i];
+				fuel[i] = false;
+			}
+		}
+		else
+			thrust[i] = false;
+
+		fx[i] = force.x;
+		fy[i] = force.y;
+		fz[i] = force.z;
+		angularForce[i] = angular;
+	}
+
+	// collision with the terrain, the landing rules and the bounce
+	//
+	PROFILE_SCOPE("collision query");
+	vector<Box> hits;
+	for (int i = begin; i < end; i++) {
+		glm::vec3 pos(px[i], py[i], pz[i]);
+		Box b(shared.boundsMin + pos, shared.boundsMax + pos);
+		hits.clear();
+		for (int t = 0; t < terrain.size(); t++)
+			terrain[t]->intersect(b, terrain[t]->root, hits);
+		if (hits.size() < 5)
+			continue;
+
+		glm::vec3 velocity(vx[i], vy[i], vz[i]);
+		bool playing = state[i] == LanderFlying;
+		if (glm::length(velocity) > 3 && playing) {
+			state[i] = LanderExploded;
+			outcomeTime[i] = now;
+			glm::vec3 force(fx[i], fy[i], fz[i]);
+			force += glm::vec3((rng[i].uniform(-1, 1) > 0 ? 1 : -1) * 3000, 3000, (rng[i].uniform(-1, 1) > 0 ? 1 : -1) * 3000);
+			fx[i] = force.x;
+			fy[i] = force.y;
+			fz[i] = force.z;
+			continue;
+		}
+		else if (glm::length(velocity) < 3 && playing) {
+			state[i] = shared.inLandingZone(pos) ? LanderLanded : LanderMissed;
+			outcomeTime[i] = now;
+		}
+
+		// push back along the normal from the closest box hit
+		//
+		glm::vec3 p2 = b.center().to<glm::vec3>();
+		glm::vec3 p1;
+		float closest = FLT_MAX;
+		for (int k = 0; k < hits.size(); k++) {
+			glm::vec3 point = hits[k].center().to<glm::vec3>();
+			float distance = glm::length(p2 - point);
+			if (distance < closest) {
+				closest = distance;
+				p1 = point;
+			}
+		}
+		float e = 0.1;
+		glm::vec3 n = glm::normalize(p2 - p1);
+		glm::vec3 p = (e + 1) * (-glm::dot(velocity, n)) * n;
+		vx[i] = p.x;
+		vy[i] = p.y;
+		vz[i] = p.z;
+	}
+}
+
+//  move the landers in [begin, end) that have an outcome to the back of the
+//  range, return the end of the ones still flying
+//
+int LanderBatch::compact(int begin, int end) {
+	for (int i = begin; i < end; ) {
+		if (state[i] != LanderFlying)
+			swap(i, --end);
+		else
+			i++;
+	}
+	return end;
+}
+
+void LanderBatch::swap(int a, int b) {
+	std::swap(id[a], id[b]);
+	std::swap(px[a], px[b]); std::swap(py[a], py[b]); std::swap(pz[a], pz[b]);
+	std::swap(vx[a], vx[b]); std::swap(vy[a], vy[b]); std::swap(vz[a], vz[b]);
+	std::swap(fx[a], fx[b]); std::swap(fy[a], fy[b]); std::swap(fz[a], fz[b]);
+	std::swap(rot[a], rot[b]);
+	std::swap(angularVelocity[a], angularVelocity[b]);
+	std::swap(angularForce[a], angularForce[b]);
+	std::swap(altitude[a], altitude[b]);
+	std::swap(fuelLevel[a], fuelLevel[b]);
+	std::swap(initialFuel[a], initialFuel[b]);
+	std::swap(usedFuel[a], usedFuel[b]);
+	std::swap(fuelStart[a], fuelStart[b]);
+	std::swap(thrust[a], thrust[b]);
+	std::swap(fuel[a], fuel[b]);
+	std::swap(state[a], state[b]);
+	std::swap(outcomeTime[a], outcomeTime[b]);
+	std::swap(input[a], input[b]);
+	std::swap(rng[a], rng[b]);
+}
+
+//  lander i as a LanderSim with the shared setup, e.g. to compare
+//  stateHash()es or to carry on with it alone
+//
+void LanderBatch::toSim(int i, LanderSim &sim) const {
+	sim = shared;
+	sim.pos = position(i);
+	sim.velocity = velocity(i);
+	sim.force = glm::vec3(fx[i], fy[i], fz[i]);
+	sim.rot = rot[i];
+	sim.angularVelocity = angularVelocity[i];
+	sim.angularForce = angularForce[i];
+	sim.altitude = altitude[i];
+	sim.fuelLevel = fuelLevel[i];
+	sim.initialFuel = initialFuel[i];
+	sim.usedFuel = usedFuel[i];
+	sim.fuelStart = fuelStart[i];
+	sim.fuel = fuel[i];
+	sim.thrust = thrust[i];
+	sim.gameOver = state[i] == LanderExploded;
+	sim.gameComplete = state[i] == LanderLanded;
+	sim.gameEnd = state[i] == LanderMissed;
+	sim.explosionStart = sim.gameOver ? outcomeTime[i] : 0;
+	sim.landingStart = sim.gameOver ? 0 : outcomeTime[i];
+	sim.rng = rng[i];
+}
+
+//  lander i takes over sim's lander state (the shared setup is not changed)
+//
+void LanderBatch::fromSim(int i, const LanderSim &sim) {
+	px[i] = sim.pos.x; py[i] = sim.pos.y; pz[i] = sim.pos.z;
+	vx[i] = sim.velocity.x; vy[i] = sim.velocity.y; vz[i] = sim.velocity.z;
+	fx[i] = sim.force.x; fy[i] = sim.force.y; fz[i] = sim.force.z;
+	rot[i] = sim.rot;
+	angularVelocity[i] = sim.angularVelocity;
+	angularForce[i] = sim.angularForce;
+	altitude[i] = sim.altitude;
+	fuelLevel[i] = sim.fuelLevel;
+	initialFuel[i] = sim.initialFuel;
+	usedFuel[i] = sim.usedFuel;
+	fuelStart[i] = sim.fuelStart;
+	fuel[i] = sim.fuel;
+	thrust[i] = sim.thrust;
+	state[i] = sim.outcome();
+	outcomeTime[i] = sim.gameOver ? sim.explosionStart : sim.landingStart;
+	input[i] = 0;
+	rng[i] = sim.rng;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ofMain.h"
+#include "LanderSim.h"
+
+//  Many independent landers simulated together, for training and
+//  evaluating autopilots.
+//
+//  The state of lander i is element i of one array per field (structure of
+//  arrays), so the integration runs as straight loops over contiguous
+//  floats that the compiler vectorizes, and the per lander work that can't
+//  be (input, fuel, the octree queries) touches only the fields it needs.
+//  A step is the same arithmetic as LanderSim::step(), so a lander here
+//  ends up bit for bit where a LanderSim given the same seed and input
+//  would (toSim() and LanderSim::stateHash() check that), and a LanderSim
+//  can be carried on as many landers (fromSim()).
+//
+//  Everything the landers share - terrain, bounds, landing zones, mass,
+//  gravity, turbulence - is taken from "shared", a LanderSim whose own
+//  lander isn't used.  The terrain is read only, so any number of threads
+//  may step disjoint ranges of one batch at once:
+//
+//      batch.input[i] = pilot(batch, i).bits();     // for i in [begin, end)
+//      batch.step(begin, end, dt, now);
+//      end = batch.compact(begin, end);             // drop finished landers
+//
+//  There are no events or end of game timers; a lander is done when its
+//  outcome is decided, and compact() moves it out of the way.
+//
+class LanderBatch {
+public:
+	LanderBatch();
+
+	void setup(const Octree *terrain, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+	void resize(int n);
+	int size() const { return px.size(); }
+
+	void reset(int i, const glm::vec3 &startPos, float fuel = 120);
+	void step(int begin, int end, float dt, float now);
+	int compact(int begin, int end);
+
+	LanderOutcome outcome(int i) const { return (LanderOutcome)state[i]; }
+	glm::vec3 position(int i) const { return glm::vec3(px[i], py[i], pz[i]); }
+	glm::vec3 velocity(int i) const { return glm::vec3(vx[i], vy[i], vz[i]); }
+	void toSim(int i, LanderSim &sim) const;
+	void fromSim(int i, const LanderSim &sim);
+
+	LanderSim shared;
+
+	// lander state, one element per lander
+	//
+	vector<int> id;                     // index the lander was reset at (compact() moves landers)
+	vector<float> px, py, pz;
+	vector<float> vx, vy, vz;
+	vector<float> fx, fy, fz;
+	vector<float> rot, angularVelocity, angularForce;
+	vector<float> altitude;
+	vector<float> fuelLevel, initialFuel, usedFuel, fuelStart;
+	vector<uint8_t> thrust, fuel;
+	vector<uint8_t> state;              // LanderOutcome
+	vector<float> outcomeTime;          // simulation time the outcome was decided
+	vector<uint8_t> input;              // LanderInput::bits() for the next step
+	vector<Rng> rng;
+
+private:
+	void swap(int a, int b);
+};
@@ -0,0 +1,299 @@
+
+#include "LanderSim.h"
+#include "Profiler.h"
+#include "SimClock.h"
+
+LanderSim::LanderSim() {
+	boundsMin = glm::vec3(-1, -1, -1);
+	boundsMax = glm::vec3(1, 1, 1);
+	zones = defaultLandingZones();
+
+	mass = 1.0;
+	damping = .99;
+	gravity = glm::vec3(0, -2, 0);
+	turbMin = glm::vec3(-10, -10, -10);
+	turbMax = glm::vec3(10, 10, 10);
+	measureAltitude = true;
+	endDelay = 3;
+
+	reset(glm::vec3(0, 50, 0));
+}
+
+//  terrain is not owned and may be shared by any number of sims
+//
+void LanderSim::setup(const Octree *t, const glm::vec3 &bmin, const glm::vec3 &bmax) {
+	terrain.clear();
+	if (t) terrain.push_back(t);
+	boundsMin = bmin;
+	boundsMax = bmax;
+}
+
+//  put the lander back at startPos, at rest with a full tank
+//
+void LanderSim::reset(const glm::vec3 &startPos, float fuelAmount) {
+	pos = startPos;
+	velocity = glm::vec3(0, 0, 0);
+	acceleration = glm::vec3(0, 0, 0);
+	force = glm::vec3(0, 0, 0);
+	rot = 0;
+	angularVelocity = 0;
+	angularAcceleration = 0;
+	angularForce = 0;
+	altitude = FLT_MAX;
+
+	fuelLevel = fuelAmount;
+	initialFuel = fuelAmount;
+	usedFuel = 0;
+	fuelStart = 0;
+	fuel = false;
+	thrust = false;
+
+	gameOver = false;
+	gameComplete = false;
+	gameEnd = false;
+	explosionStart = 0;
+	landingStart = 0;
+
+	colBoxList.clear();
+	events = LanderEvents();
+}
+
+//  the landing zones of the game - these match spotlights 2-4 in ofApp::setup()
+//
+vector<LandingZone> LanderSim::defaultLandingZones() {
+	vector<LandingZone> z;
+	z.push_back({ glm::vec3(-100, 100, 30), glm::vec3(0, -1, 0), 45, 20 });
+	z.push_back({ glm::vec3(110, 60, 120), glm::vec3(0, -1, 0), 45, 20 });
+	z.push_back({ glm::vec3(30, 70, -145), glm::vec3(0, -1, 0), 45, 20 });
+	return z;
+}
+
+LanderOutcome LanderSim::outcome() const {
+	if (gameOver) return LanderExploded;
+	if (gameComplete) return LanderLanded;
+	if (gameEnd) return LanderMissed;
+	return LanderFlying;
+}
+
+const char * LanderSim::outcomeName(LanderOutcome outcome) {
+	switch (outcome) {
+	case LanderExploded: return "exploded";
+	case LanderLanded: return "landed in spotlight";
+	case LanderMissed: return "missed";
+	default: return "flying";
+	}
+}
+
+//  check if a point is inside the cone of one of the landing zone spotlights
+//
+bool LanderSim::inLandingZone(const glm::vec3 &p) const {
+	for (int i = 0; i < zones.size(); i++) {
+		const LandingZone &zone = zones[i];
+		glm::vec3 spotlightDir = glm::normalize(zone.lightDir);
+		glm::vec3 toLander = glm::normalize(p - zone.lightPos);
+
+		float distance = glm::length(toLander);
+		if (distance > zone.radius)
+			continue;
+		float delta = glm::degrees(glm::acos(glm::dot(spotlightDir, toLander)));
+		if (delta <= zone.angle)
+			return true;
+	}
+	return false;
+}
+
+//  world space bounding box of the lander
+//
+Box LanderSim::bounds() const {
+	return Box(boundsMin + pos, boundsMax + pos);
+}
+
+//  direction a lander rotated by rot degrees is facing
+//
+glm::vec3 LanderSim::heading(float rot) {
+	return glm::vec3(glm::rotate(glm::mat4(1.0), glm::radians(rot), glm::vec3(0, 1, 0)) * glm::vec4(1, 0, 0, 1));
+}
+
+//  hash (FNV-1a) of the lander's state and the game state, to tell whether
+//  two runs got exactly the same results
+//
+uint64_t LanderSim::stateHash() const {
+	float f[] = { pos.x, pos.y, pos.z, velocity.x, velocity.y, velocity.z, force.x, force.y, force.z,
+		rot, angularVelocity, angularForce, fuelLevel, initialFuel, altitude };
+	uint8_t flags = (thrust ? 1 : 0) | (fuel ? 2 : 0) | (gameOver ? 4 : 0) | (gameComplete ? 8 : 0) | (gameEnd ? 16 : 0);
+	uint64_t h = 0xcbf29ce484222325ULL;
+	const uint8_t *bytes = (const uint8_t *)f;
+	for (int i = 0; i < sizeof(f); i++)
+		h = (h ^ bytes[i]) * 0x100000001b3ULL;
+	return (h ^ flags) * 0x100000001b3ULL;
+}
+
+//  altitude at the lander's position, by a ray query straight down
+//
+void LanderSim::updateAltitude() {
+	if (terrain.size() == 0) return;
+	PROFILE_SCOPE("altitude ray");
+	Ray ray = Ray(pos, Vector3(0, -1, 0));
+	altitude = FLT_MAX;
+	for (int i = 0; i < terrain.size(); i++) {
+		const TreeNode *node = terrain[i]->intersect(ray);
+		if (node)
+			altitude = min(altitude, glm::distance(pos, node->box.center().to<glm::vec3>()));
+	}
+}
+
+//  advance the lander by dt seconds.  now is the simulation time at the
+//  end of the step (used for fuel and the end of game timers).
+//
+void LanderSim::step(float dt, float now, const LanderInput &input) {
+	events = LanderEvents();
+
+	// Measure distance -----------------------------------------------------------------------------
+	if (measureAltitude)
+		updateAltitude();
+
+	// Lander physics simulation -----------------------------------------------------------------------------
+
+	// damping is per 1/60 sec step, the same per second at any step rate
+	float stepDamping = SimClock::damping(damping, dt);
+
+	//move up/down (linear)
+	pos += velocity * dt;
+	acceleration = (1 / mass) * force;
+	velocity += acceleration * dt;
+	velocity *= stepDamping;
+
+	//rotate (angular)
+	rot += angularVelocity * dt;
+	angularAcceleration = (1 / mass) * angularForce;
+	angularVelocity += angularAcceleration * dt;
+	angularVelocity *= stepDamping;
+
+	// Zero out forces
+	force = glm::vec3(0, 0, 0);
+	angularForce = 0;
+
+	// Add forces -----------------------------------------------------------------------------
+	force += gravity * mass; // Gravity
+
+	// Handle input -----------------------------------------------------------------------------
+	if (!gameOver && !gameComplete && !gameEnd) {
+		if (input.thrust && fuelLevel > 0) {
+			force += glm::vec3(0, 10, 0);
+
+			if (!thrust)
+				events.thrustStarted = true;
+			thrust = true;
+
+			// Turbulence effect
+			force += glm::vec3(rng.uniform(turbMin, turbMax));
+		}
+		else {
+			if (thrust)
+				events.thrustStopped = true;
+			thrust = false;
+		}
+
+		if (fuelLevel > 0) {
+			if (input.left)
+				angularForce += 100;
+			if (input.right)
+				angularForce -= 100;
+			if (input.forward)
+				force += heading() * 10;
+			if (input.back)
+				force -= heading() * 10;
+		}
+
+		// Track fuel consumption
+		if (input.any() && fuelLevel > 0) {
+			if (!fuel) {
+				// Mark fuel start
+				fuelStart = now;
+			}
+			fuel = true;
+
+			// Update fuel level
+			usedFuel = now - fuelStart;
+			fuelLevel = initialFuel - usedFuel;
+		}
+		else {
+			if (fuel) {
+				// Update fuel level
+				initialFuel -= usedFuel;
+			}
+			fuel = false;
+		}
+	}
+	else {
+		// End thrust if still on
+		if (thrust)
+			events.thrustStopped = true;
+		thrust = false;
+	}
+
+	// Collision -----------------------------------------------------------------------------
+	Box b = bounds();
+
+	colBoxList.clear();
+	{
+		PROFILE_SCOPE("collision query");
+		for (int i = 0; i < terrain.size(); i++)
+			terrain[i]->intersect(b, terrain[i]->root, colBoxList);
+	}
+
+	bool playing = !gameOver && !gameComplete && !gameEnd;
+
+	if (colBoxList.size() >= 5) {
+		// Explosion (return, end game if true)
+		if (glm::length(velocity) > 3 && playing) {
+			explosionStart = now;
+			events.exploded = true;
+
+			// Apply game over, explode lander in random upward direction
+			gameOver = true;
+			force += glm::vec3((rng.uniform(-1, 1) > 0 ? 1 : -1) * 3000, 3000, (rng.uniform(-1, 1) > 0 ? 1 : -1) * 3000);
+			return;
+		} else if (glm::length(velocity) < 3 && playing) {
+			landingStart = now;
+			events.touchedDown = true;
+			if (inLandingZone(pos))
+				gameComplete = true;
+			else
+				gameEnd = true;
+		}
+
+		// Resolution
+		glm::vec3 p2 = b.center().to<glm::vec3>(); // Center of lander box
+
+		// Find closest box center
+		glm::vec3 p1;
+		float min = FLT_MAX;
+		for (int i = 0; i < colBoxList.size(); i++) {
+			glm::vec3 point = colBoxList[i].center().to<glm::vec3>();
+			float distance = glm::length(p2 - point);
+			if (distance < min) {
+				min = distance;
+				p1 = point;
+			}
+		}
+
+		float e = 0.1; // Restitution (0-1)
+		glm::vec3 n = glm::normalize(p2 - p1); // Normal
+		glm::vec3 p = (e + 1) * (-glm::dot(velocity, n)) * n; // Impulse force (assume mass 1, inf)
+
+		// Apply impulse directly to velocity (adjusts velocity, not forces)
+		velocity = p;
+	}
+	else {
+		// Stop once the explosion or landing has played out
+		if (gameOver) {
+			if (now - explosionStart > endDelay)
+				events.finished = true;
+		}
+		else if (gameComplete || gameEnd) {
+			if (now - landingStart > endDelay)
+				events.finished = true;
+		}
+	}
+}
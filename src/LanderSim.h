@@ -0,0 +1,131 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Octree.h"
+#include "Random.h"
+
+//  Lander simulation core - physics, octree collision, fuel and the
+//  landing rules, with no dependency on the window, camera, models or
+//  sound.  ofApp drives one of these per game, the batch runner drives
+//  thousands of them headless (or LanderBatch, the same simulation for
+//  many landers at once).
+//
+
+//  A landing zone is the cone of a spotlight.  The lander has to come to
+//  rest inside one of them.
+//
+struct LandingZone {
+	glm::vec3 lightPos;
+	glm::vec3 lightDir;
+	float angle;        // degrees
+	float radius;
+};
+
+//  Control input for one simulation step.  bits() packs it into a byte
+//  (the form LanderBatch and the replay log keep it in).
+//
+struct LanderInput {
+	enum { Thrust = 1, Left = 2, Right = 4, Forward = 8, Back = 16 };
+
+	bool thrust = false;
+	bool left = false;
+	bool right = false;
+	bool forward = false;
+	bool back = false;
+
+	bool any() const { return thrust || left || right || forward || back; }
+	uint8_t bits() const {
+		return (thrust ? Thrust : 0) | (left ? Left : 0) | (right ? Right : 0) | (forward ? Forward : 0) | (back ? Back : 0);
+	}
+	static LanderInput fromBits(uint8_t bits) {
+		LanderInput input;
+		input.thrust = bits & Thrust;
+		input.left = bits & Left;
+		input.right = bits & Right;
+		input.forward = bits & Forward;
+		input.back = bits & Back;
+		return input;
+	}
+};
+
+typedef enum { LanderFlying, LanderExploded, LanderLanded, LanderMissed } LanderOutcome;
+
+//  Things that happened during the last step, so the app can start or
+//  stop effects and sounds to match.
+//
+struct LanderEvents {
+	bool thrustStarted = false;
+	bool thrustStopped = false;
+	bool exploded = false;
+	bool touchedDown = false;
+	bool finished = false;      // outcome has been shown long enough - game should stop
+};
+
+class LanderSim {
+public:
+	LanderSim();
+
+	void setup(const Octree *terrain, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+	void reset(const glm::vec3 &startPos, float fuel = 120);
+	void step(float dt, float now, const LanderInput &input);
+	void updateAltitude();
+
+	LanderOutcome outcome() const;
+	bool inLandingZone(const glm::vec3 &p) const;
+	Box bounds() const;
+	glm::vec3 heading() const { return heading(rot); }
+	static glm::vec3 heading(float rot);
+	uint64_t stateHash() const;
+
+	static vector<LandingZone> defaultLandingZones();
+	static const char * outcomeName(LanderOutcome outcome);
+
+	// terrain and lander geometry.  The terrain may be split over several
+	// octrees (streamed tiles), all are checked.
+	//
+	vector<const Octree *> terrain;
+	glm::vec3 boundsMin, boundsMax;     // relative to the lander position
+	vector<LandingZone> zones;
+
+	// lander state
+	//
+	glm::vec3 pos;
+	glm::vec3 velocity;
+	glm::vec3 acceleration;
+	glm::vec3 force;
+	float rot;
+	float angularVelocity;
+	float angularAcceleration;
+	float angularForce;
+	float mass;
+	float damping;      // velocity kept per 1/60 sec (SimClock::damping())
+
+	// environment
+	//
+	glm::vec3 gravity;
+	glm::vec3 turbMin, turbMax;
+	Rng rng;
+
+	// altitude above ground level (measured by an octree ray query)
+	//
+	bool measureAltitude;
+	float altitude;
+
+	// fuel
+	//
+	float fuelLevel, initialFuel, usedFuel, fuelStart;
+	bool fuel;
+	bool thrust;
+
+	// game state
+	//
+	bool gameOver;          // exploded
+	bool gameComplete;      // landed in a landing zone
+	bool gameEnd;           // landed outside the landing zones
+	float explosionStart;
+	float landingStart;
+	float endDelay;         // sec the outcome is shown before the game stops
+
+	vector<Box> colBoxList;
+	LanderEvents events;
+};
@@ -0,0 +1,396 @@
+
+#include "ObjLoader.h"
+#include <thread>
+#include <fstream>
+#include <unordered_map>
+#include <filesystem>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//  read only memory mapping of a whole file
+//
+class MappedFile {
+public:
+	MappedFile(const string &path);
+	~MappedFile();
+
+	const char *data = NULL;
+	size_t size = 0;
+
+private:
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int fd = -1;
+#endif
+};
+
+#ifdef _WIN32
+MappedFile::MappedFile(const string &path) {
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) return;
+	LARGE_INTEGER len;
+	if (!GetFileSizeEx(file, &len) || len.QuadPart == 0) return;
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) return;
+	data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data) size = len.QuadPart;
+}
+
+MappedFile::~MappedFile() {
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+#else
+MappedFile::MappedFile(const string &path) {
+	fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) return;
+	void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) return;
+	madvise(p, st.st_size, MADV_SEQUENTIAL);
+	data = (const char *)p;
+	size = st.st_size;
+}
+
+MappedFile::~MappedFile() {
+	if (data) munmap((void *)data, size);
+	if (fd >= 0) ::close(fd);
+}
+#endif
+
+//  one face corner - 0 based indices into the whole file's positions,
+//  texcoords and normals, -1 if not given
+//
+struct ObjCorner {
+	int v, vt, vn;
+	bool operator==(const ObjCorner &c) const { return v == c.v && vt == c.vt && vn == c.vn; }
+};
+
+struct ObjCornerHash {
+	size_t operator()(const ObjCorner &c) const {
+		return ((size_t)c.v * 73856093) ^ ((size_t)c.vt * 19349663) ^ ((size_t)c.vn * 83492791);
+	}
+};
+
+//  what one thread parsed from its part of the file.  Indices are only
+//  known relative to the block's own counts until all blocks are done, so
+//  negative (relative) indices are stored block local and listed in
+//  "relative" to be fixed up when the blocks are joined.
+//
+struct ObjBlock {
+	const char *begin, *end;
+	vector<glm::vec3> v, vn;
+	vector<glm::vec2> vt;
+	vector<ObjCorner> corners;
+	vector<int> faceSizes;
+	vector<int> relative;       // corner * 3 + (0 v, 1 vt, 2 vn)
+};
+
+static inline const char *skipSpace(const char *p, const char *end) {
+	while (p < end && (*p == ' ' || *p == '\t')) p++;
+	return p;
+}
+
+static inline const char *skipLine(const char *p, const char *end) {
+	while (p < end && *p != '\n') p++;
+	return p < end ? p + 1 : p;
+}
+
+static inline bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+//  strtof without the locale and the null terminator
+//
+static const char *parseFloat(const char *p, const char *end, float &out) {
+	p = skipSpace(p, end);
+	bool neg = false;
+	if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+
+	double v = 0;
+	while (p < end && isDigit(*p)) v = v * 10 + (*p++ - '0');
+	if (p < end && *p == '.') {
+		p++;
+		double scale = 1;
+		double frac = 0;
+		while (p < end && isDigit(*p)) {
+			frac = frac * 10 + (*p++ - '0');
+			scale *= 10;
+		}
+		v += frac / scale;
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		bool negExp = false;
+		if (p < end && (*p == '-' || *p == '+')) negExp = *p++ == '-';
+		int e = 0;
+		while (p < end && isDigit(*p)) e = e * 10 + (*p++ - '0');
+		v *= pow(10.0, negExp ? -e : e);
+	}
+	out = neg ? -v : v;
+	return p;
+}
+
+static const char *parseInt(const char *p, const char *end, int &out) {
+	bool neg = false;
+	if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+	int v = 0;
+	while (p < end && isDigit(*p)) v = v * 10 + (*p++ - '0');
+	out = neg ? -v : v;
+	return p;
+}
+
+//  OBJ index to block local 0 based index, -1 for none
+//
+static inline int objIndex(int i, int localCount, ObjBlock &b, int component) {
+	if (i > 0) return i - 1;
+	if (i == 0) return -1;
+	b.relative.push_back((int)b.corners.size() * 3 + component);
+	return localCount + i;
+}
+
+static void parseBlock(ObjBlock &b) {
+	const char *p = b.begin;
+	const char *end = b.end;
+	while (p < end) {
+		p = skipSpace(p, end);
+		if (p + 1 >= end) break;
+
+		if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+			glm::vec3 v;
+			p = parseFloat(p + 1, end, v.x);
+			p = parseFloat(p, end, v.y);
+			p = parseFloat(p, end, v.z);
+			b.v.push_back(v);
+		}
+		else if (p[0] == 'v' && p[1] == 'n') {
+			glm::vec3 n;
+			p = parseFloat(p + 2, end, n.x);
+			p = parseFloat(p, end, n.y);
+			p = parseFloat(p, end, n.z);
+			b.vn.push_back(n);
+		}
+		else if (p[0] == 'v' && p[1] == 't') {
+			glm::vec2 t;
+			p = parseFloat(p + 2, end, t.x);
+			p = parseFloat(p, end, t.y);
+			b.vt.push_back(t);
+		}
+		else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+
+			// each corner is v, v/vt, v//vn or v/vt/vn
+			//
+			p++;
+			int n = 0;
+			while (true) {
+				p = skipSpace(p, end);
+				if (p >= end || !(isDigit(*p) || *p == '-')) break;
+				int v = 0, vt = 0, vn = 0;
+				p = parseInt(p, end, v);
+				if (p < end && *p == '/') {
+					p++;
+					if (p < end && *p != '/') p = parseInt(p, end, vt);
+					if (p < end && *p == '/') p = parseInt(p + 1, end, vn);
+				}
+				ObjCorner c;
+				c.v = objIndex(v, b.v.size(), b, 0);
+				c.vt = objIndex(vt, b.vt.size(), b, 1);
+				c.vn = objIndex(vn, b.vn.size(), b, 2);
+				b.corners.push_back(c);
+				n++;
+			}
+			b.faceSizes.push_back(n);
+		}
+		p = skipLine(p, end);
+	}
+}
+
+//  parse an .obj into "mesh".  threads <= 0 uses all cores.
+//
+bool ObjLoader::load(const string &path, ofMesh &mesh, int threads) {
+	MappedFile file(path);
+	if (!file.data) return false;
+
+	if (threads <= 0) threads = max(1u, std::thread::hardware_concurrency());
+	const size_t minBlock = 1 << 20;
+	threads = max(1, min(threads, (int)(file.size / minBlock) + 1));
+
+	// split at line starts
+	//
+	vector<ObjBlock> blocks(threads);
+	const char *end = file.data + file.size;
+	const char *p = file.data;
+	for (int i = 0; i < threads; i++) {
+		blocks[i].begin = p;
+		p = (i == threads - 1) ? end : file.data + file.size * (i + 1) / threads;
+		if (p < blocks[i].begin) p = blocks[i].begin;
+		while (p < end && p[-1] != '\n') p++;
+		blocks[i].end = p;
+	}
+
+	vector<std::thread> workers;
+	for (int i = 1; i < threads; i++)
+		workers.push_back(std::thread(parseBlock, std::ref(blocks[i])));
+	parseBlock(blocks[0]);
+	for (int i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	// join - make block local indices global
+	//
+	vector<glm::vec3> positions, normals;
+	vector<glm::vec2> texCoords;
+	bool indexed = false;      // any corner with a texcoord or normal
+	for (int i = 0; i < threads; i++) {
+		ObjBlock &b = blocks[i];
+		int base[3] = { (int)positions.size(), (int)texCoords.size(), (int)normals.size() };
+		for (int k = 0; k < b.relative.size(); k++) {
+			ObjCorner &c = b.corners[b.relative[k] / 3];
+			int component = b.relative[k] % 3;
+			(&c.v)[component] += base[component];
+		}
+		for (int k = 0; k < b.corners.size(); k++) {
+			ObjCorner &c = b.corners[k];
+			if (c.vt >= 0 || c.vn >= 0) indexed = true;
+		}
+		positions.insert(positions.end(), b.v.begin(), b.v.end());
+		normals.insert(normals.end(), b.vn.begin(), b.vn.end());
+		texCoords.insert(texCoords.end(), b.vt.begin(), b.vt.end());
+	}
+
+	mesh.clear();
+	mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+
+	// one mesh vertex per distinct corner.  With positions only that is
+	// simply the position list.
+	//
+	vector<int> cornerVertex;
+	std::unordered_map<ObjCorner, int, ObjCornerHash> vertexOf;
+	if (!indexed)
+		mesh.getVertices().swap(positions);
+
+	for (int i = 0; i < threads; i++) {
+		ObjBlock &b = blocks[i];
+		int first = 0;
+		for (int f = 0; f < b.faceSizes.size(); f++) {
+			int n = b.faceSizes[f];
+			cornerVertex.resize(n);
+			bool valid = true;
+			for (int k = 0; k < n; k++) {
+				const ObjCorner &c = b.corners[first + k];
+				int numPositions = indexed ? positions.size() : mesh.getNumVertices();
+				if (c.v < 0 || c.v >= numPositions) valid = false;
+				if (!valid) break;
+				if (!indexed) {
+					cornerVertex[k] = c.v;
+					continue;
+				}
+				auto it = vertexOf.find(c);
+				if (it != vertexOf.end()) {
+					cornerVertex[k] = it->second;
+					continue;
+				}
+				cornerVertex[k] = mesh.getNumVertices();
+				vertexOf[c] = cornerVertex[k];
+				mesh.addVertex(positions[c.v]);
+				if (normals.size() > 0)
+					mesh.addNormal(c.vn >= 0 && c.vn < normals.size() ? normals[c.vn] : glm::vec3(0, 1, 0));
+				if (texCoords.size() > 0)
+					mesh.addTexCoord(c.vt >= 0 && c.vt < texCoords.size() ? texCoords[c.vt] : glm::vec2(0, 0));
+			}
+			first += n;
+			if (!valid) continue;
+			for (int k = 2; k < n; k++)
+				mesh.addTriangle(cornerVertex[0], cornerVertex[k - 1], cornerVertex[k]);
+		}
+	}
+	return mesh.getNumVertices() > 0;
+}
+
+string ObjLoader::cachePath(const string &path) {
+	return path + ".meshcache";
+}
+
+//  load from the cache if it is newer than the .obj, otherwise parse the
+//  .obj and (re)write the cache
+//
+bool ObjLoader::loadCached(const string &path, ofMesh &mesh, int threads) {
+	string cache = cachePath(path);
+	std::error_code err;
+	auto objTime = std::filesystem::last_write_time(path, err);
+	if (err) return false;
+	auto cacheTime = std::filesystem::last_write_time(cache, err);
+	if (!err && cacheTime >= objTime && readCache(cache, mesh))
+		return true;
+
+	if (!load(path, mesh, threads)) return false;
+	if (!writeCache(cache, mesh))
+		cout << "ObjLoader: can't write mesh cache: " << cache << endl;
+	return true;
+}
+
+//  cache layout: "MCSH" uint32 version, flags, numVertices, numIndices, then
+//  positions, normals (if flags & 1), texcoords (if flags & 2), indices
+//
+static_assert(sizeof(ofIndexType) == 4, "mesh cache stores 32 bit indices");
+
+bool ObjLoader::readCache(const string &cachePath, ofMesh &mesh) {
+	ifstream in(cachePath, ios::binary);
+	if (!in) return false;
+	char magic[4];
+	uint32_t header[4];
+	in.read(magic, 4);
+	in.read((char *)header, sizeof(header));
+	if (!in || strncmp(magic, "MCSH", 4) != 0 || header[0] != 1) return false;
+	uint32_t flags = header[1], numVertices = header[2], numIndices = header[3];
+
+	mesh.clear();
+	mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+	mesh.getVertices().resize(numVertices);
+	in.read((char *)mesh.getVertices().data(), numVertices * sizeof(glm::vec3));
+	if (flags & 1) {
+		mesh.getNormals().resize(numVertices);
+		in.read((char *)mesh.getNormals().data(), numVertices * sizeof(glm::vec3));
+	}
+	if (flags & 2) {
+		mesh.getTexCoords().resize(numVertices);
+		in.read((char *)mesh.getTexCoords().data(), numVertices * sizeof(glm::vec2));
+	}
+	mesh.getIndices().resize(numIndices);
+	in.read((char *)mesh.getIndices().data(), numIndices * sizeof(ofIndexType));
+	if (!in) {
+		mesh.clear();
+		return false;
+	}
+	return true;
+}
+
+bool ObjLoader::writeCache(const string &cachePath, const ofMesh &mesh) {
+	ofstream out(cachePath, ios::binary);
+	if (!out) return false;
+	uint32_t flags = (mesh.hasNormals() ? 1 : 0) | (mesh.hasTexCoords() ? 2 : 0);
+	uint32_t header[4] = { 1, flags, (uint32_t)mesh.getNumVertices(), (uint32_t)mesh.getNumIndices() };
+	out.write("MCSH", 4);
+	out.write((const char *)header, sizeof(header));
+	out.write((const char *)mesh.getVertices().data(), mesh.getNumVertices() * sizeof(glm::vec3));
+	if (flags & 1)
+		out.write((const char *)mesh.getNormals().data(), mesh.getNumVertices() * sizeof(glm::vec3));
+	if (flags & 2)
+		out.write((const char *)mesh.getTexCoords().data(), mesh.getNumVertices() * sizeof(glm::vec2));
+	out.write((const char *)mesh.getIndices().data(), mesh.getNumIndices() * sizeof(ofIndexType));
+	return (bool)out;
+}
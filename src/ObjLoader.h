@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ofMain.h"
+
+//  Wavefront OBJ loader for the terrain and other plain meshes, without
+//  going through assimp (so it works headless, with no GL context).
+//
+//  The file is memory mapped and split at line boundaries into one block
+//  per thread; the blocks are parsed in parallel and then joined.  Face
+//  corners with the same position/texcoord/normal are merged into one
+//  indexed vertex, and polygons are split into triangle fans.  Only
+//  positions, normals and texture coordinates are read - materials,
+//  groups etc. are ignored.
+//
+//  loadCached() keeps a binary copy of the result next to the .obj
+//  (<file>.meshcache) and loads that instead while it is newer than the
+//  .obj, straight into the mesh's arrays.
+//
+class ObjLoader {
+public:
+	static bool load(const string &path, ofMesh &mesh, int threads = 0);
+	static bool loadCached(const string &path, ofMesh &mesh, int threads = 0);
+	static bool readCache(const string &cachePath, ofMesh &mesh);
+	static bool writeCache(const string &cachePath, const ofMesh &mesh);
+	static string cachePath(const string &path);
+};
@@ -15,12 +15,12 @@
 
 //draw a box from a "Box" class  
 //
-void Octree::drawBox(const Box &box) {
+void OctreeBase::drawBox(const Box &box) {
 	Vector3 min = box.parameters[0];
 	Vector3 max = box.parameters[1];
 	Vector3 size = max - min;
 	Vector3 center = size / 2 + min;
-	ofVec3f p = ofVec3f(center.x(), center.y(), center.z());
+	glm::vec3 p = center.to<glm::vec3>();
 	float w = size.x();
 	float h = size.y();
 	float d = size.z();
@@ -29,13 +29,17 @@ void Octree::drawBox(const Box &box) {
 
 // return a Mesh Bounding Box for the entire Mesh
 //
-Box Octree::meshBounds(const ofMesh & mesh) {
-	int n = mesh.getNumVertices();
-	ofVec3f v = mesh.getVertex(0);
-	ofVec3f max = v;
-	ofVec3f min = v;
+Box OctreeBase::meshBounds(const ofMesh & mesh) {
+	return pointBounds(mesh.getVertices().data(), mesh.getNumVertices());
+}
+
+// return the Bounding Box of n points
+//
+Box OctreeBase::pointBounds(const glm::vec3 *points, int n) {
+	glm::vec3 max = n > 0 ? points[0] : glm::vec3(0);
+	glm::vec3 min = max;
 	for (int i = 1; i < n; i++) {
-		ofVec3f v = mesh.getVertex(i);
+		const glm::vec3 &v = points[i];
 
 		if (v.x > max.x) max.x = v.x;
 		else if (v.x < min.x) min.x = v.x;
@@ -46,56 +50,13 @@ Box Octree::meshBounds(const ofMesh & mesh) {
 		if (v.z > max.z) max.z = v.z;
 		else if (v.z < min.z) min.z = v.z;
 	}
-	cout << "vertices: " << n << endl;
 //	cout << "min: " << min << "max: " << max << endl;
-	return Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+	return Box(min, max);
 }
 
-// getMeshPointsInBox:  return an array of indices to points in mesh that are contained 
-//                      inside the Box.  Return count of points found;
+//  Subdivide a Box into eight(8) equal size boxes, return them in b;
 //
-int Octree::getMeshPointsInBox(const ofMesh & mesh, const vector<int>& points,
-	Box & box, vector<int> & pointsRtn)
-{
-	int count = 0;
-	for (int i = 0; i < points.size(); i++) {
-		ofVec3f v = mesh.getVertex(points[i]);
-		if (box.inside(Vector3(v.x, v.y, v.z))) {
-			count++;
-			pointsRtn.push_back(points[i]);
-		}
-	}
-	return count;
-}
-
-// getMeshFacesInBox:  return an array of indices to Faces in mesh that are contained 
-//                      inside the Box.  Return count of faces found;
-//
-int Octree::getMeshFacesInBox(const ofMesh & mesh, const vector<int>& faces,
-	Box & box, vector<int> & facesRtn)
-{
-	int count = 0;
-	for (int i = 0; i < faces.size(); i++) {
-		ofMeshFace face = mesh.getFace(faces[i]);
-		ofVec3f v[3];
-		v[0] = face.getVertex(0);
-		v[1] = face.getVertex(1);
-		v[2] = face.getVertex(2);
-		Vector3 p[3];
-		p[0] = Vector3(v[0].x, v[0].y, v[0].z);
-		p[1] = Vector3(v[1].x, v[1].y, v[1].z);
-		p[2] = Vector3(v[2].x, v[2].y, v[2].z);
-		if (box.inside(p,3)) {
-			count++;
-			facesRtn.push_back(faces[i]);
-		}
-	}
-	return count;
-}
-
-//  Subdivide a Box into eight(8) equal size boxes, return them in boxList;
-//
-void Octree::subDivideBox8(const Box &box, vector<Box> & boxList) {
+void OctreeBase::subDivideBox8(const Box &box, Box b[8]) {
 	Vector3 min = box.parameters[0];
 	Vector3 max = box.parameters[1];
 	Vector3 size = max - min;
@@ -107,126 +68,266 @@ void Octree::subDivideBox8(const Box &box, vector<Box> & boxList) {
 
 	//  generate ground floor
 	//
-	Box b[8];
 	b[0] = Box(min, center);
 	b[1] = Box(b[0].min() + Vector3(xdist, 0, 0), b[0].max() + Vector3(xdist, 0, 0));
 	b[2] = Box(b[1].min() + Vector3(0, 0, zdist), b[1].max() + Vector3(0, 0, zdist));
 	b[3] = Box(b[2].min() + Vector3(-xdist, 0, 0), b[2].max() + Vector3(-xdist, 0, 0));
 
-	boxList.clear();
-	for (int i = 0; i < 4; i++)
-		boxList.push_back(b[i]);
-
 	// generate second story
 	//
-	for (int i = 4; i < 8; i++) {
+	for (int i = 4; i < 8; i++)
 		b[i] = Box(b[i - 4].min() + h, b[i - 4].max() + h);
-		boxList.push_back(b[i]);
-	}
 }
 
-void Octree::create(const ofMesh & geo, int numLevels) {
-	// initialize octree structure
-	//
-	mesh = geo;
-	int level = 0;
-	root.box = meshBounds(mesh);
-	if (!bUseFaces) {
-		for (int i = 0; i < mesh.getNumVertices(); i++) {
-			root.points.push_back(i);
-		}
-	}
-	else {
-		// need to load face vertices here
-		//
-	}
+PointItems::PointItems(std::shared_ptr<const vector<glm::vec3>> pts) :
+	points(pts), data(pts->data()), n(pts->size()) {
+}
 
-	// recursively buid octree
-	//
-	level++;
-    subdivide(mesh, root, numLevels, level);
+PointItems::PointItems(const ofMesh & mesh) :
+	PointItems(std::make_shared<const vector<glm::vec3>>(mesh.getVertices())) {
 }
 
+Box PointItems::bounds() const {
+	return OctreeBase::pointBounds(data, n);
+}
 
-//
-// subdivide:  recursive function to perform octree subdivision on a mesh
-//
-//  subdivide(node) algorithm:
-//     1) subdivide box in node into 8 equal side boxes - see helper function subDivideBox8().
-//     2) For each child box
-//            sort point data into each box  (see helper function getMeshFacesInBox())
-//        if a child box contains at list 1 point
-//            add child to tree
-//            if child is not a leaf node (contains more than 1 point)
-//               recursively call subdivide(child)
-//         
-//      
-             
-void Octree::subdivide(const ofMesh & mesh, TreeNode & node, int numLevels, int level) {
-	if (level >= numLevels) return;
+TriangleItems::TriangleItems(const ofMesh & mesh) :
+	vertices(mesh.getVertices().data()), indices(mesh.getIndices().data()),
+	numVertices(mesh.getNumVertices()), n(mesh.getNumIndices() / 3) {
+}
+
+Box TriangleItems::bounds() const {
+	return OctreeBase::pointBounds(vertices, numVertices);
+}
 
-	// subdvide algorithm implemented here
-	// 1)
-	vector<Box> boxes;
-	subDivideBox8(node.box, boxes);
-	// 2)
-	for (int i = 0; i < boxes.size(); i++) {
-		vector<int> points;
-		int count = getMeshPointsInBox(mesh, node.points, boxes[i], points);
-
-		if (count > 0) {
-			TreeNode child;
-			child.box = boxes[i];
-			child.points = points;
-			node.children.push_back(child);
-
-			if (count > 1)
-				subdivide(mesh, node.children.at(node.children.size() - 1), numLevels, level + 1);
-		}
+int TriangleItems::inBox(const int *ids, int count, const Box & box, int *out) const {
+	int found = 0;
+	for (int i = 0; i < count; i++) {
+		const ofIndexType *t = indices + ids[i] * 3;
+		const glm::vec3 &a = vertices[t[0]], &b = vertices[t[1]], &c = vertices[t[2]];
+		Box bounds(glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)));
+		if (bounds.overlap(box))
+			out[found++] = ids[i];
 	}
+	return found;
+}
+
+Box BoxItems::bounds() const {
+	if (n == 0) return Box(Vector3(0, 0, 0), Vector3(0, 0, 0));
+	Vector3 min = boxes[0].min(), max = boxes[0].max();
+	for (int i = 1; i < n; i++) {
+		Vector3 bmin = boxes[i].min(), bmax = boxes[i].max();
+		min = Vector3(std::min(min.x(), bmin.x()), std::min(min.y(), bmin.y()), std::min(min.z(), bmin.z()));
+		max = Vector3(std::max(max.x(), bmax.x()), std::max(max.y(), bmax.y()), std::max(max.z(), bmax.z()));
+	}
+	return Box(min, max);
+}
+
+int BoxItems::inBox(const int *ids, int count, const Box & box, int *out) const {
+	int found = 0;
+	for (int i = 0; i < count; i++) {
+		if (boxes[ids[i]].overlap(box))
+			out[found++] = ids[i];
+	}
+	return found;
 }
 
 // Implement functions below for Homework project
 //
 
-bool Octree::intersect(const Ray &ray, const TreeNode & node, TreeNode & nodeRtn) {
-	bool intersects = false;
+bool OctreeBase::intersect(const Ray &ray, const TreeNode & node, TreeNode & nodeRtn) const {
+	QueryCounts counts;
+	QueryCounts *c = bQueryStats ? &counts : NULL;
+	Clock::time_point start;
+	if (c) {
+		start = Clock::now();
+		c->boxTests++;
+	}
+	const TreeNode *leaf = NULL;
+	if (node.box.intersect(ray, 0, FLT_MAX))
+		leaf = intersectChildren(ray, node, c);
+	if (c) addQuery(true, counts, start);
+	if (leaf)
+		nodeRtn = *leaf;
+	return leaf != NULL;
+}
 
-	if (!node.box.intersect(ray, 0, FLT_MAX))
-		return intersects;
+//  the first leaf hit by the ray, NULL if none.  Unlike the version above
+//  nothing is copied, for queries made every frame.
+//
+const TreeNode * OctreeBase::intersect(const Ray &ray) const {
+	QueryCounts counts;
+	QueryCounts *c = bQueryStats ? &counts : NULL;
+	Clock::time_point start;
+	if (c) {
+		start = Clock::now();
+		c->boxTests++;
+	}
+	const TreeNode *leaf = NULL;
+	if (root.box.intersect(ray, 0, FLT_MAX))
+		leaf = intersectChildren(ray, root, c);
+	if (c) addQuery(true, counts, start);
+	return leaf;
+}
 
+//  node's box is hit - test the ray against all its children at once and
+//  descend into the ones it hits, in order.  Leaves without points (after
+//  reorder() a point shared by two leaves is only in the first) are passed
+//  over for the next leaf along the ray.
+//
+const TreeNode * OctreeBase::intersectChildren(const Ray &ray, const TreeNode & node, QueryCounts *counts) const {
 	if (node.children.size() == 0) {
-		nodeRtn = node;
-		intersects = true;
-	} else {
-		for (int i = 0; i < node.children.size(); i++) {
-			intersects = intersect(ray, node.children.at(i), nodeRtn);
-			if (intersects)
-				break;
-		}
+		if (nodeSize(node) == 0) return NULL;
+		if (counts) counts->leavesHit++;
+		return &node;
 	}
 
+	BoxBuffer<8> boxes;
+	for (int i = 0; i < node.children.size(); i++)
+		boxes.add(node.children[i].box);
+	uint8_t hit[8];
+	rayHitsBoxes(ray, boxes.array(), 0, FLT_MAX, hit);
+	if (counts) {
+		counts->nodesVisited++;
+		counts->boxTests += node.children.size();
+	}
+
+	for (int i = 0; i < node.children.size(); i++) {
+		if (!hit[i]) continue;
+		const TreeNode *leaf = intersectChildren(ray, node.children[i], counts);
+		if (leaf)
+			return leaf;
+	}
+	return NULL;
+}
+
+bool OctreeBase::intersect(const Box &box, const TreeNode & node, vector<Box> & boxListRtn) const {
+	if (!bQueryStats)
+		return intersectBox(box, node, boxListRtn, NULL);
+
+	QueryCounts counts;
+	Clock::time_point start = Clock::now();
+	bool intersects = intersectBox(box, node, boxListRtn, &counts);
+	addQuery(false, counts, start);
 	return intersects;
 }
 
-bool Octree::intersect(const Box &box, TreeNode & node, vector<Box> & boxListRtn) {
+bool OctreeBase::intersectBox(const Box &box, const TreeNode & node, vector<Box> & boxListRtn, QueryCounts *counts) const {
 	bool intersects = false;
 
+	if (counts) counts->boxTests++;
 	if (!node.box.overlap(box))
 		return intersects;
 
 	if (node.children.size() == 0) {
+		if (counts) counts->leavesHit++;
 		boxListRtn.push_back(node.box);
 		intersects = true;
 	} else {
+		if (counts) counts->nodesVisited++;
 		for (int i = 0; i < node.children.size(); i++)
-			intersects = intersect(box, node.children.at(i), boxListRtn);
+			intersects = intersectBox(box, node.children.at(i), boxListRtn, counts);
 	}
 
 	return intersects;
 }
 
-void Octree::draw(TreeNode & node, int numLevels, int level) {
+void OctreeBase::addQuery(bool ray, const QueryCounts &counts, Clock::time_point start) const {
+	uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+	(ray ? queryStats.rayQueries : queryStats.boxQueries)++;
+	queryStats.nodesVisited += counts.nodesVisited;
+	queryStats.boxTests += counts.boxTests;
+	queryStats.leavesHit += counts.leavesHit;
+	queryStats.ns += ns;
+}
+
+OctreeQueryStats & OctreeQueryStats::operator=(const OctreeQueryStats &s) {
+	rayQueries = s.rayQueries.load();
+	boxQueries = s.boxQueries.load();
+	nodesVisited = s.nodesVisited.load();
+	boxTests = s.boxTests.load();
+	leavesHit = s.leavesHit.load();
+	ns = s.ns.load();
+	return *this;
+}
+
+//  walk the new tree for buildStats, and the old debug counters
+//
+void OctreeBase::computeBuildStats(int leafCapacity) {
+	Clock::time_point t = Clock::now();
+	buildStats.items = root.points.size();
+	vector<uint8_t> inLeaf(buildStats.items, 0);
+	levelStats(root, 0, leafCapacity, inLeaf);
+
+	buildStats.strayItems = 0;
+	for (int i = 0; i < inLeaf.size(); i++)
+		if (!inLeaf[i]) buildStats.strayItems++;
+	strayVerts = buildStats.strayItems;
+	numLeaf = buildStats.leaves;
+	buildStats.statsMs = msSince(t);
+}
+
+void OctreeBase::levelStats(const TreeNode & node, int level, int leafCapacity, vector<uint8_t> & inLeaf) {
+	OctreeBuildStats &s = buildStats;
+	if (s.nodesPerLevel.size() <= level) s.nodesPerLevel.resize(level + 1, 0);
+	s.nodesPerLevel[level]++;
+	s.nodes++;
+	s.maxDepth = max(s.maxDepth, level);
+
+	if (node.children.size() == 0) {
+		int n = node.points.size();
+		if (s.leafItems.size() <= n) s.leafItems.resize(n + 1, 0);
+		s.leafItems[n]++;
+		s.leaves++;
+		if (n > leafCapacity) s.overfullLeaves++;
+		for (int i = 0; i < n; i++)
+			inLeaf[node.points[i]] = 1;
+		return;
+	}
+	for (int i = 0; i < node.children.size(); i++)
+		levelStats(node.children[i], level + 1, leafCapacity, inLeaf);
+}
+
+//  print buildStats and queryStats, e.g.
+//
+//      octree: 63437 nodes, 40000 leaves, depth 8, 40000 items (0 stray)
+//        build: bounds 0.24 ms, subdivide 30.44 ms, stats 3.90 ms, reorder 11.73 ms
+//        nodes per level: 1 8 56 342 1636 6670 20408 25810 8506
+//        ...
+//
+void OctreeBase::dumpStats(ostream &out) const {
+	const OctreeBuildStats &s = buildStats;
+	out << "octree: " << s.nodes << " nodes, " << s.leaves << " leaves, depth " << s.maxDepth << ", "
+		<< s.items << " items (" << s.strayItems << " stray)" << endl;
+	out << "  build: bounds " << ofToString(s.boundsMs, 2) << " ms, subdivide " << ofToString(s.subdivideMs, 2)
+		<< " ms, stats " << ofToString(s.statsMs, 2) << " ms, reorder " << ofToString(s.reorderMs, 2) << " ms" << endl;
+	out << "  nodes per level:";
+	for (int i = 0; i < s.nodesPerLevel.size(); i++)
+		out << " " << s.nodesPerLevel[i];
+	out << endl;
+
+	// leaf occupancy, one line per item count that occurs
+	//
+	int total = 0;
+	for (int k = 0; k < s.leafItems.size(); k++)
+		total += k * s.leafItems[k];
+	out << "  leaf occupancy (items: leaves), " << ofToString(s.leaves ? (float)total / s.leaves : 0.0f, 2)
+		<< " items per leaf, " << s.overfullLeaves << " over capacity:" << endl;
+	for (int k = 0; k < s.leafItems.size(); k++)
+		if (s.leafItems[k] > 0)
+			out << "    " << k << ": " << s.leafItems[k] << endl;
+
+	const OctreeQueryStats &q = queryStats;
+	uint64_t n = q.queries();
+	if (n == 0) return;
+	out << "  queries: " << q.rayQueries << " ray, " << q.boxQueries << " box, " << ofToString(q.ms(), 2) << " ms, per query: "
+		<< ofToString((double)q.nodesVisited / n, 1) << " nodes visited, "
+		<< ofToString((double)q.boxTests / n, 1) << " box tests, "
+		<< ofToString((double)q.leavesHit / n, 2) << " leaves hit, "
+		<< ofToString(q.ns / (double)n, 0) << " ns" << endl;
+}
+
+void OctreeBase::draw(TreeNode & node, int numLevels, int level) {
 	if (level >= numLevels) return;
 
 	if (level > levelColors.size() - 1)
@@ -243,7 +344,7 @@ void Octree::draw(TreeNode & node, int numLevels, int level) {
 
 // Optional
 //
-void Octree::drawLeafNodes(TreeNode & node) {
+void OctreeBase::drawLeafNodes(TreeNode & node) {
 
 
 }
@@ -4,7 +4,7 @@
 //  Kevin M. Smith
 //
 //  Simple Octree Implementation 11/10/2020
-// 
+//
 //  Copyright (c) by Kevin M. Smith
 //  Copying or use without permission is prohibited by law.
 //
@@ -12,23 +12,124 @@
 #include "ofMain.h"
 #include "box.h"
 #include "ray.h"
+#include "GeomBatch.h"
+#include <memory>
+#include <type_traits>
+#include <atomic>
+#include <chrono>
 
 
 
 class TreeNode {
 public:
 	Box box;
-	vector<int> points;
+	vector<int> points;         // item ids
 	vector<TreeNode> children;
+	int begin = 0, end = 0;     // points as a range, after OctreeT::reorder()
+};
+
+//  Octree payloads.  Nodes hold integer item ids; the payload says what an
+//  id stands for, the bounds of all items, and which of a list of items
+//  belong in a box (inBox() writes their ids to out and returns the count).
+//
+
+//  points, e.g. terrain vertices or particle positions: a compact position
+//  array shared with the creator (no copy of the mesh is kept)
+//
+struct PointItems {
+	PointItems() {}
+	PointItems(std::shared_ptr<const vector<glm::vec3>> points);
+	PointItems(const ofMesh &mesh);         // copies the positions only
+
+	int size() const { return n; }
+	Box bounds() const;
+	int inBox(const int *ids, int count, const Box &box, int *out) const {
+		return pointsInBox(data, ids, count, box, out);
+	}
+
+	std::shared_ptr<const vector<glm::vec3>> points;
+	const glm::vec3 *data = NULL;           // points->data(), for the inner loops
+	int n = 0;
+};
+
+//  triangles of an indexed mesh, which must outlive the octree.  A
+//  triangle goes in every box its bounds overlap.
+//
+struct TriangleItems {
+	TriangleItems() {}
+	TriangleItems(const ofMesh &mesh);
+
+	int size() const { return n; }
+	Box bounds() const;
+	int inBox(const int *ids, int count, const Box &box, int *out) const;
+
+	const glm::vec3 *vertices = NULL;
+	const ofIndexType *indices = NULL;
+	int numVertices = 0;
+	int n = 0;
+};
+
+//  objects with bounding boxes (actors), which must outlive the octree.
+//  An object goes in every box its bounds overlap.
+//
+struct BoxItems {
+	BoxItems() {}
+	BoxItems(const vector<Box> &boxes) : boxes(boxes.data()), n(boxes.size()) {}
+
+	int size() const { return n; }
+	Box bounds() const;
+	int inBox(const int *ids, int count, const Box &box, int *out) const;
+
+	const Box *boxes = NULL;
+	int n = 0;
 };
 
-class Octree {
+//  Statistics of the last create() (and reorder()), filled in by the
+//  octree itself: the shape of the tree and where its build time went.
+//  Levels count from the root at 0.
+//
+struct OctreeBuildStats {
+	vector<int> nodesPerLevel;
+	vector<int> leafItems;      // leafItems[k]: number of leaves holding k items
+	int nodes = 0;
+	int leaves = 0;
+	int maxDepth = 0;
+	int items = 0;
+	int strayItems = 0;         // items in no leaf
+	int overfullLeaves = 0;     // leaves with more than LeafCapacity items (at the depth limit)
+	double boundsMs = 0;        // build time per phase
+	double subdivideMs = 0;
+	double statsMs = 0;
+	double reorderMs = 0;
+};
+
+//  Query counters, summed over every query since the last reset() while
+//  OctreeBase::bQueryStats is set.  Queries may run on several threads at
+//  once; each query counts locally and adds its totals once at the end.
+//
+struct OctreeQueryStats {
+	std::atomic<uint64_t> rayQueries{ 0 }, boxQueries{ 0 };
+	std::atomic<uint64_t> nodesVisited{ 0 };    // nodes whose children were examined
+	std::atomic<uint64_t> boxTests{ 0 };        // ray/box or box/box tests
+	std::atomic<uint64_t> leavesHit{ 0 };
+	std::atomic<uint64_t> ns{ 0 };              // time spent in queries
+
+	OctreeQueryStats() {}
+	OctreeQueryStats(const OctreeQueryStats &s) { *this = s; }
+	OctreeQueryStats & operator=(const OctreeQueryStats &s);
+	void reset() { *this = OctreeQueryStats(); }
+	uint64_t queries() const { return rayQueries + boxQueries; }
+	double ms() const { return ns / 1.0e6; }
+};
+
+//  The parts of the octree that don't depend on the payload: the node
+//  tree, the ray and box queries and drawing.
+//
+class OctreeBase {
 public:
-	
-	void create(const ofMesh & mesh, int numLevels);
-	void subdivide(const ofMesh & mesh, TreeNode & node, int numLevels, int level);
-	bool intersect(const Ray &, const TreeNode & node, TreeNode & nodeRtn);
-	bool intersect(const Box &, TreeNode & node, vector<Box> & boxListRtn);
+	bool intersect(const Ray &, const TreeNode & node, TreeNode & nodeRtn) const;
+	const TreeNode * intersect(const Ray &) const;
+	bool intersect(const Box &, const TreeNode & node, vector<Box> & boxListRtn) const;
 	void draw(TreeNode & node, int numLevels, int level);
 	void draw(int numLevels, int level) {
 		draw(root, numLevels, level);
@@ -36,20 +137,254 @@ public:
 	void drawLeafNodes(TreeNode & node);
 	static void drawBox(const Box &box);
 	static Box meshBounds(const ofMesh &);
-	int getMeshPointsInBox(const ofMesh &mesh, const vector<int> & points, Box & box, vector<int> & pointsRtn);
-	int getMeshFacesInBox(const ofMesh &mesh, const vector<int> & faces, Box & box, vector<int> & facesRtn);
-	void subDivideBox8(const Box &b, vector<Box> & boxList);
+	static Box pointBounds(const glm::vec3 *points, int n);
+	static void subDivideBox8(const Box &b, Box boxes[8]);
+	void dumpStats(ostream &out = cout) const;
+
+	int nodeSize(const TreeNode & node) const { return bRanges ? node.end - node.begin : node.points.size(); }
+	int nodePoint(const TreeNode & node, int k) const { return bRanges ? node.begin + k : node.points[k]; }
 
-	ofMesh mesh;
 	TreeNode root;
-	bool bUseFaces = false;
+	bool bRanges = false;       // reorder() has been run
 
-	// debug;
+	// debug;  filled in by create(), see buildStats for the rest
 	//
 	int strayVerts= 0;
 	int numLeaf = 0;
 
+	OctreeBuildStats buildStats;
+	mutable OctreeQueryStats queryStats;
+	bool bQueryStats = false;   // count queries into queryStats (off: one branch per query)
+
 	// Level colors
 	vector<ofColor> levelColors = { ofColor::darkRed, ofColor::red, ofColor::orange, ofColor::yellow, ofColor::green
 		, ofColor::aqua, ofColor::blue, ofColor::midnightBlue, ofColor::purple, ofColor::pink };
-};
\ No newline at end of file
+
+protected:
+	typedef std::chrono::steady_clock Clock;
+	static double msSince(Clock::time_point t) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+	}
+	void computeBuildStats(int leafCapacity);
+
+private:
+	struct QueryCounts {
+		uint64_t nodesVisited = 0, boxTests = 0, leavesHit = 0;
+	};
+	const TreeNode * intersectChildren(const Ray &, const TreeNode & node, QueryCounts *counts) const;
+	bool intersectBox(const Box &, const TreeNode & node, vector<Box> & boxListRtn, QueryCounts *counts) const;
+	void addQuery(bool ray, const QueryCounts &counts, Clock::time_point start) const;
+	void levelStats(const TreeNode & node, int level, int leafCapacity, vector<uint8_t> & inLeaf);
+};
+
+//  The octree, specialized at compile time for its payload and leaf
+//  capacity: a node is split while it holds more than LeafCapacity items,
+//  down to numLevels.  The same engine serves
+//
+//      Octree                  terrain vertices, one per leaf
+//      ParticleOctree          particle positions
+//      TriangleOctree          mesh triangles
+//      ObjectOctree            actor bounding boxes
+//
+//  create() takes the payload, or anything it is made from (a mesh, a
+//  shared position array, ...).  TreeNode::points are item ids - or, for
+//  points after reorder(), each node's points are the contiguous range
+//  [begin, end).  Use nodeSize() / nodePoint() to read either.
+//
+template <class Payload, int LeafCapacity = 1>
+class OctreeT : public OctreeBase {
+public:
+	static_assert(LeafCapacity >= 1, "a leaf holds at least one item");
+	static const bool pointPayload = std::is_same<Payload, PointItems>::value;
+
+	void create(const Payload & items, int numLevels);
+	template <class Source>
+	void create(const Source & source, int numLevels) {
+		create(Payload(source), numLevels);
+	}
+	void subdivide(TreeNode & node, int numLevels, int level);
+	int getItemsInBox(const vector<int> & ids, const Box & box, vector<int> & idsRtn) const;
+	void reorder(vector<int> & remap);
+
+	const glm::vec3 & point(int i) const {
+		static_assert(pointPayload, "point() needs a point payload");
+		return items.data[i];
+	}
+	int numPoints() const { return items.size(); }
+
+	Payload items;
+
+private:
+	void reorderNode(TreeNode & node, vector<int> & remap, vector<int> & order);
+};
+
+typedef OctreeT<PointItems> Octree;
+typedef OctreeT<PointItems, 16> ParticleOctree;
+typedef OctreeT<TriangleItems, 8> TriangleOctree;
+typedef OctreeT<BoxItems, 4> ObjectOctree;
+
+
+template <class Payload, int LeafCapacity>
+void OctreeT<Payload, LeafCapacity>::create(const Payload & payload, int numLevels) {
+	// initialize octree structure
+	//
+	Clock::time_point t = Clock::now();
+	items = payload;
+	root = TreeNode();
+	bRanges = false;
+	buildStats = OctreeBuildStats();
+	int level = 0;
+	root.box = items.bounds();
+	root.points.resize(items.size());
+	for (int i = 0; i < items.size(); i++) {
+		root.points[i] = i;
+	}
+	buildStats.boundsMs = msSince(t);
+
+	// recursively buid octree
+	//
+	t = Clock::now();
+	level++;
+	subdivide(root, numLevels, level);
+	buildStats.subdivideMs = msSince(t);
+
+	computeBuildStats(LeafCapacity);
+}
+
+// getItemsInBox:  return an array of ids of the items that belong in the
+//                 Box.  Return count of items found;
+//
+template <class Payload, int LeafCapacity>
+int OctreeT<Payload, LeafCapacity>::getItemsInBox(const vector<int> & ids, const Box & box, vector<int> & idsRtn) const {
+	int size = idsRtn.size();
+	idsRtn.resize(size + ids.size());
+	int count = items.inBox(ids.data(), ids.size(), box, idsRtn.data() + size);
+	idsRtn.resize(size + count);
+	return count;
+}
+
+//
+// subdivide:  recursive function to perform octree subdivision
+//
+//  subdivide(node) algorithm:
+//     1) subdivide box in node into 8 equal side boxes - see helper function subDivideBox8().
+//     2) For each child box
+//            sort item ids into each box  (see helper function getItemsInBox())
+//        if a child box contains at least 1 item
+//            add child to tree
+//            if child is not a leaf node (contains more than LeafCapacity items)
+//               recursively call subdivide(child)
+//
+template <class Payload, int LeafCapacity>
+void OctreeT<Payload, LeafCapacity>::subdivide(TreeNode & node, int numLevels, int level) {
+	if (level >= numLevels) return;
+
+	// 1)
+	Box boxes[8];
+	subDivideBox8(node.box, boxes);
+	// 2)
+	for (int i = 0; i < 8; i++) {
+		vector<int> ids;
+		int count = getItemsInBox(node.points, boxes[i], ids);
+
+		if (count > 0) {
+			node.children.push_back(TreeNode());
+			TreeNode &child = node.children.back();
+			child.box = boxes[i];
+			child.points.swap(ids);
+
+			if (count > LeafCapacity)
+				subdivide(child, numLevels, level + 1);
+		}
+	}
+}
+
+//  reorder:  optional pass after create(), for point payloads.  Permutes
+//  the points so that the points of every node are contiguous, with the
+//  leaves in Morton order, and replaces each node's point list with a
+//  [begin, end) range.  Leaf scans then read memory linearly.  remap
+//  returns the new index of each old point, to renumber mesh indices and
+//  attributes with.  A point on the boundary of two leaves is kept by the
+//  first one only.  If the octree is the only owner of the points they
+//  are permuted in place, otherwise it gets a permuted copy.
+//
+template <class Payload, int LeafCapacity>
+void OctreeT<Payload, LeafCapacity>::reorder(vector<int> & remap) {
+	static_assert(pointPayload, "reorder() needs a point payload");
+	Clock::time_point t = Clock::now();
+	remap.assign(numPoints(), -1);
+	vector<int> order;
+	order.reserve(numPoints());
+	reorderNode(root, remap, order);
+
+	// points that ended up in no leaf go last
+	//
+	for (int i = 0; i < remap.size(); i++) {
+		if (remap[i] < 0) {
+			remap[i] = order.size();
+			order.push_back(i);
+		}
+	}
+
+	if (items.points.use_count() == 1) {
+		// follow each cycle of the permutation, marking the points moved
+		// by flipping their remap entries
+		//
+		vector<int>().swap(order);
+		vector<glm::vec3> &points = const_cast<vector<glm::vec3> &>(*items.points);
+		for (int i = 0; i < remap.size(); i++) {
+			if (remap[i] < 0) continue;
+			glm::vec3 carry = points[i];
+			for (int j = i; ; ) {
+				int to = remap[j];
+				remap[j] = ~to;
+				if (to == i) {
+					points[i] = carry;
+					break;
+				}
+				std::swap(carry, points[to]);
+				j = to;
+			}
+		}
+		for (int i = 0; i < remap.size(); i++)
+			remap[i] = ~remap[i];
+	}
+	else {
+		auto sorted = std::make_shared<vector<glm::vec3>>(order.size());
+		for (int k = 0; k < order.size(); k++)
+			(*sorted)[k] = items.data[order[k]];
+		items = PointItems(sorted);
+	}
+	bRanges = true;
+	buildStats.reorderMs = msSince(t);
+}
+
+template <class Payload, int LeafCapacity>
+void OctreeT<Payload, LeafCapacity>::reorderNode(TreeNode & node, vector<int> & remap, vector<int> & order) {
+	node.begin = order.size();
+	if (node.children.size() == 0) {
+		for (int i = 0; i < node.points.size(); i++) {
+			int p = node.points[i];
+			if (remap[p] < 0) {
+				remap[p] = order.size();
+				order.push_back(p);
+			}
+		}
+	}
+	else {
+		// visit the children by octant (x is the low bit, then y, then z)
+		//
+		Vector3 c = node.box.center();
+		vector<pair<int, int>> octants;
+		for (int i = 0; i < node.children.size(); i++) {
+			Vector3 m = node.children[i].box.min();
+			int octant = (m.x() >= c.x() ? 1 : 0) | (m.y() >= c.y() ? 2 : 0) | (m.z() >= c.z() ? 4 : 0);
+			octants.push_back(make_pair(octant, i));
+		}
+		sort(octants.begin(), octants.end());
+		for (int i = 0; i < octants.size(); i++)
+			reorderNode(node.children[octants[i].second], remap, order);
+	}
+	node.end = order.size();
+	vector<int>().swap(node.points);
+}
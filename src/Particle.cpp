@@ -1,4 +1,5 @@
 #include "Particle.h"
+#include "SimClock.h"
 
 
 Particle::Particle() {
@@ -11,26 +12,29 @@ Particle::Particle() {
 	forces.set(0, 0, 0);
 	lifespan = 5;
 	birthtime = 0;
+	deathtime = lifespan;
 	radius = .1;
 	damping = .99;
 	mass = 1;
 	color = ofColor::aquamarine;
 }
 
-void Particle::draw() {
+void Particle::draw(float now) {
 //	ofSetColor(color);
-	ofSetColor(ofMap(age(), 0, lifespan, 255, 10), 0, 0);
+	ofSetColor(ofMap(age(now), 0, lifespan, 255, 10), 0, 0);
 	ofDrawSphere(position, radius);
 }
 
 // write your own integrator here.. (hint: it's only 3 lines of code)
 //
-void Particle::integrate() {
+// dt is the interval for this step (sec), taken from the simulation clock.
+// damping is per 1/60 sec step, and scaled to dt.
+//
+void Particle::integrate(float dt) {
+	integrate(dt, SimClock::damping(damping, dt));
+}
 
-	
-	// interval for this step
-	//
-	float dt = 1.0 / ofGetFrameRate();
+void Particle::integrate(float dt, float dampingFactor) {
 
 	// update position based on velocity
 	//
@@ -45,17 +49,11 @@ void Particle::integrate() {
 
 	// add a little damping for good measure
 	//
-	velocity *= damping;
+	velocity *= dampingFactor;
 
 	// clear forces on particle (they get re-added each step)
 	//
 	forces.set(0, 0, 0);
 }
 
-//  return age in seconds
-//
-float Particle::age() {
-	return (ofGetElapsedTimeMillis() - birthtime)/1000.0;
-}
-
 
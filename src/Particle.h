@@ -12,14 +12,17 @@ public:
 	ofVec3f velocity;
 	ofVec3f acceleration;
 	ofVec3f forces;
-	float	damping;
+	float	damping;      // velocity kept per 1/60 sec (SimClock::damping())
 	float   mass;
 	float   lifespan;
 	float   radius;
-	float   birthtime;
-	void    integrate();
-	void    draw();
-	float   age();        // sec
+	float   birthtime;    // sec
+	float   deathtime;    // sec (birthtime + lifespan)
+	void    integrate(float dt);
+	void    integrate(float dt, float dampingFactor);  // damping already scaled to dt (SimClock::damping())
+	void    draw(float now);
+	float   age(float now) const { return now - birthtime; }   // sec
+	bool    expired(float now) const { return lifespan != -1 && now > deathtime; }
 	ofColor color;
 };
 
@@ -0,0 +1,294 @@
+#include "ParticleBackend.h"
+#include "SimClock.h"
+#include <cstddef>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PARTICLE_USE_AVX2
+#define AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define PARTICLE_USE_AVX2
+#define AVX2_TARGET
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+//  Scalar backend - the reference
+//
+class ScalarParticleBackend : public ParticleBackend {
+public:
+	const char *name() const { return "scalar"; }
+
+	// the damping factor is worked out again only when the damping changes
+	// (an emitter gives all its particles the same)
+	//
+	void integrate(Particle *particles, int n, float dt) const {
+		float damping = 1, factor = SimClock::damping(1, dt);
+		for (int i = 0; i < n; i++) {
+			if (particles[i].damping != damping) {
+				damping = particles[i].damping;
+				factor = SimClock::damping(damping, dt);
+			}
+			particles[i].integrate(dt, factor);
+		}
+	}
+	void addForce(Particle *particles, int n, const ofVec3f &perMass) const {
+		for (int i = 0; i < n; i++)
+			particles[i].forces += perMass * particles[i].mass;
+	}
+	void addForces(Particle *particles, int n, const ofVec3f *f) const {
+		for (int i = 0; i < n; i++)
+			particles[i].forces += f[i];
+	}
+	void normalize(ofVec3f *v, int n, float scale) const {
+		for (int i = 0; i < n; i++)
+			v[i] = v[i].getNormalized() * scale;
+	}
+};
+
+const ParticleBackend & ParticleBackend::scalar() {
+	static ScalarParticleBackend backend;
+	return backend;
+}
+
+#ifdef PARTICLE_USE_AVX2
+
+//  AVX2 backend.  A block of 8 particles is read as two 8x8 tiles of
+//  floats - fields 0-7 and 8-15 of each particle - and transposed so each
+//  register holds one field of all 8.  The functions are compiled for AVX2
+//  on their own and only called once the CPU has been checked for it.
+//
+
+static_assert(offsetof(Particle, position) == 0 && offsetof(Particle, velocity) == 3 * sizeof(float)
+	&& offsetof(Particle, acceleration) == 6 * sizeof(float) && offsetof(Particle, forces) == 9 * sizeof(float)
+	&& offsetof(Particle, damping) == 12 * sizeof(float) && offsetof(Particle, mass) == 13 * sizeof(float)
+	&& sizeof(Particle) >= 16 * sizeof(float), "the AVX2 particle backend expects Particle's fields in this order");
+
+enum { PosX, PosY, PosZ, VelX, VelY, VelZ, AccX, AccY };        // fields 0-7
+enum { AccZ, ForceX, ForceY, ForceZ, Damping, Mass };           // fields 8-15
+
+static bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)))      // OSXSAVE, AVX
+		return false;
+	if ((_xgetbv(0) & 6) != 6)                                 // the OS saves the AVX registers
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+AVX2_TARGET static inline void transpose8(__m256 r[8]) {
+	__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+	__m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+	__m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	__m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+	__m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+	__m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+	__m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+//  fields [first, first + 8) of particles p[0..8), one field per register.
+//  Written out so the compiler keeps the tile in registers.
+//
+AVX2_TARGET static inline void loadFields(const Particle *p, int first, __m256 r[8]) {
+	r[0] = _mm256_loadu_ps((const float *)&p[0] + first);
+	r[1] = _mm256_loadu_ps((const float *)&p[1] + first);
+	r[2] = _mm256_loadu_ps((const float *)&p[2] + first);
+	r[3] = _mm256_loadu_ps((const float *)&p[3] + first);
+	r[4] = _mm256_loadu_ps((const float *)&p[4] + first);
+	r[5] = _mm256_loadu_ps((const float *)&p[5] + first);
+	r[6] = _mm256_loadu_ps((const float *)&p[6] + first);
+	r[7] = _mm256_loadu_ps((const float *)&p[7] + first);
+	transpose8(r);
+}
+
+AVX2_TARGET static inline void storeFields(Particle *p, int first, __m256 r[8]) {
+	transpose8(r);
+	_mm256_storeu_ps((float *)&p[0] + first, r[0]);
+	_mm256_storeu_ps((float *)&p[1] + first, r[1]);
+	_mm256_storeu_ps((float *)&p[2] + first, r[2]);
+	_mm256_storeu_ps((float *)&p[3] + first, r[3]);
+	_mm256_storeu_ps((float *)&p[4] + first, r[4]);
+	_mm256_storeu_ps((float *)&p[5] + first, r[5]);
+	_mm256_storeu_ps((float *)&p[6] + first, r[6]);
+	_mm256_storeu_ps((float *)&p[7] + first, r[7]);
+}
+
+//  the damping factors are those of the scalar backend; a block whose
+//  particles all have the last block's damping uses its factor, otherwise
+//  they are worked out lane by lane
+//
+AVX2_TARGET static void integrateAvx2(Particle *p, int n, float dt) {
+	const __m256 step = _mm256_set1_ps(dt);
+	const __m256 one = _mm256_set1_ps(1);
+	const __m256 zero = _mm256_setzero_ps();
+	float damping = 1, factor = SimClock::damping(1, dt);
+	__m256 lastDamping = _mm256_set1_ps(damping), lastFactor = _mm256_set1_ps(factor);
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 lo[8], hi[8];
+		loadFields(p + i, 0, lo);
+		loadFields(p + i, 8, hi);
+
+		__m256 dampingFactor = lastFactor;
+		if (_mm256_movemask_ps(_mm256_cmp_ps(hi[Damping], lastDamping, _CMP_EQ_OQ)) != 0xff) {
+			alignas(32) float lanes[8];
+			_mm256_store_ps(lanes, hi[Damping]);
+			for (int k = 0; k < 8; k++) {
+				if (lanes[k] != damping) {
+					damping = lanes[k];
+					factor = SimClock::damping(damping, dt);
+				}
+				lanes[k] = factor;
+			}
+			dampingFactor = _mm256_load_ps(lanes);
+			lastDamping = _mm256_set1_ps(damping);
+			lastFactor = _mm256_set1_ps(factor);
+		}
+
+		// position += velocity * dt
+		//
+		lo[PosX] = _mm256_add_ps(lo[PosX], _mm256_mul_ps(lo[VelX], step));
+		lo[PosY] = _mm256_add_ps(lo[PosY], _mm256_mul_ps(lo[VelY], step));
+		lo[PosZ] = _mm256_add_ps(lo[PosZ], _mm256_mul_ps(lo[VelZ], step));
+
+		// accel = acceleration + forces * (1 / mass), then
+		// velocity = (velocity + accel * dt) * damping factor
+		//
+		__m256 invMass = _mm256_div_ps(one, hi[Mass]);
+		__m256 ax = _mm256_add_ps(lo[AccX], _mm256_mul_ps(hi[ForceX], invMass));
+		__m256 ay = _mm256_add_ps(lo[AccY], _mm256_mul_ps(hi[ForceY], invMass));
+		__m256 az = _mm256_add_ps(hi[AccZ], _mm256_mul_ps(hi[ForceZ], invMass));
+		lo[VelX] = _mm256_mul_ps(_mm256_add_ps(lo[VelX], _mm256_mul_ps(ax, step)), dampingFactor);
+		lo[VelY] = _mm256_mul_ps(_mm256_add_ps(lo[VelY], _mm256_mul_ps(ay, step)), dampingFactor);
+		lo[VelZ] = _mm256_mul_ps(_mm256_add_ps(lo[VelZ], _mm256_mul_ps(az, step)), dampingFactor);
+		hi[ForceX] = hi[ForceY] = hi[ForceZ] = zero;
+
+		storeFields(p + i, 0, lo);
+		storeFields(p + i, 8, hi);
+	}
+	for (; i < n; i++) {
+		if (p[i].damping != damping) {
+			damping = p[i].damping;
+			factor = SimClock::damping(damping, dt);
+		}
+		p[i].integrate(dt, factor);
+	}
+}
+
+AVX2_TARGET static void addForceAvx2(Particle *p, int n, const ofVec3f &perMass) {
+	const __m256 gx = _mm256_set1_ps(perMass.x);
+	const __m256 gy = _mm256_set1_ps(perMass.y);
+	const __m256 gz = _mm256_set1_ps(perMass.z);
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 hi[8];
+		loadFields(p + i, 8, hi);
+		hi[ForceX] = _mm256_add_ps(hi[ForceX], _mm256_mul_ps(gx, hi[Mass]));
+		hi[ForceY] = _mm256_add_ps(hi[ForceY], _mm256_mul_ps(gy, hi[Mass]));
+		hi[ForceZ] = _mm256_add_ps(hi[ForceZ], _mm256_mul_ps(gz, hi[Mass]));
+		storeFields(p + i, 8, hi);
+	}
+	for (; i < n; i++)
+		p[i].forces += perMass * p[i].mass;
+}
+
+AVX2_TARGET static void addForcesAvx2(Particle *p, int n, const ofVec3f *f) {
+	const __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 hi[8];
+		loadFields(p + i, 8, hi);
+		hi[ForceX] = _mm256_add_ps(hi[ForceX], _mm256_i32gather_ps(&f[i].x, stride, 4));
+		hi[ForceY] = _mm256_add_ps(hi[ForceY], _mm256_i32gather_ps(&f[i].y, stride, 4));
+		hi[ForceZ] = _mm256_add_ps(hi[ForceZ], _mm256_i32gather_ps(&f[i].z, stride, 4));
+		storeFields(p + i, 8, hi);
+	}
+	for (; i < n; i++)
+		p[i].forces += f[i];
+}
+
+AVX2_TARGET static void normalizeAvx2(ofVec3f *v, int n, float scale) {
+	const __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	const __m256 s = _mm256_set1_ps(scale);
+	const __m256 zero = _mm256_setzero_ps();
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 x = _mm256_i32gather_ps(&v[i].x, stride, 4);
+		__m256 y = _mm256_i32gather_ps(&v[i].y, stride, 4);
+		__m256 z = _mm256_i32gather_ps(&v[i].z, stride, 4);
+		__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z)));
+
+		// zero length vectors stay zero
+		//
+		__m256 nonzero = _mm256_cmp_ps(length, zero, _CMP_GT_OQ);
+		alignas(32) float out[3][8];
+		_mm256_store_ps(out[0], _mm256_and_ps(_mm256_mul_ps(_mm256_div_ps(x, length), s), nonzero));
+		_mm256_store_ps(out[1], _mm256_and_ps(_mm256_mul_ps(_mm256_div_ps(y, length), s), nonzero));
+		_mm256_store_ps(out[2], _mm256_and_ps(_mm256_mul_ps(_mm256_div_ps(z, length), s), nonzero));
+		for (int k = 0; k < 8; k++)
+			v[i + k].set(out[0][k], out[1][k], out[2][k]);
+	}
+	for (; i < n; i++)
+		v[i] = v[i].getNormalized() * scale;
+}
+
+class Avx2ParticleBackend : public ParticleBackend {
+public:
+	const char *name() const { return "avx2"; }
+
+	void integrate(Particle *particles, int n, float dt) const { integrateAvx2(particles, n, dt); }
+	void addForce(Particle *particles, int n, const ofVec3f &perMass) const { addForceAvx2(particles, n, perMass); }
+	void addForces(Particle *particles, int n, const ofVec3f *f) const { addForcesAvx2(particles, n, f); }
+	void normalize(ofVec3f *v, int n, float scale) const { normalizeAvx2(v, n, scale); }
+};
+
+#endif
+
+const ParticleBackend * ParticleBackend::avx2() {
+#ifdef PARTICLE_USE_AVX2
+	static Avx2ParticleBackend backend;
+	static bool supported = cpuHasAvx2();
+	return supported ? &backend : NULL;
+#else
+	return NULL;
+#endif
+}
+
+const ParticleBackend & ParticleBackend::best() {
+	const ParticleBackend *simd = avx2();
+	return simd ? *simd : scalar();
+}
+
+//  every backend this CPU can run, the scalar one first
+//
+vector<const ParticleBackend *> ParticleBackend::available() {
+	vector<const ParticleBackend *> backends;
+	backends.push_back(&scalar());
+	if (avx2()) backends.push_back(avx2());
+	return backends;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Particle.h"
+
+//  The particle math that runs over every particle every step - force
+//  accumulation and integration - and the direction normalization of
+//  spawning, behind one interface so it can run on different instruction
+//  sets.
+//
+//  The scalar backend is the reference: Particle::integrate() and the
+//  ofVec3f operators, one particle at a time.  The AVX2 backend works on
+//  8 particles at a time, transposing them from the Particle array into
+//  registers and back, with the same operations in the same order and no
+//  fused multiply-add, so both give the same results (--bench particles
+//  checks this).
+//
+//  best() is the fastest backend the CPU has, checked at run time, so one
+//  build runs on any x86 CPU.
+//
+class ParticleBackend {
+public:
+	virtual ~ParticleBackend() {}
+	virtual const char *name() const = 0;
+
+	// particles[i].integrate(dt)
+	virtual void integrate(Particle *particles, int n, float dt) const = 0;
+
+	// particles[i].forces += perMass * particles[i].mass  (gravity)
+	virtual void addForce(Particle *particles, int n, const ofVec3f &perMass) const = 0;
+
+	// particles[i].forces += f[i]
+	virtual void addForces(Particle *particles, int n, const ofVec3f *f) const = 0;
+
+	// v[i] = v[i].getNormalized() * scale
+	virtual void normalize(ofVec3f *v, int n, float scale) const = 0;
+
+	static const ParticleBackend & scalar();
+	static const ParticleBackend * avx2();      // NULL if the CPU doesn't have AVX2
+	static const ParticleBackend & best();
+	static vector<const ParticleBackend *> available();
+};
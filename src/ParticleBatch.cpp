@@ -0,0 +1,65 @@
+
+#include "ParticleBatch.h"
+
+//  register an emitter, all of its particles are drawn in "color"
+//
+void ParticleBatch::add(const ParticleEmitter *emitter, const ofColor &color) {
+	Entry e;
+	e.emitter = emitter;
+	e.color = color;
+	entries.push_back(e);
+}
+
+//  copy the particle positions and bounds of every emitter.  The vectors
+//  keep their capacity, so this doesn't allocate once the counts settle.
+//
+void ParticleBatch::capture() {
+	for (int i = 0; i < entries.size(); i++) {
+		Entry &e = entries[i];
+		const ParticleSystem *sys = e.emitter->sys;
+		const vector<Particle> &particles = sys->particles;
+		e.positions.resize(particles.size());
+		for (int k = 0; k < particles.size(); k++)
+			e.positions[k] = particles[k].position;
+		e.radius = e.emitter->particleRadius;
+		e.boundsMin = sys->boundsMin;
+		e.boundsMax = sys->boundsMax;
+	}
+}
+
+//  number of particles over all emitters at the last capture()
+//
+int ParticleBatch::count() const {
+	int n = 0;
+	for (int i = 0; i < entries.size(); i++)
+		n += entries[i].positions.size();
+	return n;
+}
+
+//  write the vertices of the visible particles to "out", up to capacity.
+//  Returns the number written.
+//
+int ParticleBatch::pack(ParticleVertex *out, int capacity) const {
+	int n = 0;
+	for (int i = 0; i < entries.size() && n < capacity; i++) {
+		const Entry &e = entries[i];
+		if (!e.visible) continue;
+		const vector<glm::vec3> &positions = e.positions;
+		int count = positions.size();
+
+		ParticleVertex v;
+		v.size = e.radius;
+		v.r = e.color.r;
+		v.g = e.color.g;
+		v.b = e.color.b;
+		v.a = e.color.a;
+		for (int k = 0; k < count && n < capacity; k += e.stride) {
+			const glm::vec3 &p = positions[k];
+			v.x = p.x;
+			v.y = p.y;
+			v.z = p.z;
+			out[n++] = v;
+		}
+	}
+	return n;
+}
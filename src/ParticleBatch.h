@@ -0,0 +1,46 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ParticleEmitter.h"
+
+//  Interleaved vertex for one particle sprite - position and size in pixels
+//  (read by the shader as gl_Vertex.xyz / gl_Vertex.w) and color.
+//
+struct ParticleVertex {
+	float x, y, z;
+	float size;
+	unsigned char r, g, b, a;
+};
+
+//  Collects the particles of every registered emitter into one interleaved
+//  vertex array so they can all be drawn with a single draw call.  Packing
+//  is plain CPU work with no GL calls, so it can run (and be timed) headless.
+//  Emitters the view culler marked invisible are skipped, and far ones are
+//  thinned out by their stride.
+//
+//  capture() copies the emitters' particle positions into the batch;
+//  count(), pack() and the culler only read that copy.  A captured batch
+//  doesn't touch the emitters, so it can be handed to the render thread
+//  while the simulation goes on updating them (SimSnapshot).
+//
+class ParticleBatch {
+public:
+	void add(const ParticleEmitter *emitter, const ofColor &color);
+	void capture();
+	int count() const;
+	int pack(ParticleVertex *out, int capacity) const;
+
+	struct Entry {
+		const ParticleEmitter *emitter;
+		ofColor color;
+		bool visible = true;    // set by the view culler
+		int stride = 1;         // pack every stride'th particle (distance LOD)
+
+		// taken by capture()
+		//
+		vector<glm::vec3> positions;
+		float radius = 0;
+		glm::vec3 boundsMin, boundsMax;
+	};
+	vector<Entry> entries;
+};
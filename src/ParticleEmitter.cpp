@@ -38,6 +38,7 @@ void ParticleEmitter::init() {
 	oneShot = false;
 	fired = false;
 	lastSpawned = 0;
+	time = 0;
 	radius = 1;
 	particleRadius = .1;
 	visible = true;
@@ -69,24 +70,23 @@ void ParticleEmitter::draw() {
 }
 void ParticleEmitter::start() {
 	started = true;
-	lastSpawned = ofGetElapsedTimeMillis();
+	lastSpawned = time;
 }
 
 void ParticleEmitter::stop() {
 	started = false;
 	fired = false;
 }
-void ParticleEmitter::update() {
+void ParticleEmitter::update(const SimClock &clock) {
 
-	float time = ofGetElapsedTimeMillis();
+	time = clock.now;
 
 	if (oneShot && started) {
 		if (!fired) {
 
 			// spawn a new particle(s)
 			//
-			for (int i = 0; i < groupSize; i++)
-				spawn(time);
+			spawnGroup(time, groupSize);
 
 			lastSpawned = time;
 		}
@@ -94,69 +94,99 @@ void ParticleEmitter::update() {
 		stop();
 	}
 
-	else if (((time - lastSpawned) > (1000.0 / rate)) && started) {
+	else if (((time - lastSpawned) > (1.0 / rate)) && started) {
 
 		// spawn a new particle(s)
 		//
-		for (int i= 0; i < groupSize; i++)
-			spawn(time);
+		spawnGroup(time, groupSize);
 	
 		lastSpawned = time;
 	}
 
-	sys->update();
+	sys->update(clock);
 }
 
 // spawn a single particle.  time is current time of birth
 //
 void ParticleEmitter::spawn(float time) {
+	spawnGroup(time, 1);
+}
+
+// spawn a group of n particles.  The random directions and lifespans
+// for the whole group are generated (and the directions normalized) in
+// one batch up front.  Sphere and directional emitters don't use random
+// directions, so they skip both.
+//
+void ParticleEmitter::spawnGroup(float time, int n) {
+	if (n <= 0) return;
 
-	Particle particle;
+	Rng &rng = Rng::local();
 
-	// set initial velocity and position
-	// based on emitter type
-	//
+	spawnDirs.resize(n);
+	bool randomDirs = true;
 	switch (type) {
 	case RadialEmitter:
-	{
-		ofVec3f dir = ofVec3f(ofRandom(-1, 1), ofRandom(-1, 1), ofRandom(-1, 1));
-		float speed = velocity.length();
-		particle.velocity = dir.getNormalized() * speed;
-		particle.position.set(position);
-	}
-	break;
-	case SphereEmitter:
-		break;
-	case DirectionalEmitter:
-		particle.velocity = velocity;
-		particle.position.set(position);
+		rng.fill(&spawnDirs[0], n, ofVec3f(-1, -1, -1), ofVec3f(1, 1, 1));
 		break;
 	case CircularEmitter:
-		particle.velocity = velocity;
-		particle.position.set(position + glm::normalize(glm::vec3(ofRandom(-1, 1), 0, ofRandom(-1, 1))) * circularEmitterRadius);
+		rng.fill(&spawnDirs[0], n, ofVec3f(-1, 0, -1), ofVec3f(1, 0, 1));
 		break;
 	case CircularRadialEmitter:
-	{
-		ofVec3f dir = ofVec3f(ofRandom(-1, 1), ofRandom(0, 0.1), ofRandom(-1, 1));
-		float speed = velocity.length();
-		particle.velocity = dir.getNormalized() * speed;
-		particle.position.set(position + dir.getNormalized() * 3);
-	}
-	break;
+		rng.fill(&spawnDirs[0], n, ofVec3f(-1, 0, -1), ofVec3f(1, 0.1, 1));
+		break;
+	default:
+		randomDirs = false;
+		break;
 	}
 
-	// other particle attributes
-	//
 	if (randomLife) {
-		particle.lifespan = ofRandom(lifeMinMax.x, lifeMinMax.y);
+		spawnLifespans.resize(n);
+		rng.fill(&spawnLifespans[0], n, lifeMinMax.x, lifeMinMax.y);
 	}
-	else particle.lifespan = lifespan;
-	particle.birthtime = time;
-	particle.radius = particleRadius;
-	particle.mass = mass;
-	particle.damping = damping;
 
-	// add to system
-	//
-	sys->add(particle);
+	if (randomDirs)
+		sys->backend->normalize(&spawnDirs[0], n, 1);
+	float speed = velocity.length();
+
+	for (int i = 0; i < n; i++) {
+		Particle particle;
+		const ofVec3f &dir = spawnDirs[i];
+
+		// set initial velocity and position
+		// based on emitter type
+		//
+		switch (type) {
+		case RadialEmitter:
+			particle.velocity = dir * speed;
+			particle.position.set(position);
+			break;
+		case SphereEmitter:
+			break;
+		case DirectionalEmitter:
+			particle.velocity = velocity;
+			particle.position.set(position);
+			break;
+		case CircularEmitter:
+			particle.velocity = velocity;
+			particle.position.set(position + dir * circularEmitterRadius);
+			break;
+		case CircularRadialEmitter:
+			particle.velocity = dir * speed;
+			particle.position.set(position + dir * 3);
+			break;
+		}
+
+		// other particle attributes
+		//
+		particle.lifespan = randomLife ? spawnLifespans[i] : lifespan;
+		particle.birthtime = time;
+		particle.deathtime = time + particle.lifespan;
+		particle.radius = particleRadius;
+		particle.mass = mass;
+		particle.damping = damping;
+
+		// add to system
+		//
+		sys->add(particle);
+	}
 }
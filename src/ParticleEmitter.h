@@ -3,6 +3,7 @@
 
 #include "TransformObject.h"
 #include "ParticleSystem.h"
+#include "Random.h"
 
 typedef enum { DirectionalEmitter, RadialEmitter, SphereEmitter, CircularEmitter, CircularRadialEmitter } EmitterType;
 
@@ -29,8 +30,9 @@ public:
 	void setLifespanRange(const ofVec2f &r) { lifeMinMax = r; }
 	void setMass(float m) { mass = m; }
 	void setDamping(float d) { damping = d; }
-	void update();
+	void update(const SimClock &clock);
 	void spawn(float time);
+	void spawnGroup(float time, int n);
 
 	// Method to set Circular emitter radius;
 	void setCircularEmitterRadius(const float r) { circularEmitterRadius = r; }
@@ -46,7 +48,8 @@ public:
 	float mass;
 	float damping;
 	bool started;
-	float lastSpawned;  // ms
+	float lastSpawned;  // sec
+	float time;         // clock time of the last update (sec)
 	float particleRadius;
 	float radius;
 	bool visible;
@@ -56,4 +59,8 @@ public:
 
 	// Circular emitter radius
 	float circularEmitterRadius;
+
+	// scratch buffers for batch spawning (kept to avoid reallocating)
+	vector<ofVec3f> spawnDirs;
+	vector<float> spawnLifespans;
 };
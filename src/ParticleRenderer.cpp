@@ -0,0 +1,143 @@
+
+#include "ParticleRenderer.h"
+
+ParticleRenderer::ParticleRenderer() {
+	capacity = 0;
+	persistent = false;
+	write = NULL;
+	region = 0;
+	used = 0;
+#ifndef TARGET_OPENGLES
+	buffer = 0;
+	mapped = NULL;
+	for (int i = 0; i < numRegions; i++)
+		fences[i] = 0;
+#endif
+}
+
+ParticleRenderer::~ParticleRenderer() {
+#ifndef TARGET_OPENGLES
+	for (int i = 0; i < numRegions; i++)
+		if (fences[i]) glDeleteSync(fences[i]);
+	if (buffer) {
+		if (mapped) {
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+#endif
+}
+
+//  allocate room for maxParticles per frame.  Must be called with a GL context.
+//
+void ParticleRenderer::setup(int maxParticles) {
+	capacity = maxParticles;
+#ifdef TARGET_OPENGLES
+	persistent = false;
+	staging.resize(capacity);
+	colors.resize(capacity);
+#else
+	GLsizeiptr size = (GLsizeiptr)numRegions * capacity * sizeof(ParticleVertex);
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	persistent = GLEW_ARB_buffer_storage && GLEW_ARB_sync;
+	if (persistent) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+		mapped = (ParticleVertex *)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+		if (mapped == NULL) {
+			cout << "ParticleRenderer: persistent map failed, using buffer orphaning" << endl;
+			glDeleteBuffers(1, &buffer);
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			persistent = false;
+		}
+	}
+	if (!persistent) {
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(ParticleVertex), NULL, GL_STREAM_DRAW);
+		staging.resize(capacity);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+#endif
+}
+
+//  start a frame - move on to the next region and make sure the GPU is done with it
+//
+void ParticleRenderer::begin() {
+	used = 0;
+	if (!persistent) {
+		write = staging.data();
+		return;
+	}
+
+#ifndef TARGET_OPENGLES
+	region = (region + 1) % numRegions;
+	if (fences[region]) {
+		GLenum status;
+		do {
+			status = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (status == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fences[region]);
+		fences[region] = 0;
+	}
+	write = mapped + region * capacity;
+#endif
+}
+
+//  pack the batch into this frame's region and return where it went.
+//  Particles past capacity are dropped.
+//
+ParticleRange ParticleRenderer::add(const ParticleBatch &batch) {
+	ParticleRange range;
+	range.first = persistent ? region * capacity + used : used;
+	range.count = batch.pack(write + used, capacity - used);
+	used += range.count;
+	return range;
+}
+
+//  hand this frame's vertices to GL (nothing to do when persistently mapped)
+//
+void ParticleRenderer::upload() {
+	if (persistent || used == 0) return;
+#ifdef TARGET_OPENGLES
+	for (int i = 0; i < used; i++)
+		colors[i].set(staging[i].r / 255.0f, staging[i].g / 255.0f, staging[i].b / 255.0f, staging[i].a / 255.0f);
+	vbo.setVertexData(&staging[0].x, 4, used, GL_STREAM_DRAW, sizeof(ParticleVertex));
+	vbo.setColorData(colors.data(), used, GL_STREAM_DRAW);
+#else
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(ParticleVertex), NULL, GL_STREAM_DRAW);    // orphan
+	glBufferSubData(GL_ARRAY_BUFFER, 0, used * sizeof(ParticleVertex), staging.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+#endif
+}
+
+void ParticleRenderer::draw(const ParticleRange &range) {
+	if (range.count <= 0) return;
+#ifdef TARGET_OPENGLES
+	vbo.draw(GL_POINTS, range.first, range.count);
+#else
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(4, GL_FLOAT, sizeof(ParticleVertex), (void *)offsetof(ParticleVertex, x));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ParticleVertex), (void *)offsetof(ParticleVertex, r));
+	glDrawArrays(GL_POINTS, range.first, range.count);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+#endif
+}
+
+//  end a frame - fence the region so it isn't overwritten while in use
+//
+void ParticleRenderer::end() {
+#ifndef TARGET_OPENGLES
+	if (persistent)
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ParticleBatch.h"
+
+//  Range of the buffer holding one packed batch
+//
+struct ParticleRange {
+	int first = 0;
+	int count = 0;
+};
+
+//  Streaming vertex buffer for drawing particles as point sprites.
+//
+//  One GL buffer is split into three regions used round robin, one per
+//  frame, so the CPU writes frame N while the GPU may still be reading
+//  frames N-1 and N-2.  When ARB_buffer_storage is available the buffer
+//  is persistently mapped and particle positions are written straight into
+//  it, with a fence per region; otherwise positions are staged and the
+//  buffer is orphaned and refilled once per frame (GL_STREAM_DRAW).  On
+//  OpenGL ES, which has neither buffer storage nor client side arrays,
+//  the staged vertices are uploaded to an ofVbo each frame instead.
+//
+//  Usage per frame:  begin(), add() the particle batch, upload(), then
+//  draw() the range add() returned - one draw call for all emitters - and
+//  end().
+//
+class ParticleRenderer {
+public:
+	ParticleRenderer();
+	~ParticleRenderer();
+
+	void setup(int maxParticles);
+	void begin();
+	ParticleRange add(const ParticleBatch &batch);
+	void upload();
+	void draw(const ParticleRange &range);
+	void end();
+
+	int capacity;       // particles per region
+	bool persistent;    // using a persistently mapped buffer
+
+private:
+	static const int numRegions = 3;
+
+	vector<ParticleVertex> staging;     // used when the buffer can't be mapped
+	ParticleVertex *write;              // where this frame's vertices go
+	int region;
+	int used;
+#ifdef TARGET_OPENGLES
+	ofVbo vbo;
+	vector<ofFloatColor> colors;        // the staged colors, as ofVbo takes them
+#else
+	GLuint buffer;
+	ParticleVertex *mapped;             // persistent mapping of the whole buffer
+	GLsync fences[numRegions];
+#endif
+};
@@ -2,9 +2,11 @@
 // Kevin M.Smith - CS 134 SJSU
 
 #include "ParticleSystem.h"
+#include "Random.h"
 
 void ParticleSystem::add(const Particle &p) {
 	particles.push_back(p);
+	hashValid = false;
 }
 
 void ParticleSystem::addForce(ParticleForce *f) {
@@ -13,11 +15,13 @@ void ParticleSystem::addForce(ParticleForce *f) {
 
 void ParticleSystem::remove(int i) {
 	particles.erase(particles.begin() + i);
+	hashValid = false;
 }
 
 void ParticleSystem::setLifespan(float l) {
 	for (int i = 0; i < particles.size(); i++) {
 		particles[i].lifespan = l;
+		particles[i].deathtime = particles[i].birthtime + l;
 	}
 }
 
@@ -27,31 +31,43 @@ void ParticleSystem::reset() {
 	}
 }
 
-void ParticleSystem::update() {
+void ParticleSystem::update(const SimClock &clock) {
+	time = clock.now;
+	hashValid = false;
+	boundsMin = ofVec3f(FLT_MAX, FLT_MAX, FLT_MAX);
+	boundsMax = ofVec3f(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
 	// check if empty and just return
 	if (particles.size() == 0) return;
 
-	vector<Particle>::iterator p = particles.begin();
-	vector<Particle>::iterator tmp;
+	// delete the particles that have passed their time of death.
+	// remove_if compacts the survivors in a single pass.
+	//
+	float now = clock.now;
+	particles.erase(std::remove_if(particles.begin(), particles.end(),
+		[now](const Particle &p) { return p.expired(now); }), particles.end());
 
-	// check which particles have exceed their lifespan and delete
-	// from list.  When deleting multiple objects from a vector while
-	// traversing at the same time, we need to use an iterator.
+	// update forces on all particles first, a force at a time
 	//
-	while (p != particles.end()) {
-		if (p->lifespan != -1 && p->age() > p->lifespan) {
-			tmp = particles.erase(p);
-			p = tmp;
-		}
-		else p++;
+	for (int k = 0; k < forces.size(); k++) {
+		if (!forces[k]->applied)
+			forces[k]->updateForces(particles.data(), particles.size(), *backend);
 	}
 
-	// update forces on all particles first 
+	// neighbours push each other apart
 	//
-	for (int i = 0; i < particles.size(); i++) {
-		for (int k = 0; k < forces.size(); k++) {
-			if (!forces[k]->applied)
-				forces[k]->updateForce( &particles[i] );
+	if (neighbourRadius > 0 && repulsion != 0) {
+		buildHash(neighbourRadius);
+		for (int i = 0; i < particles.size(); i++) {
+			const glm::vec3 &p = positions[i];
+			ofVec3f push;
+			hash.forEachNear(p, neighbourRadius, [&](int j) {
+				glm::vec3 d = p - positions[j];
+				float len = glm::length(d);
+				if (j != i && len > 0)
+					push += ofVec3f(d.x, d.y, d.z) * (repulsion * (1 - len / neighbourRadius) / len);
+			});
+			particles[i].forces += push;
 		}
 	}
 
@@ -63,26 +79,97 @@ void ParticleSystem::update() {
 			forces[i]->applied = true;
 	}
 
-	// integrate all the particles in the store
+	// integrate all the particles in the store, keep them above the ground
+	// and track their bounds for view culling
 	//
-	for (int i = 0; i < particles.size(); i++)
-		particles[i].integrate();
+	hashValid = false;
+	backend->integrate(particles.data(), particles.size(), clock.dt);
+	for (int i = 0; i < particles.size(); i++) {
+		if (ground) collideGround(particles[i]);
+		const ofVec3f &p = particles[i].position;
+		boundsMin.x = min(boundsMin.x, p.x);
+		boundsMin.y = min(boundsMin.y, p.y);
+		boundsMin.z = min(boundsMin.z, p.z);
+		boundsMax.x = max(boundsMax.x, p.x);
+		boundsMax.y = max(boundsMax.y, p.y);
+		boundsMax.z = max(boundsMax.z, p.z);
+	}
+
+}
 
+//  hash the particles' current positions
+//
+void ParticleSystem::buildHash(float cellSize) {
+	positions.resize(particles.size());
+	for (int i = 0; i < particles.size(); i++) {
+		const ofVec3f &p = particles[i].position;
+		positions[i] = glm::vec3(p.x, p.y, p.z);
+	}
+	hash.build(positions.data(), positions.size(), cellSize);
+	hashValid = true;
+}
+
+//  put a particle that has fallen below the ground back on it, bouncing
+//  off the slope there.  Only particles below it need the slope.
+//
+void ParticleSystem::collideGround(Particle &p) {
+	if (p.position.y >= ground->height(p.position.x, p.position.z))
+		return;
+	float h = 0;
+	glm::vec3 n;
+	if (!ground->lookup(p.position.x, p.position.z, h, n))
+		return;
+	p.position.y = h;
+	ofVec3f normal(n.x, n.y, n.z);
+	float into = p.velocity.dot(normal);
+	if (into < 0) {
+		ofVec3f across = normal * into;
+		p.velocity = (p.velocity - across) * (1 - groundFriction) - across * groundRestitution;
+	}
 }
 
-// remove all particlies within "dist" of point (not implemented as yet)
+// remove all particles within "dist" of point, and return how many.
+// Looks them up in the spatial hash, rebuilt first if the particles have
+// changed since it was.
 //
-int ParticleSystem::removeNear(const ofVec3f & point, float dist) { return 0; }
+int ParticleSystem::removeNear(const ofVec3f & point, float dist) {
+	if (particles.empty()) return 0;
+	if (!hashValid)
+		buildHash(neighbourRadius > 0 ? neighbourRadius : max(dist, 0.001f));
+
+	marked.assign(particles.size(), 0);
+	int count = 0;
+	hash.forEachNear(glm::vec3(point.x, point.y, point.z), dist, [&](int i) {
+		marked[i] = 1;
+		count++;
+	});
+	if (count == 0) return 0;
+
+	int n = 0;
+	for (int i = 0; i < particles.size(); i++) {
+		if (!marked[i]) particles[n++] = particles[i];
+	}
+	particles.resize(n);
+	hashValid = false;
+	return count;
+}
 
 //  draw the particle cloud
 //
 void ParticleSystem::draw() {
 	for (int i = 0; i < particles.size(); i++) {
-		particles[i].draw();
+		particles[i].draw(time);
 	}
 }
 
 
+//  the force on each of n particles, one at a time
+//
+void ParticleForce::updateForces(Particle *particles, int n, const ParticleBackend &) {
+	for (int i = 0; i < n; i++)
+		updateForce(&particles[i]);
+}
+
 // Gravity Force Field 
 //
 GravityForce::GravityForce(const ofVec3f &g) {
@@ -96,6 +183,10 @@ void GravityForce::updateForce(Particle * particle) {
 	particle->forces += gravity * particle->mass;
 }
 
+void GravityForce::updateForces(Particle *particles, int n, const ParticleBackend &backend) {
+	backend.addForce(particles, n, gravity);
+}
+
 // Turbulence Force Field 
 //
 TurbulenceForce::TurbulenceForce(const ofVec3f &min, const ofVec3f &max) {
@@ -108,9 +199,16 @@ void TurbulenceForce::updateForce(Particle * particle) {
 	// We are going to add a little "noise" to a particles
 	// forces to achieve a more natual look to the motion
 	//
-	particle->forces.x += ofRandom(tmin.x, tmax.x);
-	particle->forces.y += ofRandom(tmin.y, tmax.y);
-	particle->forces.z += ofRandom(tmin.z, tmax.z);
+	particle->forces += Rng::local().uniform(tmin, tmax);
+}
+
+// the noise for all n particles is generated in one batch
+//
+void TurbulenceForce::updateForces(Particle *particles, int n, const ParticleBackend &backend) {
+	if (n <= 0) return;
+	noise.resize(n);
+	Rng::local().fill(noise.data(), n, tmin, tmax);
+	backend.addForces(particles, n, noise.data());
 }
 
 // Impulse Radial Force - this is a "one shot" force that
@@ -126,10 +224,18 @@ void ImpulseRadialForce::updateForce(Particle * particle) {
 	// we basically create a random direction for each particle
 	// the force is only added once after it is triggered.
 	//
-	ofVec3f dir = ofVec3f(ofRandom(-1, 1), ofRandom(-height/2.0, height/2.0), ofRandom(-1, 1));
+	ofVec3f dir = Rng::local().uniform(ofVec3f(-1, -height / 2.0, -1), ofVec3f(1, height / 2.0, 1));
 	particle->forces += dir.getNormalized() * magnitude;
 }
 
+void ImpulseRadialForce::updateForces(Particle *particles, int n, const ParticleBackend &backend) {
+	if (n <= 0) return;
+	dirs.resize(n);
+	Rng::local().fill(dirs.data(), n, ofVec3f(-1, -height / 2.0, -1), ofVec3f(1, height / 2.0, 1));
+	backend.normalize(dirs.data(), n, magnitude);
+	backend.addForces(particles, n, dirs.data());
+}
+
 CyclicForce::CyclicForce(float magnitude) {
 	this->magnitude = magnitude;
 }
@@ -3,9 +3,16 @@
 
 #include "ofMain.h"
 #include "Particle.h"
+#include "SimClock.h"
+#include "SpatialHash.h"
+#include "HeightField.h"
+#include "ParticleBackend.h"
 
 
 //  Pure Virtual Function Class - must be subclassed to create new forces.
+//  updateForces() applies the force to a whole array of particles; by
+//  default it calls updateForce() on each, forces that map onto the
+//  backend's kernels override it.
 //
 class ParticleForce {
 protected:
@@ -13,6 +20,7 @@ public:
 	bool applyOnce = false;
 	bool applied = false;
 	virtual void updateForce(Particle*) = 0;
+	virtual void updateForces(Particle *particles, int n, const ParticleBackend &backend);
 };
 
 class ParticleSystem {
@@ -20,13 +28,41 @@ public:
 	void add(const Particle&);
 	void addForce(ParticleForce*);
 	void remove(int);
-	void update();
+	void update(const SimClock &clock);
 	void setLifespan(float);
 	void reset();
 	int removeNear(const ofVec3f& point, float dist);
 	void draw();
 	vector<Particle> particles;
 	vector<ParticleForce*> forces;
+	float time = 0;     // clock time of the last update (sec)
+	ofVec3f boundsMin, boundsMax;   // box around the particles at the last update, min > max when empty
+
+	// particles closer than neighbourRadius push each other apart, with up
+	// to repulsion (force) at no distance.  Neighbours come from a spatial
+	// hash rebuilt every update.  0 turns it off.
+	//
+	float neighbourRadius = 0;
+	float repulsion = 0;
+
+	// particles that fall below the ground are put back on it, keeping
+	// groundRestitution of their speed into it (bounce) and losing
+	// groundFriction of their speed along it.  NULL for no ground.
+	//
+	const GroundHeight *ground = NULL;
+	float groundRestitution = 0.3;
+	float groundFriction = 0.5;
+
+	const ParticleBackend *backend = &ParticleBackend::best();     // runs the forces and integration
+
+private:
+	void buildHash(float cellSize);
+	void collideGround(Particle &p);
+
+	SpatialHash hash;               // over the particles' positions while hashValid
+	bool hashValid = false;
+	vector<glm::vec3> positions;    // scratch for buildHash()
+	vector<char> marked;            // scratch for removeNear()
 };
 
 
@@ -40,6 +76,7 @@ public:
 	ofVec3f get() { return gravity; }
 	GravityForce(const ofVec3f& gravity);
 	void updateForce(Particle*);
+	void updateForces(Particle *particles, int n, const ParticleBackend &backend);
 };
 
 class TurbulenceForce : public ParticleForce {
@@ -50,6 +87,9 @@ public:
 	ofVec3f getMax() { return tmax; }
 	TurbulenceForce(const ofVec3f& min, const ofVec3f& max);
 	void updateForce(Particle*);
+	void updateForces(Particle *particles, int n, const ParticleBackend &backend);
+private:
+	vector<ofVec3f> noise;      // scratch for updateForces()
 };
 
 class ImpulseRadialForce : public ParticleForce {
@@ -60,6 +100,9 @@ public:
 	void setHeight(float h) { height = h; }
 	ImpulseRadialForce(float magnitude);
 	void updateForce(Particle*);
+	void updateForces(Particle *particles, int n, const ParticleBackend &backend);
+private:
+	vector<ofVec3f> dirs;       // scratch for updateForces()
 };
 
 class CyclicForce : public ParticleForce {
@@ -0,0 +1,202 @@
+#include "Profiler.h"
+#include <fstream>
+#include <atomic>
+
+Profiler::Profiler() {
+	epoch = std::chrono::steady_clock::now();
+	events.resize(maxEvents);
+	std::fill(frameMs, frameMs + historyFrames, 0.0f);
+	std::fill(frameStarts, frameStarts + historyFrames, 0);
+}
+
+Profiler & Profiler::get() {
+	static Profiler profiler;
+	return profiler;
+}
+
+uint64_t Profiler::now() const {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+//  id of the section called "name", registered on first use
+//
+int Profiler::section(const char *name) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (int i = 0; i < sections.size(); i++)
+		if (sections[i].name == name) return i;
+	sections.push_back(Section());
+	sections.back().name = name;
+	std::fill(sections.back().frameMs, sections.back().frameMs + historyFrames, 0.0f);
+	return sections.size() - 1;
+}
+
+//  small per thread number for the trace, in the order threads first record
+//
+static int threadNumber() {
+	static std::atomic<int> next(0);
+	thread_local int number = next++;
+	return number;
+}
+
+//  the calling thread's buffer: its own once it has one, else one left by
+//  a thread that has ended, else a new one
+//
+Profiler::ThreadEvents & Profiler::threadEvents() {
+	struct Owner {
+		ThreadEvents *buffer = NULL;
+		~Owner() {
+			if (buffer) buffer->owned.store(false, std::memory_order_release);
+		}
+	};
+	thread_local Owner owner;
+	if (!owner.buffer) {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (int i = 0; i < threadBuffers.size() && !owner.buffer; i++) {
+			bool free = false;
+			if (threadBuffers[i]->owned.compare_exchange_strong(free, true, std::memory_order_acquire))
+				owner.buffer = threadBuffers[i].get();
+		}
+		if (!owner.buffer) {
+			threadBuffers.emplace_back(new ThreadEvents());
+			owner.buffer = threadBuffers.back().get();
+			owner.buffer->owned = true;
+		}
+	}
+	return *owner.buffer;
+}
+
+//  add a scope to the calling thread's buffer.  Only a full buffer - no
+//  frame has merged it for a while, as in a batch run - takes the lock,
+//  to merge it.
+//
+void Profiler::record(int section, uint64_t start, uint64_t end) {
+	ThreadEvents &buffer = threadEvents();
+	size_t h = buffer.head.load(std::memory_order_relaxed);
+	if (h - buffer.tail.load(std::memory_order_acquire) == ThreadEvents::capacity) {
+		std::lock_guard<std::mutex> lock(mutex);
+		merge();
+	}
+	Event &e = buffer.ring[h % ThreadEvents::capacity];
+	e.section = section;
+	e.thread = threadNumber();
+	e.start = start;
+	e.end = end;
+	buffer.head.store(h + 1, std::memory_order_release);
+}
+
+//  move the scopes in every thread's buffer into their sections' current
+//  frame and the event history.  mutex must be held.
+//
+void Profiler::merge() {
+	for (int i = 0; i < threadBuffers.size(); i++) {
+		ThreadEvents &buffer = *threadBuffers[i];
+		size_t t = buffer.tail.load(std::memory_order_relaxed);
+		size_t h = buffer.head.load(std::memory_order_acquire);
+		for (; t < h; t++) {
+			const Event &e = buffer.ring[t % ThreadEvents::capacity];
+			sections[e.section].currentMs += (e.end - e.start) / 1000.0f;
+			events[numEvents % maxEvents] = e;
+			numEvents++;
+		}
+		buffer.tail.store(t, std::memory_order_release);
+	}
+}
+
+//  close the current frame and start the next one
+//
+void Profiler::beginFrame() {
+	uint64_t t = now();
+	std::lock_guard<std::mutex> lock(mutex);
+	merge();
+	int slot = frame % historyFrames;
+	if (frame > 0) frameMs[slot] = (t - frameStart) / 1000.0f;
+	for (int i = 0; i < sections.size(); i++) {
+		sections[i].frameMs[slot] = sections[i].currentMs;
+		sections[i].currentMs = 0;
+	}
+	frameStart = t;
+	frameStarts[slot] = t;
+	frame++;
+}
+
+float Profiler::ringAverage(const float *ring, int frames) const {
+	frames = min(frames, min(frame, (int)historyFrames));
+	if (frames <= 0) return 0;
+	float sum = 0;
+	for (int k = 1; k <= frames; k++)
+		sum += ring[(frame - k) % historyFrames];
+	return sum / frames;
+}
+
+float Profiler::ringPeak(const float *ring, int frames) const {
+	frames = min(frames, min(frame, (int)historyFrames));
+	float m = 0;
+	for (int k = 1; k <= frames; k++)
+		m = max(m, ring[(frame - k) % historyFrames]);
+	return m;
+}
+
+float Profiler::average(int s, int frames) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return ringAverage(sections[s].frameMs, frames);
+}
+
+float Profiler::peak(int s, int frames) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return ringPeak(sections[s].frameMs, frames);
+}
+
+float Profiler::frameAverage(int frames) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return ringAverage(frameMs, min(frames, frame - 1));
+}
+
+//  ms per frame of every section, averaged over the last 60 frames, with
+//  the worst frame in brackets
+//
+void Profiler::drawOverlay(float x, float y) const {
+	vector<string> lines;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		lines.push_back("frame             " + ofToString(ringAverage(frameMs, min(60, frame - 1)), 2) + " ms");
+		for (int i = 0; i < sections.size(); i++) {
+			string name = sections[i].name;
+			name.resize(max((int)name.size() + 1, 18), ' ');
+			lines.push_back(name + ofToString(ringAverage(sections[i].frameMs, 60), 2) + " ms  ("
+				+ ofToString(ringPeak(sections[i].frameMs, 60), 2) + ")");
+		}
+	}
+	for (int i = 0; i < lines.size(); i++)
+		ofDrawBitmapString(lines[i], x, y + 15 * i);
+}
+
+//  the recorded scopes as Chrome trace events ("X" complete events, one
+//  row per thread) plus an instant event at each frame start
+//
+bool Profiler::writeTrace(const string &file) {
+	ofstream out(file);
+	if (!out) {
+		cout << "can't write " << file << endl;
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	merge();
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	size_t first = numEvents > maxEvents ? numEvents - maxEvents : 0;
+	uint64_t earliest = UINT64_MAX;     // threads' events are merged a buffer at a time, not in time order
+	for (size_t i = first; i < numEvents; i++) {
+		const Event &e = events[i % maxEvents];
+		earliest = min(earliest, e.start);
+		out << "{\"name\": \"" << sections[e.section].name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.thread
+			<< ", \"ts\": " << e.start << ", \"dur\": " << e.end - e.start << "},\n";
+	}
+	for (int k = min(frame, (int)historyFrames); k >= 1; k--) {
+		uint64_t ts = frameStarts[(frame - k) % historyFrames];
+		if (numEvents > first && ts < earliest) continue;
+		out << "{\"name\": \"frame\", \"ph\": \"i\", \"s\": \"g\", \"pid\": 1, \"tid\": 0, \"ts\": " << ts << "},\n";
+	}
+	out << "{\"name\": \"trace written\", \"ph\": \"i\", \"s\": \"g\", \"pid\": 1, \"tid\": 0, \"ts\": " << now() << "}\n";
+	out << "]}\n";
+	cout << "wrote " << numEvents - first << " trace events to " << file << endl;
+	return true;
+}
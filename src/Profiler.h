@@ -0,0 +1,111 @@
+#pragma once
+
+#include "ofMain.h"
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+//  Frame profiler.  Code is timed with scoped timers:
+//
+//      void ofApp::draw() {
+//          PROFILE_SCOPE("draw");
+//          ...
+//
+//  Every named section keeps its total time per frame for the last
+//  historyFrames frames in a ring buffer (beginFrame() moves on to the next
+//  frame); drawOverlay() shows their averages next to the HUD.  Each scope
+//  is also kept as an event, and writeTrace() writes the recent ones as
+//  Chrome trace event JSON (chrome://tracing or ui.perfetto.dev) to look
+//  at frame spikes offline.  Scopes may run on any thread; each thread
+//  records into a ring of its own without a lock, and beginFrame() and
+//  writeTrace() merge the rings into the sections and the event history.
+//
+//  The profiler is off until enabled - a scope then costs one branch, so
+//  the simulation core can stay instrumented in batch runs.
+//
+class Profiler {
+public:
+	static Profiler & get();
+
+	int section(const char *name);
+	void beginFrame();
+	void record(int section, uint64_t start, uint64_t end);
+	uint64_t now() const;       // us since the profiler was created
+
+	float average(int section, int frames = 60) const;  // ms per frame
+	float peak(int section, int frames = 60) const;     // ms
+	float frameAverage(int frames = 60) const;          // ms between beginFrame() calls
+	void drawOverlay(float x, float y) const;
+	bool writeTrace(const string &file);
+
+	std::atomic<bool> enabled{ false };     // set on the main thread, read by scopes on any thread
+
+	static const int historyFrames = 240;
+	static const int maxEvents = 1 << 16;
+
+private:
+	Profiler();
+
+	struct Section {
+		string name;
+		float frameMs[historyFrames];   // ring, indexed like frameMs below
+		float currentMs = 0;            // this frame so far
+	};
+	struct Event {
+		int section;
+		int thread;
+		uint64_t start, end;            // us
+	};
+
+	// scopes recorded by one thread and not merged yet - a single producer
+	// (the owner), single consumer (merge(), under mutex) ring.  A thread
+	// that ends leaves its buffer to the next new one.
+	//
+	struct ThreadEvents {
+		static const int capacity = 4096;
+		Event ring[capacity];
+		std::atomic<size_t> head{ 0 };      // next to write
+		std::atomic<size_t> tail{ 0 };      // next to merge
+		std::atomic<bool> owned{ false };   // by a running thread
+	};
+
+	ThreadEvents & threadEvents();
+	void merge();
+	float ringAverage(const float *ring, int frames) const;
+	float ringPeak(const float *ring, int frames) const;
+
+	mutable std::mutex mutex;
+	vector<std::unique_ptr<ThreadEvents>> threadBuffers;
+	vector<Section> sections;
+	vector<Event> events;               // ring of the last maxEvents scopes
+	size_t numEvents = 0;               // recorded so far, events[numEvents % maxEvents] is next
+	float frameMs[historyFrames];       // ring of whole frame times
+	uint64_t frameStarts[historyFrames];
+	int frame = 0;                      // frames so far
+	uint64_t frameStart = 0;
+	std::chrono::steady_clock::time_point epoch;
+};
+
+//  times the enclosing scope into a section
+//
+class ProfileScope {
+public:
+	ProfileScope(int section) : section(section), active(Profiler::get().enabled.load(std::memory_order_relaxed)) {
+		if (active) start = Profiler::get().now();
+	}
+	~ProfileScope() {
+		if (active) Profiler::get().record(section, start, Profiler::get().now());
+	}
+
+private:
+	int section;
+	bool active;
+	uint64_t start = 0;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) \
+	static const int PROFILE_CONCAT(profileSection, __LINE__) = Profiler::get().section(name); \
+	ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileSection, __LINE__))
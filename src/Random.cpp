@@ -0,0 +1,130 @@
+
+#include "Random.h"
+#include <atomic>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RNG_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+static std::atomic<uint64_t> globalSeed(Rng::defaultSeed);
+static std::atomic<uint32_t> threadCount(0);
+
+// splitmix64 - used to expand a 64 bit seed into generator state
+//
+static uint64_t splitmix64(uint64_t &x) {
+	uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static inline uint32_t rotl(uint32_t x, int k) {
+	return (x << k) | (x >> (32 - k));
+}
+
+// one xoshiro128+ step on a single stream
+//
+static inline uint32_t step(uint32_t &s0, uint32_t &s1, uint32_t &s2, uint32_t &s3) {
+	uint32_t result = s0 + s3;
+	uint32_t t = s1 << 9;
+	s2 ^= s0;
+	s3 ^= s1;
+	s1 ^= s2;
+	s0 ^= s3;
+	s2 ^= t;
+	s3 = rotl(s3, 11);
+	return result;
+}
+
+void Xoshiro128Plus::setSeed(uint64_t seed) {
+	uint64_t x = seed;
+	for (int i = 0; i < 4; i += 2) {
+		uint64_t z = splitmix64(x);
+		s[i] = (uint32_t)z;
+		s[i + 1] = (uint32_t)(z >> 32);
+	}
+	for (int w = 0; w < 4; w++) {
+		for (int l = 0; l < 4; l += 2) {
+			uint64_t z = splitmix64(x);
+			lanes[w][l] = (uint32_t)z;
+			lanes[w][l + 1] = (uint32_t)(z >> 32);
+		}
+	}
+}
+
+uint32_t Xoshiro128Plus::next() {
+	return step(s[0], s[1], s[2], s[3]);
+}
+
+// fill "out" with n floats in [0, 1), four streams at a time
+//
+void Xoshiro128Plus::fillUnit(float *out, int n) {
+	int i = 0;
+#ifdef RNG_USE_SSE2
+	__m128i s0 = _mm_loadu_si128((const __m128i *)lanes[0]);
+	__m128i s1 = _mm_loadu_si128((const __m128i *)lanes[1]);
+	__m128i s2 = _mm_loadu_si128((const __m128i *)lanes[2]);
+	__m128i s3 = _mm_loadu_si128((const __m128i *)lanes[3]);
+	const __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i result = _mm_add_epi32(s0, s3);
+		__m128i t = _mm_slli_epi32(s1, 9);
+		s2 = _mm_xor_si128(s2, s0);
+		s3 = _mm_xor_si128(s3, s1);
+		s1 = _mm_xor_si128(s1, s2);
+		s0 = _mm_xor_si128(s0, s3);
+		s2 = _mm_xor_si128(s2, t);
+		s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(result, 8)), scale));
+	}
+
+	_mm_storeu_si128((__m128i *)lanes[0], s0);
+	_mm_storeu_si128((__m128i *)lanes[1], s1);
+	_mm_storeu_si128((__m128i *)lanes[2], s2);
+	_mm_storeu_si128((__m128i *)lanes[3], s3);
+#else
+	for (; i + 4 <= n; i += 4) {
+		for (int l = 0; l < 4; l++) {
+			uint32_t r = step(lanes[0][l], lanes[1][l], lanes[2][l], lanes[3][l]);
+			out[i + l] = (r >> 8) * (1.0f / 16777216.0f);
+		}
+	}
+#endif
+
+	// left over values come from the scalar stream
+	//
+	for (; i < n; i++)
+		out[i] = (next() >> 8) * (1.0f / 16777216.0f);
+}
+
+// PCG32 (XSH RR) - one stream, so fillUnit() is a plain loop
+//
+void Pcg32::setSeed(uint64_t seed) {
+	uint64_t x = seed;
+	state = splitmix64(x);
+	inc = splitmix64(x) | 1;
+}
+
+uint32_t Pcg32::next() {
+	uint64_t old = state;
+	state = old * 6364136223846793005ULL + inc;
+	uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+	int rot = (int)(old >> 59);
+	return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+void Pcg32::fillUnit(float *out, int n) {
+	for (int i = 0; i < n; i++)
+		out[i] = (next() >> 8) * (1.0f / 16777216.0f);
+}
+
+uint64_t RandomSeeds::forNewThread() {
+	return globalSeed + 0x632BE59BD9B4E019ULL * threadCount++;
+}
+
+void RandomSeeds::reset(uint64_t seed) {
+	globalSeed = seed;
+	threadCount = 1;
+}
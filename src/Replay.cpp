@@ -0,0 +1,289 @@
+#include "Replay.h"
+#include "BatchRunner.h"
+#include "SimClock.h"
+#include <fstream>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+
+//  start recording a game that starts from sim's current state.  The
+//  caller has seeded sim.rng with seed.
+//
+void ReplayLog::begin(const LanderSim &sim, uint64_t rngSeed, float step, float now, const string &terrainFile) {
+	*this = ReplayLog();
+	stepSize = step;
+	startTime = now;
+	seed = rngSeed;
+	startPos = sim.pos;
+	fuel = sim.fuelLevel;
+	boundsMin = sim.boundsMin;
+	boundsMax = sim.boundsMax;
+	gravity = sim.gravity;
+	turbMin = sim.turbMin;
+	turbMax = sim.turbMax;
+	zones = sim.zones;
+	terrain = terrainFile;
+	recording = true;
+}
+
+//  one step was taken with "input", sim is the state after it
+//
+void ReplayLog::record(const LanderInput &input, const LanderSim &sim) {
+	if (!recording) return;
+	uint8_t bits = pack(input, sim.measureAltitude);
+	if (!runs.empty() && runs.back().input == bits)
+		runs.back().steps++;
+	else
+		runs.push_back({ 1, bits });
+
+	steps++;
+	if (steps % checkpointSteps == 0)
+		checkpoints.push_back(sim.stateHash());
+	finalHash = sim.stateHash();
+	outcome = sim.outcome();
+}
+
+//  the lander was put at pos before the next step
+//
+void ReplayLog::move(const glm::vec3 &pos) {
+	if (!recording) return;
+	if (!moves.empty() && moves.back().step == steps)
+		moves.back().pos = pos;
+	else
+		moves.push_back({ steps, pos });
+}
+
+uint8_t ReplayLog::pack(const LanderInput &input, bool measureAltitude) {
+	return input.bits() | (measureAltitude ? MeasureAltitude : 0);
+}
+
+LanderInput ReplayLog::unpack(uint8_t bits) {
+	return LanderInput::fromBits(bits);
+}
+
+template <class T>
+static void put(ofstream &out, const T &v) {
+	out.write((const char *)&v, sizeof(T));
+}
+
+template <class T>
+static void get(ifstream &in, T &v) {
+	in.read((char *)&v, sizeof(T));
+}
+
+bool ReplayLog::save(const string &file) const {
+	ofstream out(file, ios::binary);
+	if (!out) {
+		cout << "can't write replay: " << file << endl;
+		return false;
+	}
+	out.write("LREC", 4);
+	put(out, (uint32_t)1);
+	put(out, stepSize);
+	put(out, startTime);
+	put(out, seed);
+	put(out, startPos);
+	put(out, fuel);
+	put(out, boundsMin);
+	put(out, boundsMax);
+	put(out, gravity);
+	put(out, turbMin);
+	put(out, turbMax);
+
+	put(out, (uint32_t)zones.size());
+	for (int i = 0; i < zones.size(); i++) {
+		put(out, zones[i].lightPos);
+		put(out, zones[i].lightDir);
+		put(out, zones[i].angle);
+		put(out, zones[i].radius);
+	}
+	put(out, (uint32_t)terrain.size());
+	out.write(terrain.data(), terrain.size());
+
+	put(out, (uint32_t)runs.size());
+	for (int i = 0; i < runs.size(); i++) {
+		put(out, runs[i].steps);
+		put(out, runs[i].input);
+	}
+	put(out, (uint32_t)moves.size());
+	for (int i = 0; i < moves.size(); i++) {
+		put(out, moves[i].step);
+		put(out, moves[i].pos);
+	}
+	put(out, (uint32_t)checkpoints.size());
+	out.write((const char *)checkpoints.data(), checkpoints.size() * sizeof(uint64_t));
+	put(out, steps);
+	put(out, finalHash);
+	put(out, (uint32_t)outcome);
+	return (bool)out;
+}
+
+bool ReplayLog::load(const string &file) {
+	*this = ReplayLog();
+	ifstream in(file, ios::binary);
+	char magic[4];
+	uint32_t version = 0, n = 0;
+	in.read(magic, 4);
+	get(in, version);
+	if (!in || strncmp(magic, "LREC", 4) != 0 || version != 1) {
+		cout << "not a replay file: " << file << endl;
+		return false;
+	}
+	get(in, stepSize);
+	get(in, startTime);
+	get(in, seed);
+	get(in, startPos);
+	get(in, fuel);
+	get(in, boundsMin);
+	get(in, boundsMax);
+	get(in, gravity);
+	get(in, turbMin);
+	get(in, turbMax);
+
+	get(in, n);
+	zones.resize(in ? n : 0);
+	for (int i = 0; i < zones.size(); i++) {
+		get(in, zones[i].lightPos);
+		get(in, zones[i].lightDir);
+		get(in, zones[i].angle);
+		get(in, zones[i].radius);
+	}
+	get(in, n);
+	terrain.resize(in ? n : 0);
+	in.read(&terrain[0], terrain.size());
+
+	get(in, n);
+	runs.resize(in ? n : 0);
+	for (int i = 0; i < runs.size(); i++) {
+		get(in, runs[i].steps);
+		get(in, runs[i].input);
+	}
+	get(in, n);
+	moves.resize(in ? n : 0);
+	for (int i = 0; i < moves.size(); i++) {
+		get(in, moves[i].step);
+		get(in, moves[i].pos);
+	}
+	get(in, n);
+	checkpoints.resize(in ? n : 0);
+	in.read((char *)checkpoints.data(), checkpoints.size() * sizeof(uint64_t));
+	uint32_t out = 0;
+	get(in, steps);
+	get(in, finalHash);
+	get(in, out);
+	outcome = (LanderOutcome)out;
+	if (!in) {
+		cout << "replay file is truncated: " << file << endl;
+		return false;
+	}
+	return true;
+}
+
+//  run the recorded game on sim (set up with the terrain) and compare the
+//  state with the recording as it goes
+//
+ReplayResult Replay::play(const ReplayLog &log, LanderSim &sim) {
+	ReplayResult result;
+	auto start = std::chrono::steady_clock::now();
+
+	sim.boundsMin = log.boundsMin;
+	sim.boundsMax = log.boundsMax;
+	sim.gravity = log.gravity;
+	sim.turbMin = log.turbMin;
+	sim.turbMax = log.turbMax;
+	sim.zones = log.zones;
+	sim.rng.setSeed(log.seed);
+	sim.reset(log.startPos, log.fuel);
+
+	// the clock does the same float arithmetic as the game's
+	//
+	SimClock clock;
+	clock.now = log.startTime;
+	int move = 0, checkpoint = 0;
+	bool matches = true;
+	for (int r = 0; r < log.runs.size(); r++) {
+		LanderInput input = ReplayLog::unpack(log.runs[r].input);
+		sim.measureAltitude = log.runs[r].input & ReplayLog::MeasureAltitude;
+		for (uint32_t k = 0; k < log.runs[r].steps; k++) {
+			while (move < log.moves.size() && log.moves[move].step == result.steps)
+				sim.pos = log.moves[move++].pos;
+
+			clock.step(log.stepSize);
+			sim.step(clock.dt, clock.now, input);
+			result.steps++;
+
+			if (result.steps % ReplayLog::checkpointSteps == 0 && checkpoint < log.checkpoints.size()) {
+				if (matches && sim.stateHash() != log.checkpoints[checkpoint]) {
+					matches = false;
+					result.divergedAt = result.steps;
+				}
+				checkpoint++;
+			}
+		}
+	}
+	result.outcome = sim.outcome();
+	result.identical = matches && result.steps == log.steps && sim.stateHash() == log.finalHash;
+	if (matches && !result.identical)
+		result.divergedAt = result.steps;
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+//  command line entry point for --replay
+//
+int Replay::main(int argc, char *argv[]) {
+	if (argc < 3) {
+		cout << "usage: --replay file.rec [--terrain file.obj] [--repeat N]" << endl;
+		return 1;
+	}
+	ReplayLog log;
+	if (!log.load(argv[2]))
+		return 1;
+
+	string terrainFile = log.terrain;
+	int repeat = 1;
+	for (int i = 3; i + 1 < argc; i += 2) {
+		string opt = argv[i];
+		if (opt == "--terrain") terrainFile = argv[i + 1];
+		else if (opt == "--repeat") repeat = max(1, atoi(argv[i + 1]));
+		else {
+			cout << "unknown option: " << opt << endl;
+			return 1;
+		}
+	}
+
+	// the terrain octree is built as the game builds it for an .obj; a game
+	// played on streamed tiles needs its .obj given with --terrain, and
+	// may not replay exactly (the tiles' octrees differ)
+	//
+	if (std::filesystem::path(terrainFile).extension() != ".obj") {
+		cout << "replay needs the terrain .obj (recorded on " << log.terrain << "), use --terrain" << endl;
+		return 1;
+	}
+	BatchRunner runner;
+	if (!runner.setup(terrainFile, ofToDataPath("geo/ufo.obj")))
+		return 1;
+
+	cout << "replaying " << log.steps << " steps (" << log.runs.size() << " input runs, "
+		<< log.moves.size() << " moves) on " << terrainFile << endl;
+	LanderSim sim;
+	sim.setup(&runner.octree, log.boundsMin, log.boundsMax);
+	bool identical = true;
+	double best = DBL_MAX, total = 0;
+	for (int i = 0; i < repeat; i++) {
+		ReplayResult result = Replay::play(log, sim);
+		best = min(best, result.seconds);
+		total += result.seconds;
+		if (i == 0) {
+			cout << "  outcome: " << LanderSim::outcomeName(result.outcome) << " (recorded: " << LanderSim::outcomeName(log.outcome) << ")" << endl;
+			if (result.identical)
+				cout << "  identical to the recording" << endl;
+			else
+				cout << "  DIVERGED from the recording by step " << result.divergedAt << endl;
+		}
+		identical = identical && result.identical;
+	}
+	cout << "  " << ofToString(best * 1000, 2) << " ms best, " << ofToString(total * 1000 / repeat, 2) << " ms mean, "
+		<< ofToString(log.steps / best / 1e6, 2) << "M steps/sec" << endl;
+	return identical ? 0 : 2;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "ofMain.h"
+#include "LanderSim.h"
+
+//  Deterministic record and replay of a game.
+//
+//  The simulation only depends on its setup, the random seed, the
+//  simulation time it started at and the input of every fixed step - not
+//  on the frame rate or wall clock time.  ReplayLog records those while a
+//  game is played (ofApp writes it to data/replay.rec when the game ends)
+//  and Replay plays a log back on the simulation core, headless and as fast
+//  as possible:
+//
+//      <app> --replay replay.rec [--terrain file.obj] [--repeat N]
+//
+//  The log also holds a hash of the lander state every checkpointSteps
+//  steps and at the end, so a replay can tell whether it reproduced the
+//  game exactly, and at which step it first went wrong if not.  Replays of
+//  the same log make a behaviour regression test, and their timing a
+//  performance one.
+//
+//  File layout (little endian):
+//
+//      "LREC"  uint32 version
+//      float stepSize, startTime  uint64 seed
+//      float startPos[3], fuel, boundsMin[3], boundsMax[3], gravity[3], turbMin[3], turbMax[3]
+//      uint32 numZones  numZones x { float lightPos[3], lightDir[3], angle, radius }
+//      uint32 length  char terrain[length]
+//      uint32 numRuns  numRuns x { uint32 steps  uint8 input }
+//      uint32 numMoves  numMoves x { uint64 step  float pos[3] }
+//      uint32 numCheckpoints  numCheckpoints x uint64 hash
+//      uint64 steps, finalHash  uint32 outcome
+//
+
+//  the recording of one game
+//
+struct ReplayLog {
+	// input bits of one step: LanderInput::bits(), plus
+	//
+	enum { MeasureAltitude = 32 };
+
+	//  "steps" consecutive steps with the same input
+	//
+	struct Run {
+		uint32_t steps;
+		uint8_t input;
+	};
+
+	//  lander moved by hand (dragged) before step "step"
+	//
+	struct Move {
+		uint64_t step;
+		glm::vec3 pos;
+	};
+
+	void begin(const LanderSim &sim, uint64_t seed, float stepSize, float startTime, const string &terrain);
+	void record(const LanderInput &input, const LanderSim &sim);
+	void move(const glm::vec3 &pos);
+	bool save(const string &file) const;
+	bool load(const string &file);
+
+	static uint8_t pack(const LanderInput &input, bool measureAltitude);
+	static LanderInput unpack(uint8_t bits);
+
+	static const int checkpointSteps = 60;
+
+	// setup
+	//
+	float stepSize = 1.0 / 60.0;
+	float startTime = 0;        // simulation time at the start (sec)
+	uint64_t seed = 0;          // of the lander's Rng
+	glm::vec3 startPos;
+	float fuel = 0;
+	glm::vec3 boundsMin, boundsMax;
+	glm::vec3 gravity, turbMin, turbMax;
+	vector<LandingZone> zones;
+	string terrain;             // file the terrain was loaded from
+
+	// what happened
+	//
+	vector<Run> runs;
+	vector<Move> moves;
+	vector<uint64_t> checkpoints;   // state hash after every checkpointSteps steps
+	uint64_t steps = 0;
+	uint64_t finalHash = 0;
+	LanderOutcome outcome = LanderFlying;
+
+	bool recording = false;
+};
+
+//  how a replay went
+//
+struct ReplayResult {
+	uint64_t steps = 0;
+	int64_t divergedAt = -1;    // first step whose checkpoint didn't match, -1 if none
+	bool identical = false;     // every checkpoint and the final state matched
+	LanderOutcome outcome = LanderFlying;
+	double seconds = 0;         // wall clock time
+};
+
+class Replay {
+public:
+	static ReplayResult play(const ReplayLog &log, LanderSim &sim);
+	static int main(int argc, char *argv[]);
+};
@@ -0,0 +1,81 @@
+
+#include "SimClock.h"
+
+SimClock::SimClock() {
+	timeScale = 1;
+	paused = false;
+	stepSize = 1.0 / 60.0;
+	maxSubsteps = 8;
+	reset();
+}
+
+void SimClock::reset() {
+	now = 0;
+	dt = 0;
+	frame = 0;
+	alpha = 0;
+	stepEnd = 0;
+	accumulator = 0;
+	pendingSteps = 0;
+	frameReal = 0;
+	started = false;
+}
+
+//  sample the (scaled) real time elapsed since the last frame.  The
+//  difference is taken in whole us and only then made seconds, so it
+//  doesn't lose precision however long the game has run.
+//
+void SimClock::beginFrame() {
+	uint64_t real = ofGetElapsedTimeMicros();
+	float elapsed = started ? (real - frameReal) / 1.0e6f : 0;
+	frameReal = real;
+	started = true;
+	advance(paused ? 0 : elapsed * timeScale);
+}
+
+//  add elapsed time to the accumulator and work out how many steps to run.
+//  If we are too far behind, drop the backlog rather than trying to catch up.
+//
+void SimClock::advance(float elapsed) {
+	accumulator += elapsed;
+	pendingSteps = (int)(accumulator / stepSize);
+	if (pendingSteps > maxSubsteps) {
+		pendingSteps = maxSubsteps;
+		accumulator = fmod(accumulator, stepSize) + maxSubsteps * stepSize;
+	}
+	alpha = accumulator / stepSize;
+}
+
+//  take the next fixed step of this frame, returns false when there are none left
+//
+bool SimClock::nextStep() {
+	if (pendingSteps <= 0) {
+		alpha = accumulator / stepSize;
+		return false;
+	}
+	pendingSteps--;
+	accumulator -= stepSize;
+	step(stepSize);
+
+	// what is left in the accumulator after this step is (scaled) real
+	// time since it ended
+	//
+	uint64_t after = timeScale > 0 ? (uint64_t)(max(accumulator, 0.0f) / timeScale * 1.0e6) : 0;
+	stepEnd = frameReal > after ? frameReal - after : 0;
+	return true;
+}
+
+//  advance by a given amount of simulation time
+//
+void SimClock::step(float delta) {
+	dt = delta;
+	now += delta;
+	frame++;
+}
+
+//  damping^(dt * tunedRate), in double so that at the tuned rate it is
+//  exactly "perStep"
+//
+float SimClock::damping(float perStep, float dt) {
+	return (float)pow((double)perStep, (double)dt * tunedRate);
+}
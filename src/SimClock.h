@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ofMain.h"
+
+//  Fixed step simulation clock.
+//
+//  beginFrame() samples real time once per rendered frame and adds it to
+//  an accumulator; nextStep() then hands out as many fixed size steps as
+//  fit in it (capped at maxSubsteps so a slow frame can't spiral).  What
+//  is left over is returned in alpha, for interpolating render state
+//  between the last two steps.
+//
+//  Each step handed out by nextStep() also gets the real time it ends at
+//  (stepEnd), the point up to which input events belong to it.
+//
+//  Without a window, step() can be called directly to run the simulation
+//  as fast as possible.
+//
+class SimClock {
+public:
+	SimClock();
+
+	void beginFrame();
+	void advance(float elapsed);
+	bool nextStep();
+	void step(float dt);
+	void reset();
+
+	void setPaused(bool p) { paused = p; }
+	void setTimeScale(float s) { timeScale = s; }
+	void setStepRate(float hz) { stepSize = 1.0 / hz; }
+	void setMaxSubsteps(int n) { maxSubsteps = n; }
+
+	// damping factors (velocity *= damping) are per step at the rate the
+	// game was tuned at; this is the factor for a step of dt that damps
+	// as much per second
+	//
+	static constexpr float tunedRate = 60;     // Hz
+	static float damping(float perStep, float dt);
+
+	float now;          // simulation time (sec)
+	float dt;           // length of the last step (sec)
+	uint64_t frame;     // number of steps so far
+	float alpha;        // fraction of a step left over after this frame's steps
+	uint64_t stepEnd;   // real time the current step ends at (us, ofGetElapsedTimeMicros())
+	float stepSize;     // sec
+	int maxSubsteps;
+	bool paused;
+	float timeScale;
+
+private:
+	float accumulator;  // sec
+	int pendingSteps;
+	uint64_t frameReal; // real time at the last frame (us)
+	bool started;
+};
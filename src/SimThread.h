@@ -0,0 +1,98 @@
+#pragma once
+
+#include "ofMain.h"
+#include "LanderSim.h"
+#include "Autopilot.h"
+#include "ParticleBatch.h"
+#include "InputQueue.h"
+#include <atomic>
+#include <memory>
+
+//  The exchange between the simulation thread and the main (render)
+//  thread.  ofApp runs physics, collision and the particle emitters on a
+//  thread of their own; the main thread only talks to it through
+//
+//      SimCommand      main -> sim, SpscQueue: start a game, move the
+//                      lander, new terrain ...
+//      SimSnapshot     sim -> main, TripleBuffer: the state to draw,
+//                      published after each batch of steps
+//      LanderEvents    sim -> main, SpscQueue: what happened (sounds) -
+//                      queued so none is lost when the main thread skips
+//                      a snapshot, and merged into one while the queue is
+//                      full.  The end of a game is counted in the
+//                      snapshot instead (gamesFinished), so it can't be
+//                      lost either.
+//
+//  so neither side waits for the other, and a slow frame doesn't slow
+//  the physics down.
+//
+
+//  Lock free triple buffer for one writer and one reader.  The writer
+//  fills back() and publish()es it; the reader calls update() and reads
+//  front(), the latest published value, for as long as it likes.  The
+//  third slot lets either side swap without waiting for the other.
+//
+template <class T>
+class TripleBuffer {
+public:
+	// writer
+	//
+	T & back() { return slots[backIndex]; }
+	void publish() {
+		backIndex = middle.exchange(backIndex | Fresh, std::memory_order_acq_rel) & IndexMask;
+	}
+
+	// reader - true if there was a newer value
+	//
+	bool update() {
+		if (!(middle.load(std::memory_order_relaxed) & Fresh))
+			return false;
+		frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & IndexMask;
+		return true;
+	}
+	T & front() { return slots[frontIndex]; }
+
+private:
+	enum { IndexMask = 3, Fresh = 4 };
+
+	T slots[3];
+	int backIndex = 0;                  // writer's
+	int frontIndex = 1;                 // reader's
+	std::atomic<int> middle{ 2 };       // last published (| Fresh until the reader takes it)
+};
+
+//  What the main thread needs to draw a frame.  The lander state of the
+//  last two steps is there to interpolate between.
+//
+struct SimSnapshot {
+	uint64_t steps = 0;
+	uint64_t stepEnd = 0;       // real time the last step ended (us, ofGetElapsedTimeMicros())
+	float stepSize = 1.0 / 60.0;
+
+	glm::vec3 pos, prevPos;
+	float rot = 0, prevRot = 0;
+	glm::vec3 velocity;
+	float fuelLevel = 0;
+	float altitude = FLT_MAX;
+	bool gameOver = false;
+	bool gameComplete = false;
+	bool gameEnd = false;
+	uint64_t gamesFinished = 0; // games whose outcome has been shown; the main thread stops one when it goes up
+
+	bool autopilot = false;
+	AutopilotPlan plan;         // the autopilot's (inputs left out)
+	uint64_t rollouts = 0;
+
+	ParticleBatch particles;    // captured, with the culler's marks on the main side
+};
+
+struct SimCommand {
+	enum Type { Start, Move, MeasureAltitude, Terrain, Autopilot };
+
+	Type type = Start;
+	uint64_t seed = 0;          // Start: lander Rng seed
+	glm::vec3 pos;              // Move
+	bool flag = false;          // MeasureAltitude, Autopilot: on; Terrain: ground under the lander is loaded
+	vector<std::shared_ptr<const Octree>> terrain;     // Terrain: resident tiles
+	vector<std::shared_ptr<const HeightField>> heights; // Terrain: their height fields
+};
@@ -0,0 +1,33 @@
+#include "SpatialHash.h"
+
+//  hash n points into cells of cellSize.  The table has at least twice as
+//  many buckets as points, so buckets rarely hold more than one cell.
+//
+void SpatialHash::build(const glm::vec3 *p, int n, float size) {
+	cellSize = size;
+	invCellSize = 1 / size;
+	int tableSize = 64;
+	while (tableSize < 2 * n) tableSize *= 2;
+	mask = tableSize - 1;
+
+	// count, prefix sum to the end of each bucket, then scatter backwards
+	// so each bucket's start is left behind in start[]
+	//
+	start.assign(tableSize + 1, 0);
+	bucketOf.resize(n);
+	for (int i = 0; i < n; i++) {
+		int b = bucket(cell(p[i].x), cell(p[i].y), cell(p[i].z));
+		bucketOf[i] = b;
+		start[b]++;
+	}
+	for (int b = 1; b <= tableSize; b++)
+		start[b] += start[b - 1];
+
+	ids.resize(n);
+	points.resize(n);
+	for (int i = n - 1; i >= 0; i--) {
+		int k = --start[bucketOf[i]];
+		ids[k] = i;
+		points[k] = p[i];
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ofMain.h"
+
+//  Uniform grid over points, hashed into a fixed table, for neighbour
+//  queries between many moving points (particles).
+//
+//  build() is rebuilt from scratch every frame in O(n) with a counting
+//  sort: count the points per bucket, prefix sum the counts into bucket
+//  starts, then scatter the point ids (and a copy of their positions) so
+//  each bucket's points are contiguous.  No per cell allocation, no
+//  pointers to chase.  Distinct cells may share a bucket; queries check
+//  the distance so that only costs time, and they visit each bucket once.
+//
+//      hash.build(positions, n, radius);
+//      hash.forEachNear(p, radius, [&](int i) { ... });
+//
+class SpatialHash {
+public:
+	void build(const glm::vec3 *points, int n, float cellSize);
+	template <class F> void forEachNear(const glm::vec3 &p, float r, F f) const;
+	int size() const { return ids.size(); }
+
+	float cellSize = 1;
+
+private:
+	int bucket(int x, int y, int z) const {
+		return (((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u)) & mask;
+	}
+	int cell(float v) const { return (int)floor(v * invCellSize); }
+
+	float invCellSize = 1;
+	int mask = 0;
+	vector<int> start;              // bucket b's points are [start[b], start[b + 1])
+	vector<int> ids;                // point ids in bucket order
+	vector<glm::vec3> points;       // their positions, in the same order
+	vector<int> bucketOf;           // scratch for build()
+};
+
+//  call f(i) for every point i within r of p (borders included)
+//
+template <class F>
+void SpatialHash::forEachNear(const glm::vec3 &p, float r, F f) const {
+	if (ids.empty()) return;
+	float r2 = r * r;
+	int x0 = cell(p.x - r), x1 = cell(p.x + r);
+	int y0 = cell(p.y - r), y1 = cell(p.y + r);
+	int z0 = cell(p.z - r), z1 = cell(p.z + r);
+
+	// a query much larger than a cell is better off checking every point
+	//
+	const int maxBuckets = 64;
+	if ((int64_t)(x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1) > maxBuckets) {
+		for (int k = 0; k < points.size(); k++) {
+			glm::vec3 d = points[k] - p;
+			if (glm::dot(d, d) <= r2) f(ids[k]);
+		}
+		return;
+	}
+
+	int visited[maxBuckets], numVisited = 0;
+	for (int z = z0; z <= z1; z++) {
+		for (int y = y0; y <= y1; y++) {
+			for (int x = x0; x <= x1; x++) {
+				int b = bucket(x, y, z);
+				bool seen = false;
+				for (int v = 0; v < numVisited && !seen; v++) seen = visited[v] == b;
+				if (seen) continue;
+				visited[numVisited++] = b;
+
+				for (int k = start[b]; k < start[b + 1]; k++) {
+					glm::vec3 d = points[k] - p;
+					if (glm::dot(d, d) <= r2) f(ids[k]);
+				}
+			}
+		}
+	}
+}
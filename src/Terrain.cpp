@@ -0,0 +1,252 @@
+
+#include "Terrain.h"
+
+//  find the node at chunk level (or the leaf above it) containing p.  Points
+//  that fall in a gap between children go to the nearest child.
+//
+const TreeNode & Terrain::chunkNode(const glm::vec3 &p) const {
+	const TreeNode *node = &octree->root;
+	Vector3 v = p;
+	for (int level = 0; level < chunkLevel && node->children.size() > 0; level++) {
+		const TreeNode *next = NULL;
+		float best = FLT_MAX;
+		for (int i = 0; i < node->children.size(); i++) {
+			const Box &b = node->children[i].box;
+			if (b.inside(v)) {
+				next = &node->children[i];
+				break;
+			}
+			float d = (b.center() - v).length();
+			if (d < best) {
+				best = d;
+				next = &node->children[i];
+			}
+		}
+		node = next;
+	}
+	return *node;
+}
+
+//  split the mesh into chunks.  "octree" must have been built from "mesh";
+//  the positions are taken from the octree, so the mesh only has to supply
+//  indices, normals and texcoords.  Only the full resolution source of each
+//  chunk is kept, the meshes that are drawn get built as they are needed.
+//
+void Terrain::setup(const ofMesh &mesh, const Octree &tree, int level) {
+	octree = &tree;
+	chunkLevel = level;
+	chunks.clear();
+	nodeChunk.clear();
+	margin = 0;
+
+	// sort the triangles into chunks
+	//
+	int numVertices = tree.numPoints();
+	int numTriangles = mesh.hasIndices() ? mesh.getNumIndices() / 3 : numVertices / 3;
+	vector<vector<int>> chunkTriangles;
+	vector<int> owner(numVertices, -1);
+	vector<bool> shared(numVertices, false);
+	double edges = 0;
+	for (int t = 0; t < numTriangles; t++) {
+		int idx[3];
+		for (int k = 0; k < 3; k++)
+			idx[k] = mesh.hasIndices() ? mesh.getIndex(t * 3 + k) : t * 3 + k;
+		glm::vec3 a = tree.point(idx[0]);
+		glm::vec3 b = tree.point(idx[1]);
+		glm::vec3 c = tree.point(idx[2]);
+		edges += glm::length(b - a) + glm::length(c - b) + glm::length(a - c);
+
+		const TreeNode &node = chunkNode((a + b + c) / 3.0f);
+		auto it = nodeChunk.find(&node);
+		int chunk;
+		if (it == nodeChunk.end()) {
+			chunk = chunkTriangles.size();
+			nodeChunk[&node] = chunk;
+			chunkTriangles.push_back(vector<int>());
+		}
+		else chunk = it->second;
+
+		for (int k = 0; k < 3; k++) {
+			chunkTriangles[chunk].push_back(idx[k]);
+			if (owner[idx[k]] < 0) owner[idx[k]] = chunk;
+			else if (owner[idx[k]] != chunk) shared[idx[k]] = true;
+		}
+	}
+	if (numTriangles > 0)
+		cellSize = 2 * edges / (3 * numTriangles);
+
+	// copy each chunk's vertices into its source mesh
+	//
+	vector<int> remap(numVertices, -1);
+	chunks.resize(chunkTriangles.size());
+	for (auto &entry : nodeChunk) {
+		const TreeNode &node = *entry.first;
+		TerrainChunk &chunk = chunks[entry.second];
+		const vector<int> &indices = chunkTriangles[entry.second];
+
+		chunk.min = glm::vec3(FLT_MAX);
+		chunk.max = glm::vec3(-FLT_MAX);
+		vector<int> used;
+		for (int k = 0; k < indices.size(); k++) {
+			int i = indices[k];
+			if (remap[i] < 0) {
+				remap[i] = chunk.source.getNumVertices();
+				used.push_back(i);
+				glm::vec3 v = tree.point(i);
+				chunk.source.addVertex(v);
+				if (mesh.hasNormals()) chunk.source.addNormal(mesh.getNormals()[i]);
+				if (mesh.hasTexCoords()) chunk.source.addTexCoord(mesh.getTexCoords()[i]);
+				chunk.border.push_back(shared[i]);
+				chunk.min = glm::min(chunk.min, v);
+				chunk.max = glm::max(chunk.max, v);
+			}
+			chunk.source.addIndex(remap[i]);
+		}
+		for (int k = 0; k < used.size(); k++)
+			remap[used[k]] = -1;
+
+		chunk.lods.resize(numLods);
+		chunk.lastUsed.assign(numLods, -1);
+
+		// how far the triangles stick out of the node box
+		//
+		glm::vec3 over = glm::max(node.box.min().to<glm::vec3>() - chunk.min,
+			chunk.max - node.box.max().to<glm::vec3>());
+		margin = max(margin, max(over.x, max(over.y, over.z)));
+	}
+}
+
+//  chunk owned by an octree node, -1 if none
+//
+int Terrain::chunkAt(const TreeNode &node) const {
+	auto it = nodeChunk.find(&node);
+	return it == nodeChunk.end() ? -1 : it->second;
+}
+
+//  LOD level for the chunk's distance from the eye
+//
+int Terrain::selectLod(const TerrainChunk &chunk, const glm::vec3 &eye) const {
+	float dist = glm::distance(glm::clamp(eye, chunk.min, chunk.max), eye);
+	int level = 0;
+	for (float d = lodDistance; dist >= d && level < numLods - 1; d *= 2)
+		level++;
+	return level;
+}
+
+//  build one LOD mesh of a chunk by vertex clustering.  The grid is
+//  anchored at the world origin and vertices in the same cell are merged
+//  into their average; triangles that collapse are dropped.
+//
+void Terrain::buildLod(TerrainChunk &chunk, int level) {
+	const ofMesh &src = chunk.source;
+	ofVboMesh &mesh = chunk.lods[level];
+	mesh = ofVboMesh();
+	mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+	chunk.lastUsed[level] = frame;
+
+	if (level == 0) {
+		mesh.append(src);
+		return;
+	}
+
+	float cell = cellSize * (1 << (level - 1));
+	int n = src.getNumVertices();
+	vector<int> cluster(n);
+	vector<int> members;
+	std::unordered_map<int64_t, int> cells;
+	for (int i = 0; i < n; i++) {
+		int64_t key;
+		if (chunk.border[i])
+			key = -1 - (int64_t)i;      // border vertices stay where they are
+		else {
+			glm::vec3 v = src.getVertex(i) / cell;
+			int64_t x = (int64_t)floor(v.x) & 0x1fffff;
+			int64_t y = (int64_t)floor(v.y) & 0x1fffff;
+			int64_t z = (int64_t)floor(v.z) & 0x1fffff;
+			key = (x << 42) | (y << 21) | z;
+		}
+		auto it = cells.find(key);
+		if (it == cells.end()) {
+			cluster[i] = mesh.getNumVertices();
+			cells[key] = cluster[i];
+			members.push_back(0);
+			mesh.addVertex(glm::vec3(0));
+			if (src.hasNormals()) mesh.addNormal(glm::vec3(0));
+			if (src.hasTexCoords()) mesh.addTexCoord(glm::vec2(0));
+		}
+		else cluster[i] = it->second;
+
+		int c = cluster[i];
+		members[c]++;
+		mesh.getVertices()[c] += src.getVertex(i);
+		if (src.hasNormals()) mesh.getNormals()[c] += src.getNormals()[i];
+		if (src.hasTexCoords()) mesh.getTexCoords()[c] += src.getTexCoords()[i];
+	}
+	for (int c = 0; c < members.size(); c++) {
+		mesh.getVertices()[c] /= (float)members[c];
+		if (src.hasNormals()) mesh.getNormals()[c] = glm::normalize(mesh.getNormals()[c]);
+		if (src.hasTexCoords()) mesh.getTexCoords()[c] /= (float)members[c];
+	}
+
+	for (int t = 0; t + 2 < src.getNumIndices(); t += 3) {
+		int a = cluster[src.getIndex(t)];
+		int b = cluster[src.getIndex(t + 1)];
+		int c = cluster[src.getIndex(t + 2)];
+		if (a == b || b == c || c == a) continue;
+		mesh.addIndex(a);
+		mesh.addIndex(b);
+		mesh.addIndex(c);
+	}
+}
+
+//  release LOD meshes that haven't been drawn for keepFrames frames
+//
+void Terrain::releaseUnused() {
+	lodsResident = 0;
+	for (int i = 0; i < chunks.size(); i++) {
+		TerrainChunk &chunk = chunks[i];
+		for (int level = 0; level < chunk.lods.size(); level++) {
+			if (chunk.lastUsed[level] < 0) continue;
+			if (frame - chunk.lastUsed[level] > keepFrames) {
+				chunk.lods[level] = ofVboMesh();
+				chunk.lastUsed[level] = -1;
+			}
+			else lodsResident++;
+		}
+	}
+}
+
+//  draw the visible chunks, each at the level for its distance from the eye.
+//  Once this frame's build budget is spent a chunk is drawn at the closest
+//  level it already has.
+//
+void Terrain::draw(const vector<int> &visibleChunks, const glm::vec3 &eye) {
+	frame++;
+	builds = 0;
+	verticesDrawn = 0;
+	for (int i = 0; i < visibleChunks.size(); i++) {
+		TerrainChunk &chunk = chunks[visibleChunks[i]];
+		int want = selectLod(chunk, eye);
+		int level = -1;
+		if (chunk.lastUsed[want] >= 0) level = want;
+		else if (builds < maxBuildsPerFrame) {
+			buildLod(chunk, want);
+			builds++;
+			level = want;
+		}
+		else {
+			for (int d = 1; d < numLods && level < 0; d++) {
+				if (want + d < numLods && chunk.lastUsed[want + d] >= 0) level = want + d;
+				else if (want - d >= 0 && chunk.lastUsed[want - d] >= 0) level = want - d;
+			}
+			if (level < 0) {
+				buildLod(chunk, want);
+				level = want;
+			}
+		}
+		chunk.lastUsed[level] = frame;
+		chunk.lods[level].drawFaces();
+		verticesDrawn += chunk.lods[level].getNumVertices();
+	}
+	releaseUnused();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Octree.h"
+#include <unordered_map>
+
+//  Terrain mesh split into chunks along the octree, so that only the
+//  chunks in view need to be drawn.  Each octree node at chunkLevel (or a
+//  leaf above it) owns the triangles whose centroid falls inside it.
+//
+//  Every chunk can be drawn at numLods levels of detail.  Level 0 is the
+//  full resolution mesh, each level after it is simplified by clustering
+//  vertices on a grid twice as coarse as the one before.  Vertices shared
+//  with a neighbouring chunk are never clustered, so chunks drawn at
+//  different levels still meet without cracks.
+//
+//  LOD meshes are only built when a chunk is first drawn at that level
+//  (at most maxBuildsPerFrame a frame) and are released again when they
+//  haven't been drawn for keepFrames frames, so memory and vertex count
+//  follow what is in view rather than the size of the terrain.
+//
+struct TerrainChunk {
+	ofMesh source;              // full resolution triangles, CPU side only
+	vector<bool> border;        // source vertices shared with another chunk
+	vector<ofVboMesh> lods;     // built on demand
+	vector<int> lastUsed;       // frame each LOD was last drawn, -1 if not built
+	glm::vec3 min, max;         // bounds of the chunk's triangles
+};
+
+class Terrain {
+public:
+	void setup(const ofMesh &mesh, const Octree &octree, int chunkLevel);
+	void draw(const vector<int> &visibleChunks, const glm::vec3 &eye);
+	int chunkAt(const TreeNode &node) const;
+	int selectLod(const TerrainChunk &chunk, const glm::vec3 &eye) const;
+	void buildLod(TerrainChunk &chunk, int level);
+	void releaseUnused();
+
+	const Octree *octree = NULL;
+	int chunkLevel = 0;
+	float margin = 0;           // how far chunk triangles reach past their node box
+	vector<TerrainChunk> chunks;
+
+	int numLods = 4;
+	float lodDistance = 100;    // level n is used from lodDistance * 2^(n-1) on
+	float cellSize = 1;         // clustering grid of level 1, from the mesh's edge length
+	int maxBuildsPerFrame = 8;
+	int keepFrames = 300;
+
+	// stats from the last draw
+	//
+	int frame = 0;
+	int verticesDrawn = 0;
+	int lodsResident = 0;
+
+private:
+	const TreeNode & chunkNode(const glm::vec3 &p) const;
+	std::unordered_map<const TreeNode *, int> nodeChunk;
+	int builds = 0;
+};
@@ -0,0 +1,442 @@
+
+#include "TerrainTiles.h"
+#include "Util.h"
+#include "ObjLoader.h"
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+TerrainTiles::TerrainTiles() {
+}
+
+TerrainTiles::~TerrainTiles() {
+	if (loader.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+		loader.join();
+	}
+}
+
+//  rough memory held by an octree's nodes
+//
+static size_t nodeMemory(const TreeNode &node) {
+	size_t bytes = sizeof(TreeNode) + node.points.size() * sizeof(int);
+	for (int i = 0; i < node.children.size(); i++)
+		bytes += nodeMemory(node.children[i]);
+	return bytes;
+}
+
+//  build the octree and chunks of a tile.  The mesh's positions are moved
+//  into the octree (it is left without vertices), its indices, normals and
+//  texcoords are copied into the chunks.  With "reorder" the vertices are
+//  first put in octree leaf order.  The octree must not move after this,
+//  the chunks refer to its nodes - hence the unique_ptr.  The height field
+//  is rasterized from the triangles at the mesh's own grid spacing.
+//
+std::unique_ptr<TileData> TerrainTiles::makeTile(ofMesh &mesh, int octreeLevels, int chunkLevel, bool reorder) {
+	std::unique_ptr<TileData> data(new TileData());
+	data->octree = std::make_shared<Octree>();
+	auto points = std::make_shared<vector<glm::vec3>>();
+	points->swap(mesh.getVertices());
+	data->octree->create(points, octreeLevels);
+	data->heights = std::make_shared<HeightField>();
+	data->heights->build(*points, mesh.getIndices());
+	size_t vertices = points->size();
+	points.reset();         // so reorder() can permute the octree's points in place
+	if (reorder) {
+		vector<int> remap;
+		data->octree->reorder(remap);
+		remapVertices(mesh, remap);
+	}
+	data->terrain.setup(mesh, *data->octree, chunkLevel);
+
+	size_t sourceBytes = vertices * (sizeof(glm::vec3) * 2 + sizeof(glm::vec2)) + mesh.getNumIndices() * sizeof(ofIndexType);
+	data->memory = vertices * sizeof(glm::vec3) + sourceBytes + nodeMemory(data->octree->root)     // octree positions + chunk sources
+		+ data->heights->memory();
+	return data;
+}
+
+//  open a tile file and start the loader thread.  No tiles are loaded
+//  until update() asks for them.
+//
+bool TerrainTiles::open(const string &file) {
+	ifstream in(file, ios::binary);
+	if (!in) return false;
+
+	char magic[4];
+	uint32_t version, numTiles;
+	in.read(magic, 4);
+	in.read((char *)&version, 4);
+	in.read((char *)&numTiles, 4);
+	in.read((char *)&flags, 4);
+	if (!in || strncmp(magic, "TTIL", 4) != 0 || version != 1) {
+		cout << "TerrainTiles: not a tile file: " << file << endl;
+		return false;
+	}
+
+	tiles.resize(numTiles);
+	for (int i = 0; i < numTiles; i++) {
+		TerrainTile &t = tiles[i];
+		float b[6];
+		in.read((char *)b, sizeof(b));
+		in.read((char *)&t.offset, 8);
+		in.read((char *)&t.numVertices, 4);
+		in.read((char *)&t.numIndices, 4);
+		t.min = glm::vec3(b[0], b[1], b[2]);
+		t.max = glm::vec3(b[3], b[4], b[5]);
+	}
+	if (!in) {
+		cout << "TerrainTiles: truncated tile file: " << file << endl;
+		tiles.clear();
+		return false;
+	}
+
+	fileName = file;
+	cout << "terrain tiles: " << numTiles << endl;
+	loader = std::thread(&TerrainTiles::loaderThread, this);
+	return true;
+}
+
+//  add a whole mesh as one tile that is always resident.  Built right
+//  away on the calling thread.  Not for use with open().  Pass the mesh
+//  with std::move to avoid a copy.
+//
+void TerrainTiles::add(ofMesh mesh) {
+	TerrainTile t;
+	Box b = Octree::meshBounds(mesh);
+	t.min = b.min().to<glm::vec3>();
+	t.max = b.max().to<glm::vec3>();
+	t.numVertices = mesh.getNumVertices();
+	t.numIndices = mesh.getNumIndices();
+	t.pinned = true;
+	t.data = makeTile(mesh, octreeLevels, chunkLevel, reorderVertices);
+	memoryUsed += t.data->memory;
+	tiles.push_back(std::move(t));
+}
+
+//  read one tile from the file and build it.  Runs on the loader thread.
+//
+std::unique_ptr<TileData> TerrainTiles::load(ifstream &in, const TerrainTile &tile) const {
+	ofMesh mesh;
+	mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+	mesh.getVertices().resize(tile.numVertices);
+	mesh.getIndices().resize(tile.numIndices);
+
+	in.seekg(tile.offset);
+	in.read((char *)mesh.getVertices().data(), tile.numVertices * sizeof(glm::vec3));
+	if (flags & HasNormals) {
+		mesh.getNormals().resize(tile.numVertices);
+		in.read((char *)mesh.getNormals().data(), tile.numVertices * sizeof(glm::vec3));
+	}
+	vector<uint32_t> indices(tile.numIndices);
+	in.read((char *)indices.data(), tile.numIndices * sizeof(uint32_t));
+	if (!in) {
+		in.clear();
+		return NULL;
+	}
+	for (int i = 0; i < indices.size(); i++)
+		mesh.getIndices()[i] = indices[i];
+
+	return makeTile(mesh, octreeLevels, chunkLevel, reorderVertices);
+}
+
+//  load tiles from the front of the pending queue until told to quit
+//
+void TerrainTiles::loaderThread() {
+	ifstream in(fileName, ios::binary);
+	while (true) {
+		int tile;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return quit || !pending.empty(); });
+			if (quit) return;
+			tile = pending.front();
+			pending.pop_front();
+		}
+
+		// only the tile's place in the file is read here, which doesn't
+		// change after open()
+		//
+		Loaded result;
+		result.tile = tile;
+		result.data = load(in, tiles[tile]);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		loaded.push_back(std::move(result));
+	}
+}
+
+void TerrainTiles::release(int tile) {
+	TerrainTile &t = tiles[tile];
+	memoryUsed -= t.data->memory;
+	t.data.reset();
+}
+
+//  once a frame: install the tiles the loader finished, queue the tiles
+//  within loadRadius of focus (nearest first), and release least recently
+//  needed tiles while over the memory budget.
+//
+void TerrainTiles::update(const glm::vec3 &focus) {
+	frame++;
+
+	// tiles needed now, by distance
+	//
+	vector<pair<float, int>> needed;
+	for (int i = 0; i < tiles.size(); i++) {
+		TerrainTile &t = tiles[i];
+		glm::vec3 closest = glm::clamp(focus, t.min, t.max);
+		float dist = glm::length(glm::vec3(closest.x - focus.x, 0, closest.z - focus.z));
+		if (dist <= loadRadius || t.pinned) {
+			t.lastUsed = frame;
+			if (!t.data && !t.failed) needed.push_back(make_pair(dist, i));
+		}
+	}
+	sort(needed.begin(), needed.end());
+
+	vector<Loaded> done;
+	if (loader.joinable()) {
+		std::lock_guard<std::mutex> lock(mutex);
+		done.swap(loaded);
+
+		// requeue - tiles that dropped out of range are no longer wanted,
+		// the one being loaded right now still arrives
+		//
+		for (int i = 0; i < pending.size(); i++)
+			tiles[pending[i]].requested = false;
+		pending.clear();
+		// a tile that couldn't be read is given up on
+		//
+		for (int i = 0; i < done.size(); i++) {
+			TerrainTile &t = tiles[done[i].tile];
+			t.requested = false;
+			if (!done[i].data && !t.failed) {
+				t.failed = true;
+				cout << "TerrainTiles: can't read tile " << done[i].tile << ", leaving it out" << endl;
+			}
+		}
+		for (int i = 0; i < needed.size(); i++) {
+			TerrainTile &t = tiles[needed[i].second];
+			if (t.failed) continue;
+			bool inFlight = t.requested;
+			t.requested = true;
+			if (!inFlight) pending.push_back(needed[i].second);
+		}
+	}
+	if (!pending.empty()) wake.notify_one();
+
+	for (int i = 0; i < done.size(); i++) {
+		TerrainTile &t = tiles[done[i].tile];
+		if (t.data || !done[i].data) continue;
+		t.data = std::move(done[i].data);
+		memoryUsed += t.data->memory;
+	}
+
+	// least recently used first, never the ones needed this frame
+	//
+	while (memoryUsed > memoryBudget) {
+		int lru = -1;
+		for (int i = 0; i < tiles.size(); i++) {
+			const TerrainTile &t = tiles[i];
+			if (!t.data || t.pinned || t.lastUsed == frame) continue;
+			if (lru < 0 || t.lastUsed < tiles[lru].lastUsed) lru = i;
+		}
+		if (lru < 0) break;
+		release(lru);
+	}
+
+	tilesResident = 0;
+	for (int i = 0; i < tiles.size(); i++)
+		if (tiles[i].data) tilesResident++;
+	tilesPending = needed.size();
+}
+
+//  true if every tile under p (in x/z) is loaded or failed to load
+//
+bool TerrainTiles::ready(const glm::vec3 &p) const {
+	for (int i = 0; i < tiles.size(); i++) {
+		const TerrainTile &t = tiles[i];
+		if (p.x >= t.min.x && p.x <= t.max.x && p.z >= t.min.z && p.z <= t.max.z && !t.data && !t.failed)
+			return false;
+	}
+	return true;
+}
+
+//  octrees of the resident tiles
+//
+void TerrainTiles::octrees(vector<std::shared_ptr<const Octree>> &out) const {
+	out.clear();
+	for (int i = 0; i < tiles.size(); i++)
+		if (tiles[i].data) out.push_back(tiles[i].data->octree);
+}
+
+//  height fields of the resident tiles
+//
+void TerrainTiles::heightFields(vector<std::shared_ptr<const HeightField>> &out) const {
+	out.clear();
+	for (int i = 0; i < tiles.size(); i++)
+		if (tiles[i].data) out.push_back(tiles[i].data->heights);
+}
+
+//  pick a terrain point with a ray, nearest hit over all resident tiles
+//
+bool TerrainTiles::intersect(const Ray &ray, ofVec3f &point) const {
+	bool hit = false;
+	float best = FLT_MAX;
+	glm::vec3 origin = ray.origin.to<glm::vec3>();
+	for (int i = 0; i < tiles.size(); i++) {
+		if (!tiles[i].data) continue;
+		const Octree &octree = *tiles[i].data->octree;
+		const TreeNode *node = octree.intersect(ray);
+		if (!node)
+			continue;
+		const glm::vec3 &p = octree.point(octree.nodePoint(*node, 0));
+		float d = glm::distance(p, origin);
+		if (d < best) {
+			best = d;
+			point = p;
+			hit = true;
+		}
+	}
+	return hit;
+}
+
+//  leaf boxes of all resident tiles overlapping box
+//
+void TerrainTiles::intersect(const Box &box, vector<Box> &boxListRtn) const {
+	for (int i = 0; i < tiles.size(); i++) {
+		if (!tiles[i].data) continue;
+		const Octree &octree = *tiles[i].data->octree;
+		octree.intersect(box, octree.root, boxListRtn);
+	}
+}
+
+//  cull and draw the resident tiles
+//
+void TerrainTiles::draw(ViewCuller &culler, const glm::vec3 &eye) {
+	verticesDrawn = 0;
+	lodsResident = 0;
+	for (int i = 0; i < tiles.size(); i++) {
+		if (!tiles[i].data) continue;
+		Terrain &terrain = tiles[i].data->terrain;
+		if (culler.visible(tiles[i].min, tiles[i].max)) {
+			culler.cull(terrain, visibleChunks);
+			terrain.draw(visibleChunks, eye);
+		}
+		else {
+			visibleChunks.clear();
+			terrain.draw(visibleChunks, eye);     // still ages out its unused LODs
+		}
+		verticesDrawn += terrain.verticesDrawn;
+		lodsResident += terrain.lodsResident;
+	}
+}
+
+//  cut a mesh into tileSize x tileSize tiles in x/z and write the tile
+//  file.  Triangles go to the tile their centroid is in; vertices on tile
+//  edges are stored in each tile using them.  Vertex normals are computed
+//  if the mesh has none.
+//
+bool TerrainTiles::build(const ofMesh &src, float tileSize, const string &file) {
+	ofMesh mesh = src;
+	if (!mesh.hasNormals())
+		computeVertexNormals(mesh);
+
+	// sort triangles into tiles
+	//
+	Box b = Octree::meshBounds(mesh);
+	float x0 = b.min().x(), z0 = b.min().z();
+	int nx = max(1, (int)ceil((b.max().x() - x0) / tileSize));
+	int nz = max(1, (int)ceil((b.max().z() - z0) / tileSize));
+	vector<vector<int>> tileTriangles(nx * nz);
+	for (int t = 0; t + 2 < mesh.getNumIndices(); t += 3) {
+		glm::vec3 c = (mesh.getVertex(mesh.getIndex(t)) + mesh.getVertex(mesh.getIndex(t + 1))
+			+ mesh.getVertex(mesh.getIndex(t + 2))) / 3.0f;
+		int tx = ofClamp((int)((c.x - x0) / tileSize), 0, nx - 1);
+		int tz = ofClamp((int)((c.z - z0) / tileSize), 0, nz - 1);
+		tileTriangles[tz * nx + tx].push_back(t);
+	}
+
+	vector<vector<int>> used;   // source vertex of each tile vertex
+	vector<vector<uint32_t>> indices;
+	vector<int> remap(mesh.getNumVertices(), -1);
+	for (int i = 0; i < tileTriangles.size(); i++) {
+		if (tileTriangles[i].empty()) continue;
+		used.push_back(vector<int>());
+		indices.push_back(vector<uint32_t>());
+		for (int k = 0; k < tileTriangles[i].size(); k++) {
+			for (int j = 0; j < 3; j++) {
+				int v = mesh.getIndex(tileTriangles[i][k] + j);
+				if (remap[v] < 0) {
+					remap[v] = used.back().size();
+					used.back().push_back(v);
+				}
+				indices.back().push_back(remap[v]);
+			}
+		}
+		for (int k = 0; k < used.back().size(); k++)
+			remap[used.back()[k]] = -1;
+	}
+
+	ofstream out(file, ios::binary);
+	if (!out) return false;
+	uint32_t numTiles = used.size();
+	uint32_t version = 1, fileFlags = HasNormals;
+	out.write("TTIL", 4);
+	out.write((const char *)&version, 4);
+	out.write((const char *)&numTiles, 4);
+	out.write((const char *)&fileFlags, 4);
+
+	uint64_t offset = 16 + (uint64_t)numTiles * (6 * sizeof(float) + 8 + 4 + 4);
+	for (int i = 0; i < numTiles; i++) {
+		glm::vec3 tmin(FLT_MAX), tmax(-FLT_MAX);
+		for (int k = 0; k < used[i].size(); k++) {
+			tmin = glm::min(tmin, mesh.getVertex(used[i][k]));
+			tmax = glm::max(tmax, mesh.getVertex(used[i][k]));
+		}
+		float bounds[6] = { tmin.x, tmin.y, tmin.z, tmax.x, tmax.y, tmax.z };
+		uint32_t numVertices = used[i].size();
+		uint32_t numIndices = indices[i].size();
+		out.write((const char *)bounds, sizeof(bounds));
+		out.write((const char *)&offset, 8);
+		out.write((const char *)&numVertices, 4);
+		out.write((const char *)&numIndices, 4);
+		offset += numVertices * 2 * sizeof(glm::vec3) + numIndices * sizeof(uint32_t);
+	}
+	for (int i = 0; i < numTiles; i++) {
+		for (int k = 0; k < used[i].size(); k++)
+			out.write((const char *)&mesh.getVertices()[used[i][k]], sizeof(glm::vec3));
+		for (int k = 0; k < used[i].size(); k++)
+			out.write((const char *)&mesh.getNormals()[used[i][k]], sizeof(glm::vec3));
+		out.write((const char *)indices[i].data(), indices[i].size() * sizeof(uint32_t));
+	}
+	cout << "wrote " << numTiles << " tiles (" << nx << " x " << nz << " grid) to " << file << endl;
+	return (bool)out;
+}
+
+//  command line entry point for --tile
+//
+int TerrainTiles::main(int argc, char *argv[]) {
+	if (argc < 4) {
+		cout << "usage: --tile terrain.obj terrain.tiles [--tile-size S]" << endl;
+		return 1;
+	}
+	float tileSize = 100;
+	for (int i = 4; i + 1 < argc; i += 2) {
+		string opt = argv[i];
+		if (opt == "--tile-size") tileSize = atof(argv[i + 1]);
+		else {
+			cout << "unknown option: " << opt << endl;
+			return 1;
+		}
+	}
+
+	ofMesh mesh;
+	if (!ObjLoader::load(argv[2], mesh)) {
+		cout << "can't load terrain: " << argv[2] << endl;
+		return 1;
+	}
+	return build(mesh, tileSize, argv[3]) ? 0 : 1;
+}
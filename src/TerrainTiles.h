@@ -0,0 +1,120 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Octree.h"
+#include "Terrain.h"
+#include "Culling.h"
+#include "HeightField.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+
+//  Out of core terrain.  The terrain is cut into square tiles in x/z and
+//  stored in one tile file; only the tiles within loadRadius of the lander
+//  are kept in memory.  A background thread reads the tiles that are
+//  needed, nearest first, and builds each tile's octree and chunks off the
+//  main thread.  Finished tiles are picked up by update(), and tiles that
+//  are no longer needed are released least recently used first once the
+//  memory budget is exceeded.
+//
+//  Tile file layout (little endian):
+//
+//      "TTIL"  uint32 version  uint32 numTiles  uint32 flags
+//      numTiles x { float min[3], max[3]  uint64 offset  uint32 numVertices, numIndices }
+//      per tile:  positions (float3 x numVertices), normals (float3 x numVertices)
+//                 if flags & HasNormals, then indices (uint32 x numIndices)
+//
+//  A tile file is made from an .obj from the command line:
+//
+//      <app> --tile terrain.obj terrain.tiles [--tile-size S]
+//
+//  Without a tile file the whole terrain can be added as one tile that is
+//  always resident (add()).
+//
+
+//  Octree, height field and chunks of one resident tile.  The octree and
+//  height field are shared, so the simulation (on its own thread) can go on
+//  using them after the tile has been released; the chunks hold GL buffers
+//  and stay with the tile.
+//
+struct TileData {
+	std::shared_ptr<Octree> octree;
+	std::shared_ptr<HeightField> heights;
+	Terrain terrain;
+	size_t memory = 0;      // rough bytes used
+};
+
+struct TerrainTile {
+	glm::vec3 min, max;
+	uint64_t offset = 0;
+	uint32_t numVertices = 0;
+	uint32_t numIndices = 0;
+
+	std::unique_ptr<TileData> data;     // NULL when not loaded
+	bool requested = false;             // waiting for or being loaded
+	bool failed = false;                // couldn't be read; not asked for again
+	bool pinned = false;                // never released
+	int lastUsed = -1;                  // frame it was last needed
+};
+
+class TerrainTiles {
+public:
+	TerrainTiles();
+	~TerrainTiles();
+
+	bool open(const string &file);
+	void add(ofMesh mesh);
+	void update(const glm::vec3 &focus);
+	bool ready(const glm::vec3 &p) const;
+	void octrees(vector<std::shared_ptr<const Octree>> &out) const;
+	void heightFields(vector<std::shared_ptr<const HeightField>> &out) const;
+	bool intersect(const Ray &ray, ofVec3f &point) const;
+	void intersect(const Box &box, vector<Box> &boxListRtn) const;
+	void draw(ViewCuller &culler, const glm::vec3 &eye);
+
+	static bool build(const ofMesh &mesh, float tileSize, const string &file);
+	static int main(int argc, char *argv[]);
+
+	enum { HasNormals = 1 };
+
+	vector<TerrainTile> tiles;
+	float loadRadius = 600;             // x/z distance from the focus to keep tiles loaded
+	size_t memoryBudget = (size_t)1 << 30;
+	int octreeLevels = 20;
+	int chunkLevel = 2;
+	bool reorderVertices = true;        // store vertices in octree leaf order (Octree::reorder())
+
+	// stats
+	//
+	size_t memoryUsed = 0;
+	int tilesResident = 0;
+	int tilesPending = 0;
+	int verticesDrawn = 0;
+	int lodsResident = 0;
+
+private:
+	struct Loaded {
+		int tile;
+		std::unique_ptr<TileData> data;
+	};
+
+	void loaderThread();
+	std::unique_ptr<TileData> load(std::ifstream &in, const TerrainTile &tile) const;
+	static std::unique_ptr<TileData> makeTile(ofMesh &mesh, int octreeLevels, int chunkLevel, bool reorder);
+	void release(int tile);
+
+	string fileName;
+	uint32_t flags = 0;
+	int frame = 0;
+
+	std::thread loader;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<int> pending;            // tiles to load, nearest first
+	vector<Loaded> loaded;              // finished, waiting for update()
+	bool quit = false;
+
+	vector<int> visibleChunks;
+};
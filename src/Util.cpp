@@ -2,6 +2,7 @@
 // Kevin M.Smith - CS 134 SJSU
 
 #include "Util.h"
+#include "Random.h"
 
 
 
@@ -35,4 +36,96 @@ bool rayIntersectPlane(const ofVec3f &rayPoint, const ofVec3f &raydir, const ofV
 //
 ofVec3f reflectVector(const ofVec3f &v, const ofVec3f &n) {
 	return (v - 2 * v.dot(n) * n);
-}
\ No newline at end of file
+}
+
+// Smooth vertex normals for a triangle mesh that has none - the area
+// weighted average of the normals of the faces around each vertex.
+//
+void computeVertexNormals(ofMesh &mesh) {
+	vector<glm::vec3> &normals = mesh.getNormals();
+	normals.assign(mesh.getNumVertices(), glm::vec3(0));
+	for (int t = 0; t + 2 < mesh.getNumIndices(); t += 3) {
+		int a = mesh.getIndex(t), b = mesh.getIndex(t + 1), c = mesh.getIndex(t + 2);
+		glm::vec3 n = glm::cross(mesh.getVertex(b) - mesh.getVertex(a), mesh.getVertex(c) - mesh.getVertex(a));
+		normals[a] += n;
+		normals[b] += n;
+		normals[c] += n;
+	}
+	for (int i = 0; i < normals.size(); i++)
+		if (glm::length(normals[i]) > 0) normals[i] = glm::normalize(normals[i]);
+}
+
+// Renumber the vertices of an indexed mesh - vertex i moves to remap[i].  Attributes
+// the mesh doesn't have (or no longer has) are skipped, indices are
+// rewritten.
+//
+void remapVertices(ofMesh &mesh, const vector<int> &remap) {
+	vector<glm::vec3> &vertices = mesh.getVertices();
+	if (vertices.size() == remap.size()) {
+		vector<glm::vec3> v(vertices.size());
+		for (int i = 0; i < remap.size(); i++) v[remap[i]] = vertices[i];
+		vertices.swap(v);
+	}
+	vector<glm::vec3> &normals = mesh.getNormals();
+	if (normals.size() == remap.size()) {
+		vector<glm::vec3> n(normals.size());
+		for (int i = 0; i < remap.size(); i++) n[remap[i]] = normals[i];
+		normals.swap(n);
+	}
+	vector<glm::vec2> &texCoords = mesh.getTexCoords();
+	if (texCoords.size() == remap.size()) {
+		vector<glm::vec2> t(texCoords.size());
+		for (int i = 0; i < remap.size(); i++) t[remap[i]] = texCoords[i];
+		texCoords.swap(t);
+	}
+	vector<ofIndexType> &indices = mesh.getIndices();
+	for (int i = 0; i < indices.size(); i++)
+		indices[i] = remap[indices[i]];
+}
+
+// Synthetic terrain for benchmarks: a size x size grid of vertices spanning
+// "extent" in x and z, centered on the origin, with heights up to "height"
+// from four octaves of value noise.  The same seed gives the same terrain.
+//
+ofMesh makeTerrainMesh(int size, float extent, float height, uint64_t seed) {
+	Rng rng(seed);
+	size = max(size, 2);
+	vector<float> heights(size * size, 0);
+	float amplitude = 0.5;
+	for (int octave = 0, cells = 4; octave < 4; octave++, cells *= 2, amplitude /= 2) {
+		vector<float> lattice((cells + 1) * (cells + 1));
+		for (int i = 0; i < lattice.size(); i++) lattice[i] = rng.uniform();
+		for (int z = 0; z < size; z++) {
+			for (int x = 0; x < size; x++) {
+				float fx = x * cells / (float)(size - 1), fz = z * cells / (float)(size - 1);
+				int cx = min((int)fx, cells - 1), cz = min((int)fz, cells - 1);
+				float tx = fx - cx, tz = fz - cz;
+				tx = tx * tx * (3 - 2 * tx);
+				tz = tz * tz * (3 - 2 * tz);
+				const float *row0 = &lattice[cz * (cells + 1) + cx];
+				const float *row1 = row0 + cells + 1;
+				float h = ofLerp(ofLerp(row0[0], row0[1], tx), ofLerp(row1[0], row1[1], tx), tz);
+				heights[z * size + x] += h * amplitude;
+			}
+		}
+	}
+
+	ofMesh mesh;
+	mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+	vector<glm::vec3> &vertices = mesh.getVertices();
+	vertices.resize(size * size);
+	float step = extent / (size - 1);
+	for (int z = 0; z < size; z++)
+		for (int x = 0; x < size; x++)
+			vertices[z * size + x] = glm::vec3(x * step - extent / 2, heights[z * size + x] * height, z * step - extent / 2);
+	vector<ofIndexType> &indices = mesh.getIndices();
+	indices.reserve((size - 1) * (size - 1) * 6);
+	for (int z = 0; z + 1 < size; z++) {
+		for (int x = 0; x + 1 < size; x++) {
+			ofIndexType i = z * size + x;
+			indices.insert(indices.end(), { i, i + size, i + 1, i + 1, i + size, i + size + 1 });
+		}
+	}
+	computeVertexNormals(mesh);
+	return mesh;
+}
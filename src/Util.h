@@ -8,5 +8,9 @@ bool rayIntersectPlane(const ofVec3f &rayPoint, const ofVec3f &raydir, ofVec3f c
 
 ofVec3f reflectVector(const ofVec3f &v, const ofVec3f &normal);
 
+void computeVertexNormals(ofMesh &mesh);
+void remapVertices(ofMesh &mesh, const vector<int> &remap);
+ofMesh makeTerrainMesh(int size, float extent, float height, uint64_t seed);
+
 
 
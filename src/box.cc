@@ -1,6 +1,7 @@
 #include "vector3.h"
 #include "ray.h"
 #include "box.h"
+#include <cmath>
   
 /*
  * Ray-box intersection using IEEE numerical properties to ensure that the
@@ -12,21 +13,31 @@
  *
  */
 
-bool Box::intersect(const Ray &r, float t0, float t1) const {
+/*
+ * A ray parallel to a slab that starts on one of its planes gives 0 * inf,
+ * NaN, for that plane.  The ray lies in the plane, so it is taken to be
+ * inside the slab (borders included, as in inside()): a NaN near distance
+ * counts as -inf and a NaN far distance as +inf.  The SSE version and the
+ * GeomBatch kernels do the same.
+ */
+static inline float nearT(float t) { return t == t ? t : -INFINITY; }
+static inline float farT(float t) { return t == t ? t : INFINITY; }
+
+bool Box::intersectScalar(const Ray &r, float t0, float t1) const {
   float tmin, tmax, tymin, tymax, tzmin, tzmax;
 
-  tmin = (parameters[r.sign[0]].x() - r.origin.x()) * r.inv_direction.x();
-  tmax = (parameters[1-r.sign[0]].x() - r.origin.x()) * r.inv_direction.x();
-  tymin = (parameters[r.sign[1]].y() - r.origin.y()) * r.inv_direction.y();
-  tymax = (parameters[1-r.sign[1]].y() - r.origin.y()) * r.inv_direction.y();
+  tmin = nearT((parameters[r.sign[0]].x() - r.origin.x()) * r.inv_direction.x());
+  tmax = farT((parameters[1-r.sign[0]].x() - r.origin.x()) * r.inv_direction.x());
+  tymin = nearT((parameters[r.sign[1]].y() - r.origin.y()) * r.inv_direction.y());
+  tymax = farT((parameters[1-r.sign[1]].y() - r.origin.y()) * r.inv_direction.y());
   if ( (tmin > tymax) || (tymin > tmax) ) 
     return false;
   if (tymin > tmin)
     tmin = tymin;
   if (tymax < tmax)
     tmax = tymax;
-  tzmin = (parameters[r.sign[2]].z() - r.origin.z()) * r.inv_direction.z();
-  tzmax = (parameters[1-r.sign[2]].z() - r.origin.z()) * r.inv_direction.z();
+  tzmin = nearT((parameters[r.sign[2]].z() - r.origin.z()) * r.inv_direction.z());
+  tzmax = farT((parameters[1-r.sign[2]].z() - r.origin.z()) * r.inv_direction.z());
   if ( (tmin > tzmax) || (tzmin > tmax) ) 
     return false;
   if (tzmin > tmin)
@@ -35,3 +46,40 @@ bool Box::intersect(const Ray &r, float t0, float t1) const {
     tmax = tzmax;
   return ( (tmin < t1) && (tmax > t0) );
 }
+
+/*
+ * The same test on all three slabs at once.  The near and far planes of
+ * each slab are picked by the sign of the ray direction, as above; the ray
+ * misses if the largest near distance is past the smallest far distance.
+ * max / min with -inf / +inf turn NaN distances into those (they return
+ * the second operand if either is NaN).
+ */
+
+#ifdef VECTOR3_USE_SSE
+static inline float max3(__m128 v) {
+  __m128 m = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+  return _mm_cvtss_f32(_mm_max_ps(m, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+
+static inline float min3(__m128 v) {
+  __m128 m = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+  return _mm_cvtss_f32(_mm_min_ps(m, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+
+bool Box::intersect(const Ray &r, float t0, float t1) const {
+  __m128 o = r.origin.m128();
+  __m128 inv = r.inv_direction.m128();
+  __m128 ta = _mm_mul_ps(_mm_sub_ps(parameters[0].m128(), o), inv);
+  __m128 tb = _mm_mul_ps(_mm_sub_ps(parameters[1].m128(), o), inv);
+  __m128 neg = _mm_cmplt_ps(inv, _mm_setzero_ps());
+  __m128 tnear = _mm_max_ps(_mm_or_ps(_mm_and_ps(neg, tb), _mm_andnot_ps(neg, ta)), _mm_set1_ps(-INFINITY));
+  __m128 tfar = _mm_min_ps(_mm_or_ps(_mm_and_ps(neg, ta), _mm_andnot_ps(neg, tb)), _mm_set1_ps(INFINITY));
+  float tmin = max3(tnear);
+  float tmax = min3(tfar);
+  return ( (tmin <= tmax) && (tmin < t1) && (tmax > t0) );
+}
+#else
+bool Box::intersect(const Ray &r, float t0, float t1) const {
+  return intersectScalar(r, t0, t1);
+}
+#endif
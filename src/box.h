@@ -13,6 +13,10 @@
  *      "An Efficient and Robust Ray-Box Intersection Algorithm"
  *      Journal of graphics tools, 10(1):49-54, 2005
  *
+ * inside(), overlap() and intersect() test all three axes at once with SSE
+ * when it is available; the ...Scalar() versions are the plain per axis
+ * tests, kept as the fallback and for the benchmarks (--bench math).
+ * Both take a ray that lies in a face's plane to hit the box.
  */
 
 class Box {
@@ -25,18 +29,28 @@ class Box {
     }
     // (t0, t1) is the interval for valid hits
     bool intersect(const Ray &, float t0, float t1) const;
+    bool intersectScalar(const Ray &, float t0, float t1) const;
 
     // corners
     Vector3 parameters[2];
 
-	Vector3 min() { return parameters[0]; }
-	Vector3 max() { return parameters[1]; }
-	const bool inside(const Vector3 &p) {
+	Vector3 min() const { return parameters[0]; }
+	Vector3 max() const { return parameters[1]; }
+	bool inside(const Vector3 &p) const {
+#ifdef VECTOR3_USE_SSE
+		__m128 v = p.m128();
+		__m128 in = _mm_and_ps(_mm_cmpge_ps(v, parameters[0].m128()), _mm_cmple_ps(v, parameters[1].m128()));
+		return (_mm_movemask_ps(in) & 7) == 7;
+#else
+		return insideScalar(p);
+#endif
+	}
+	bool insideScalar(const Vector3 &p) const {
 		return ((p.x() >= parameters[0].x() && p.x() <= parameters[1].x()) &&
 		     	(p.y() >= parameters[0].y() && p.y() <= parameters[1].y()) &&
 			    (p.z() >= parameters[0].z() && p.z() <= parameters[1].z()));
 	}
-	const bool inside(Vector3 *points, int size) {
+	bool inside(const Vector3 *points, int size) const {
 		bool allInside = true;
 		for (int i = 0; i < size; i++) {
 			if (!inside(points[i])) allInside = false;
@@ -47,7 +61,16 @@ class Box {
 
 	// implement for Homework Project
 	//
-	bool overlap(const Box &box) {
+	bool overlap(const Box &box) const {
+#ifdef VECTOR3_USE_SSE
+		__m128 apart = _mm_or_ps(_mm_cmplt_ps(parameters[1].m128(), box.parameters[0].m128()),
+			_mm_cmplt_ps(box.parameters[1].m128(), parameters[0].m128()));
+		return (_mm_movemask_ps(apart) & 7) == 0;
+#else
+		return overlapScalar(box);
+#endif
+	}
+	bool overlapScalar(const Box &box) const {
 		if ((parameters[1].x() < box.parameters[0].x() || box.parameters[1].x() < parameters[0].x())
 			|| (parameters[1].y() < box.parameters[0].y() || box.parameters[1].y() < parameters[0].y())
 			|| (parameters[1].z() < box.parameters[0].z() || box.parameters[1].z() < parameters[0].z()))
@@ -55,9 +78,11 @@ class Box {
 		return true;
 	}
 
-	Vector3 center() {
+	Vector3 center() const {
 		return ((max() - min()) / 2 + min());
 	}
 };
 
+static_assert(std::is_trivially_copyable<Box>::value, "Box must stay trivially copyable");
+
 #endif // _BOX_H_
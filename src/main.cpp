@@ -1,8 +1,39 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "BatchRunner.h"
+#include "TerrainTiles.h"
+#include "Benchmark.h"
+#include "Replay.h"
+#include "Autopilot.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char *argv[]){
+
+	// headless batch mode - runs the simulation only, no window or GL context
+	//
+	if (argc > 1 && string(argv[1]) == "--batch")
+		return BatchRunner::main(argc, argv);
+
+	// convert a terrain .obj to a tile file for streaming
+	//
+	if (argc > 1 && string(argv[1]) == "--tile")
+		return TerrainTiles::main(argc, argv);
+
+	// replay a recorded game headless, and check it comes out the same
+	//
+	if (argc > 1 && string(argv[1]) == "--replay")
+		return Replay::main(argc, argv);
+
+	// fly landings with the autopilot, headless
+	//
+	if (argc > 1 && string(argv[1]) == "--autopilot")
+		return Autopilot::main(argc, argv);
+
+	// benchmarks
+	//
+	if (argc > 1 && string(argv[1]) == "--bench")
+		return Benchmark::main(argc, argv);
+
 	ofSetupOpenGL(1280, 1024,OF_WINDOW);			// <-------- setup the GL context
 
 	// this kicks off the running of my app
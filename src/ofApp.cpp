@@ -6,6 +6,8 @@
 
 #include "ofApp.h"
 #include "Util.h"
+#include "Random.h"
+#include "ObjLoader.h"
 #include "glm/gtx/intersect.hpp"
 
 //--------------------------------------------------------------
@@ -34,20 +36,41 @@ void ofApp::setup() {
 	//
 	initLightingAndMaterials();
 
-	// Load terrain
-	moon.loadModel("geo/moonTerrain_size2.obj");
-	moon.setScaleNormalization(false);
+	// Load terrain - streamed in the background from the tile file if there
+	// is one, otherwise the whole .obj is loaded now
+	//
+	terrainFile = ofToDataPath("geo/moonTerrain.tiles");
+	if (!terrainTiles.open(terrainFile)) {
+		terrainFile = ofToDataPath("geo/moonTerrain_size2.obj");
+		ofMesh moon;
+		if (!ObjLoader::loadCached(terrainFile, moon)) {
+			cout << "can't load terrain: geo/moonTerrain_size2.obj" << endl;
+			ofExit();
+		}
+		cout << "vertices: " << moon.getNumVertices() << endl;
+		if (!moon.hasNormals())
+			computeVertexNormals(moon);
+
+		//  Octree and chunks for view culling and LOD along octree level 2.
+		//  Smaller chunks cull tighter, but their shared borders can't be
+		//  simplified, so LOD saves less.
+		//
+		terrainTiles.chunkLevel = 2;
+		terrainTiles.add(std::move(moon));
+	}
 
 	// Load lander
 	lander.loadModel("geo/ufo.obj");
 	lander.setScaleNormalization(false);
 	bLanderLoaded = true;
 	lander.setPosition(0, 50, 0);
-	landerPos = glm::vec3(0, 50, 0);
+	prevLanderPos = glm::vec3(0, 50, 0);
 
-	//  Create Octree
+	// Physics runs in fixed steps of 1/60 sec (what the game is tuned for)
+	// independent of the render rate, catching up at most 8 steps a frame
 	//
-	octree.create(moon.getMesh(0), 20);
+	clock.setStepRate(60);
+	clock.setMaxSubsteps(8);
 
 	// load textures
 	//
@@ -74,14 +97,9 @@ void ofApp::setup() {
 	shader.load("shaders/shader");
 #endif
 
-	// Setup fuel
-	fuelLevel = 120; // Fuel level (120 seconds, 2 minutes)
-	initialFuel = 120;
-	usedFuel = 0;
 
 	// Initalize game state
 	gameState = false;
-	gameOver = false;
 
 	// Set landing areas
 	landing = glm::vec3(-100, 75, 30);
@@ -107,8 +125,7 @@ void ofApp::setup() {
 	thrustEmitter.setLifespanRange(ofVec2f(0, 0.5));
 	thrustEmitter.setParticleRadius(10);
 	thrustEmitter.setCircularEmitterRadius(1);
-
-	thrust = false;
+	thrustEmitter.sys->ground = &simGround;
 
 	explosionEmitter.sys->addForce(turbForce);
 	explosionEmitter.sys->addForce(gravityForce);
@@ -121,8 +138,10 @@ void ofApp::setup() {
 	explosionEmitter.setRandomLife(true);
 	explosionEmitter.setLifespanRange(ofVec2f(2, 4));
 	explosionEmitter.setParticleRadius(20);
+	explosionEmitter.sys->ground = &simGround;
+	explosionEmitter.sys->neighbourRadius = 0.5;    // debris spreads out as it settles
+	explosionEmitter.sys->repulsion = 5;
 
-	explosion = false;
 
 	vortexRingEmitter.sys->addForce(turbForce);
 	vortexRingEmitter.sys->addForce(gravityForce);
@@ -135,6 +154,7 @@ void ofApp::setup() {
 	vortexRingEmitter.setRandomLife(true);
 	vortexRingEmitter.setLifespanRange(ofVec2f(0, 0.5));
 	vortexRingEmitter.setParticleRadius(10);
+	vortexRingEmitter.sys->ground = &simGround;
 
 	vortexRing = false;
 
@@ -158,6 +178,16 @@ void ofApp::setup() {
 	landingRingEmitter2.start();
 	landingRingEmitter3.start();
 
+	// Register emitters for drawing, each with its particle color.  All
+	// particles are streamed through one buffer and drawn with one call.
+	particleBatch.add(&thrustEmitter, ofColor(230, 153, 255));
+	particleBatch.add(&explosionEmitter, ofColor(255, 166, 77));
+	particleBatch.add(&vortexRingEmitter, ofColor(230, 230, 230));
+	particleBatch.add(&landingRingEmitter, ofColor(133, 224, 133));
+	particleBatch.add(&landingRingEmitter2, ofColor(133, 224, 133));
+	particleBatch.add(&landingRingEmitter3, ofColor(133, 224, 133));
+	particleRenderer.setup(20000);
+
 	//spotlights for the 3 landing zones
 	ofEnableLighting();
 
@@ -201,7 +231,7 @@ void ofApp::setup() {
 	// Lander light
 	landerLight.setDiffuseColor(ofColor::white);
 	landerLight.setSpecularColor(ofFloatColor(1.0, 1.0, 1.0) * 2.0);
-	landerLight.setPosition(landerPos);
+	landerLight.setPosition(prevLanderPos);
 	landerLight.setSpotlight();
 	landerLight.setSpotlightCutOff(55);
 	landerLight.setSpotConcentration(20);
@@ -216,53 +246,36 @@ void ofApp::setup() {
 	glm::vec3 landerPos = lander.getPosition();
 	cam.setPosition(landerPos.x, landerPos.y + 20, landerPos.z + 45);
 	cam.lookAt(landerPos);
-}
 
-// Check if in spotlight
-//
-// Jessica Fung
-//
-bool ofApp::inSpotlight(ofLight& spotlight, glm::vec3 landerPos, float angle, float radius) {
-	glm::vec3 spotlightPos = spotlight.getPosition();
-	glm::vec3 spotlightDir = glm::normalize(spotlight.getLookAtDir());
-	glm::vec3 toLander = glm::normalize(landerPos - spotlightPos);
-
-	float distance = glm::length(glm::vec3(toLander.x, toLander.y, toLander.z));
-	if (distance > radius) {
-		return false;
-	}
-	float delta = glm::degrees(glm::acos(glm::dot(spotlightDir, glm::normalize(toLander))));
-	return delta <= angle;
+	// Lander simulation - uses the resident terrain octrees (set each frame),
+	// lander bounds come from the model, landing zones from the spotlights
+	//
+	sim.setup(NULL, lander.getSceneMin(), lander.getSceneMax());
+	sim.gravity = gravityForce->get();
+	sim.turbMin = turbForce->getMin();
+	sim.turbMax = turbForce->getMax();
+	sim.zones.clear();
+	ofLight *zoneLights[] = { &spotlight2, &spotlight3, &spotlight4 };
+	for (int i = 0; i < 3; i++)
+		sim.zones.push_back({ zoneLights[i]->getPosition(), zoneLights[i]->getLookAtDir(), 45, 20 });
+	sim.reset(landerPos);
+	prevLanderPos = sim.pos;
+	prevLanderRot = sim.rot;
+
+	// Everything the simulation uses is set up - from here on it belongs
+	// to the simulation thread
+	//
+	publishSnapshot();
+	snapshots.update();
+	latest = &snapshots.front();
+	simThread = std::thread(&ofApp::simulationLoop, this);
 }
 
-// Check collision position
-//
-// Jessica Fung
-//
-void ofApp::checkCollisionPosition(glm::vec3 landerPos) {
-	float spotlightRadius = 20.0f;
-	inLight = false;
-	gameEnd = false;
-
-	if (inSpotlight(spotlight2, landerPos, 45, spotlightRadius)) {
-		cout << "lander in spotlight 2" << endl;
-		inLight = true;
-	}
-	if (inSpotlight(spotlight3, landerPos, 45, spotlightRadius)) {
-		cout << "lander in spotlight 3" << endl;
-		inLight = true;
-	}
-	if (inSpotlight(spotlight4, landerPos, 45, spotlightRadius)) {
-		cout << "lander in spotlight 4" << endl;
-		inLight = true;
-	}
-
-	if (inLight) {
-		gameComplete = true;
-	} else {
-		gameEnd = true;
-		cout << "not in light" << endl;
-	}
+//--------------------------------------------------------------
+void ofApp::exit() {
+	simQuit = true;
+	if (simThread.joinable())
+		simThread.join();
 }
 
 // Set up landing ring emitter with default values
@@ -283,145 +296,19 @@ void ofApp::setupLandingRingEmitter(ParticleEmitter& emitter, glm::vec3 pos, glm
 	emitter.setPosition(pos);
 }
 
-// load vertex buffer in preparation for rendering
-//
-// Lee Rogers
-//
-void ofApp::loadThrustVbo() {
-	if (thrustEmitter.sys->particles.size() < 1) return;
-
-	vector<ofVec3f> sizes;
-	vector<ofVec3f> points;
-	for (int i = 0; i < thrustEmitter.sys->particles.size(); i++) {
-		points.push_back(thrustEmitter.sys->particles[i].position);
-		sizes.push_back(ofVec3f(thrustEmitter.particleRadius));
-	}
-	// upload the data to the vbo
-	//
-	int total = (int)points.size();
-	thrustVbo.clear();
-	thrustVbo.setVertexData(&points[0], total, GL_STATIC_DRAW);
-	thrustVbo.setNormalData(&sizes[0], total, GL_STATIC_DRAW);
-}
-
-// load vertex buffer in preparation for rendering
-//
-// Lee Rogers
-//
-void ofApp::loadExplosionVbo() {
-	if (explosionEmitter.sys->particles.size() < 1) return;
-
-	vector<ofVec3f> sizes;
-	vector<ofVec3f> points;
-	for (int i = 0; i < explosionEmitter.sys->particles.size(); i++) {
-		points.push_back(explosionEmitter.sys->particles[i].position);
-		sizes.push_back(ofVec3f(explosionEmitter.particleRadius));
-	}
-	// upload the data to the vbo
-	//
-	int total = (int)points.size();
-	explosionVbo.clear();
-	explosionVbo.setVertexData(&points[0], total, GL_STATIC_DRAW);
-	explosionVbo.setNormalData(&sizes[0], total, GL_STATIC_DRAW);
-}
-
-// load vertex buffer in preparation for rendering
-//
-// Lee Rogers
-//
-void ofApp::loadVortexRingVbo() {
-	if (vortexRingEmitter.sys->particles.size() < 1) return;
-
-	vector<ofVec3f> sizes;
-	vector<ofVec3f> points;
-	for (int i = 0; i < vortexRingEmitter.sys->particles.size(); i++) {
-		points.push_back(vortexRingEmitter.sys->particles[i].position);
-		sizes.push_back(ofVec3f(vortexRingEmitter.particleRadius));
-	}
-	// upload the data to the vbo
-	//
-	int total = (int)points.size();
-	vortexRingVbo.clear();
-	vortexRingVbo.setVertexData(&points[0], total, GL_STATIC_DRAW);
-	vortexRingVbo.setNormalData(&sizes[0], total, GL_STATIC_DRAW);
-}
-
-// load vertex buffer in preparation for rendering
-//
-// Lee Rogers
-//
-void ofApp::loadLandingRingVbo() {
-	if (landingRingEmitter.sys->particles.size() < 1) return;
-
-	vector<ofVec3f> sizes;
-	vector<ofVec3f> points;
-	for (int i = 0; i < landingRingEmitter.sys->particles.size(); i++) {
-		points.push_back(landingRingEmitter.sys->particles[i].position);
-		sizes.push_back(ofVec3f(landingRingEmitter.particleRadius));
-	}
-	// upload the data to the vbo
-	//
-	int total = (int)points.size();
-	landingRingVbo.clear();
-	landingRingVbo.setVertexData(&points[0], total, GL_STATIC_DRAW);
-	landingRingVbo.setNormalData(&sizes[0], total, GL_STATIC_DRAW);
-}
-
-// load vertex buffer in preparation for rendering
-//
-// Lee Rogers
-//
-void ofApp::loadLandingRingVbo2() {
-	if (landingRingEmitter2.sys->particles.size() < 1) return;
-
-	vector<ofVec3f> sizes;
-	vector<ofVec3f> points;
-	for (int i = 0; i < landingRingEmitter2.sys->particles.size(); i++) {
-		points.push_back(landingRingEmitter2.sys->particles[i].position);
-		sizes.push_back(ofVec3f(landingRingEmitter2.particleRadius));
-	}
-	// upload the data to the vbo
-	//
-	int total = (int)points.size();
-	landingRingVbo2.clear();
-	landingRingVbo2.setVertexData(&points[0], total, GL_STATIC_DRAW);
-	landingRingVbo2.setNormalData(&sizes[0], total, GL_STATIC_DRAW);
-}
-
-// load vertex buffer in preparation for rendering
-//
-// Lee Rogers
-//
-void ofApp::loadLandingRingVbo3() {
-	if (landingRingEmitter3.sys->particles.size() < 1) return;
-
-	vector<ofVec3f> sizes;
-	vector<ofVec3f> points;
-	for (int i = 0; i < landingRingEmitter3.sys->particles.size(); i++) {
-		points.push_back(landingRingEmitter3.sys->particles[i].position);
-		sizes.push_back(ofVec3f(landingRingEmitter3.particleRadius));
-	}
-	// upload the data to the vbo
-	//
-	int total = (int)points.size();
-	landingRingVbo3.clear();
-	landingRingVbo3.setVertexData(&points[0], total, GL_STATIC_DRAW);
-	landingRingVbo3.setNormalData(&sizes[0], total, GL_STATIC_DRAW);
-}
-
 // Stop game
 //
 // Lee Rogers
 //
+// The simulation has already reset itself (endGame()); this puts the
+// lander model and camera back.
+//
 void ofApp::stopGame() {
 	gameState = false;
 
 	// Reset lander position/rotation
 	lander.setPosition(0, 50, 0);
 	lander.setRotation(0, 0, 0, 1, 0);
-	landerPos = glm::vec3(0, 50, 0);
-	landerRot = 0;
-	landerVelocity = glm::vec3(0, 0, 0);
 
 	// Set camera
 	cam.setPosition(lander.getPosition().x, lander.getPosition().y + 20, lander.getPosition().z + 45);
@@ -429,270 +316,368 @@ void ofApp::stopGame() {
 	fPov = false;
 	aPov = false;
 	tPov = true;
-
-	// Remove particle effects
-	for (int i = thrustEmitter.sys->particles.size() - 1; i > -1; i--)
-		thrustEmitter.sys->remove(i);
-	for (int i = explosionEmitter.sys->particles.size() - 1; i > -1; i--)
-		explosionEmitter.sys->remove(i);
-	for (int i = vortexRingEmitter.sys->particles.size() - 1; i > -1; i--)
-		vortexRingEmitter.sys->remove(i);
 }
 
 //--------------------------------------------------------------
 // incrementally update scene (animation)
 //
+// The simulation runs on its own thread (simulationLoop()).  Each frame
+// takes the latest snapshot it published, plays the sounds for what
+// happened since the last frame, and places the lander model and camera
+// at a state interpolated between the last two steps, so motion stays
+// smooth whatever the render rate.
+//
 void ofApp::update() {
+	Profiler::get().beginFrame();
+	PROFILE_SCOPE("update");
+
+	snapshots.update();
+	latest = &snapshots.front();
+
+	LanderEvents events;
+	while (simEvents.pop(events)) {
+		if (events.thrustStarted)
+			thrustWhoosh.play();
+		if (events.thrustStopped)
+			thrustWhoosh.stop();
+		if (events.exploded)
+			landerBoom.play();
+	}
+	if (latest->gamesFinished != gamesStopped) {
+		gamesStopped = latest->gamesFinished;
+		stopGame();
+	}
+
+	// stream in the terrain around the lander.  The simulation gets the
+	// resident tiles when they change, and holds until the ground under
+	// the lander has loaded.
+	//
+	{
+		PROFILE_SCOPE("terrain streaming");
+		terrainTiles.update(latest->pos);
+		vector<std::shared_ptr<const Octree>> octrees;
+		terrainTiles.octrees(octrees);
+		bool ready = terrainTiles.ready(latest->pos);
+		if (octrees != terrainOctrees || ready != terrainReady) {
+			terrainOctrees = octrees;
+			terrainReady = ready;
+			SimCommand command;
+			command.type = SimCommand::Terrain;
+			command.terrain = octrees;
+			terrainTiles.heightFields(command.heights);
+			command.flag = ready;
+			sendToSim(command);
+		}
+	}
+
 	if (gameState) {
-		// Update positions
-		landerPos = lander.getPosition();
-		thrustEmitter.position = landerPos;
-		explosionEmitter.position = landerPos;
-		landerLight.setPosition(landerPos);
-		
-		// Call update
-		thrustEmitter.update();
-		explosionEmitter.update();
-		vortexRingEmitter.update();
-		landingRingEmitter.update();
-		landingRingEmitter2.update();
-		landingRingEmitter3.update();
+		// Interpolated render state, by the real time since the last step ended
+		double since = (double)ofGetElapsedTimeMicros() - (double)latest->stepEnd;
+		float alpha = ofClamp(since / (latest->stepSize * 1.0e6), 0, 1);
+		glm::vec3 renderPos = glm::mix(latest->prevPos, latest->pos, alpha);
+		float renderRot = glm::mix(latest->prevRot, latest->rot, alpha);
+		lander.setPosition(renderPos.x, renderPos.y, renderPos.z);
+		lander.setRotation(0, renderRot, 0, 1, 0);
 		lander.update();
+		landerLight.setPosition(renderPos);
 
 		// Point light in direction of lander movement
-		landerLight.lookAt(lander.getPosition() 
-			+ glm::vec3(glm::rotate(glm::mat4(1.0), glm::radians(landerRot), glm::vec3(0, 1, 0)) * glm::vec4(1, 0, 0, 1)) * 50
+		landerLight.lookAt(renderPos
+			+ glm::vec3(glm::rotate(glm::mat4(1.0), glm::radians(renderRot), glm::vec3(0, 1, 0)) * glm::vec4(1, 0, 0, 1)) * 50
 			+ glm::vec3(0, -50, 0) * 2);
 
 		//update camera povs
-		ofVec3f currentCamPos = cam.getPosition();
-		ofVec3f targetCamPos;
 		if (fPov) {
 			ofVec3f currentCamPos = cam.getPosition();
-			ofVec3f targetCamPos = ofVec3f(landerPos.x, landerPos.y + 10, landerPos.z);
+			ofVec3f targetCamPos = ofVec3f(renderPos.x, renderPos.y + 10, renderPos.z);
 			cam.setPosition(currentCamPos.interpolate(targetCamPos, 0.1));
-			cam.lookAt(landerPos + glm::vec3(0, 10, 0)
-				+ glm::vec3(glm::rotate(glm::mat4(1.0), glm::radians(landerRot), glm::vec3(0, 1, 0)) * glm::vec4(1, 0, 0, 1)) * 10);
+			cam.lookAt(renderPos + glm::vec3(0, 10, 0)
+				+ glm::vec3(glm::rotate(glm::mat4(1.0), glm::radians(renderRot), glm::vec3(0, 1, 0)) * glm::vec4(1, 0, 0, 1)) * 10);
 		}
 		else if (tPov) {
 			ofVec3f currentCamPos = cam.getPosition();
-			ofVec3f targetCamPos = ofVec3f(landerPos.x, landerPos.y + 20, landerPos.z + 45);
+			ofVec3f targetCamPos = ofVec3f(renderPos.x, renderPos.y + 20, renderPos.z + 45);
 			cam.setPosition(currentCamPos.interpolate(targetCamPos, 0.1));
-			cam.lookAt(lander.getPosition());
+			cam.lookAt(renderPos);
 		}
 		else if (aPov) {
 			ofVec3f currentCamPos = cam.getPosition();
-			ofVec3f targetCamPos = ofVec3f(landerPos.x, landerPos.y + 50, landerPos.z);
+			ofVec3f targetCamPos = ofVec3f(renderPos.x, renderPos.y + 50, renderPos.z);
 			cam.setPosition(currentCamPos.interpolate(targetCamPos, 0.1));
-			cam.lookAt(lander.getPosition());
+			cam.lookAt(renderPos);
 		}
+	}
+}
 
-		// Measure distance -----------------------------------------------------------------------------
-		if (bAGL) {
-			glm::vec3 origin = lander.getPosition();
-			glm::vec3 dir = glm::vec3(0, -1, 0);
-			glm::normalize(dir);
-			Ray ray = Ray(Vector3(origin.x, origin.y, origin.z), Vector3(dir.x, dir.y, dir.z));
-			TreeNode node;
-
-			pointSelected = octree.intersect(ray, octree.root, node);
-
-			Vector3 center = node.box.center();
-			distance = glm::distance(lander.getPosition(), glm::vec3(center.x(), center.y(), center.z()));
+//--------------------------------------------------------------
+// Simulation thread
+//
+// Runs the fixed steps that fit in the real time elapsed (see SimClock),
+// then publishes a snapshot for the main thread and sleeps until the next
+// step is due.  Simulation time only advances while a game is running and
+// the ground under the lander has loaded.
+//
+void ofApp::simulationLoop() {
+	while (!simQuit) {
+		uint64_t loopStart = ofGetElapsedTimeMicros();
+		bool changed = false;
+		SimCommand command;
+		while (simCommands.pop(command)) {
+			applySimCommand(command);
+			changed = true;
 		}
 
-		// Update vortex ring
-		if (distance < 5) {
-			if (!vortexRing)
-				vortexRingEmitter.start();
-			vortexRing = true;
-			vortexRingEmitter.position = lander.getPosition() + glm::vec3(0, -distance, 0);
+		clock.setPaused(!simRunning || !simTerrainReady);
+		clock.beginFrame();
+		while (simRunning && simTerrainReady && clock.nextStep()) {
+			simulateStep();
+			changed = true;
 		}
-		else {
-			if (vortexRing) {
-				vortexRingEmitter.stop();
-				vortexRingEmitter.sys->reset();
-			}
-			vortexRing = false;
+
+		// no steps while paused - keep the key state current
+		if (clock.paused)
+			inputQueue.fold(keys, ofGetElapsedTimeMicros());
+
+		// plan ahead from the new state, in the time until the next step
+		if (autopilotOn && simRunning && simTerrainReady && sim.outcome() == LanderFlying) {
+			PROFILE_SCOPE("autopilot");
+			autopilot.improve(sim, clock.stepSize, clock.now, autopilotBudgetMs);
+			changed = true;
 		}
 
-		// Lander physics simulation -----------------------------------------------------------------------------
-		float framerate = ofGetFrameRate();
-		float dt = (framerate > 0) ? 1.0 / framerate : 0;
+		if (changed)
+			publishSnapshot();
 
-		//move up/down (linear)
-		landerPos += landerVelocity * dt;
-		landerAcceleration = (1 / landerMass) * landerForce;
-		landerVelocity += landerAcceleration * dt;
-		landerVelocity *= landerDamping;
+		float wait = (1 - ofClamp(clock.alpha, 0, 1)) * clock.stepSize - (ofGetElapsedTimeMicros() - loopStart) / 1.0e6;
+		if (wait > 0)
+			std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(wait * 1.0e6)));
+	}
+}
 
-		//rotate (angular)
-		landerRot += landerAngularVelocity * dt;
-		landerAngularAcceleration = (1 / landerMass) * landerAngularForce;
-		landerAngularVelocity += landerAngularAcceleration * dt;
-		landerAngularVelocity *= landerDamping;
+void ofApp::applySimCommand(SimCommand &command) {
+	switch (command.type) {
+	case SimCommand::Start:
+		// Lander, fuel and outcome.  A new seed for every game, recorded
+		// with its input so the game can be replayed exactly.
+		sim.rng.setSeed(command.seed);
+		sim.reset(sim.pos);
+		prevLanderPos = sim.pos;
+		prevLanderRot = sim.rot;
+		replayLog.begin(sim, command.seed, clock.stepSize, clock.now, terrainFile);
+		autopilot.start(sim);
+		simRunning = true;
+		break;
+	case SimCommand::Move:
+		sim.pos = prevLanderPos = command.pos;
+		if (simRunning) replayLog.move(sim.pos);
+		autopilot.start(sim);
+		break;
+	case SimCommand::MeasureAltitude:
+		altitudeOn = command.flag;
+		sim.measureAltitude = altitudeOn || autopilotOn;
+		break;
+	case SimCommand::Terrain:
+		simTerrain.swap(command.terrain);
+		sim.terrain.clear();
+		for (int i = 0; i < simTerrain.size(); i++)
+			sim.terrain.push_back(simTerrain[i].get());
+		simHeights.swap(command.heights);
+		simGround.fields.clear();
+		for (int i = 0; i < simHeights.size(); i++)
+			simGround.fields.push_back(simHeights[i].get());
+		simTerrainReady = command.flag;
+		break;
+	case SimCommand::Autopilot:
+		// the scripted pilot in next() and the rollouts steer by the
+		// altitude, so it is measured while the autopilot flies - from now,
+		// if it wasn't
+		autopilotOn = command.flag;
+		if (autopilotOn && !sim.measureAltitude)
+			sim.updateAltitude();
+		sim.measureAltitude = altitudeOn || autopilotOn;
+		autopilot.start(sim);
+		break;
+	}
+}
 
-		// Zero out forces
-		landerForce = glm::vec3(0, 0, 0);
-		landerAngularForce = 0;
+//  hand the state to draw to the main thread
+//
+void ofApp::publishSnapshot() {
+	SimSnapshot &s = snapshots.back();
+	s.steps = clock.frame;
+	s.stepEnd = clock.stepEnd;
+	s.stepSize = clock.stepSize;
+	s.pos = sim.pos;
+	s.prevPos = prevLanderPos;
+	s.rot = sim.rot;
+	s.prevRot = prevLanderRot;
+	s.velocity = sim.velocity;
+	s.fuelLevel = sim.fuelLevel;
+	s.autopilot = autopilotOn;
+	const AutopilotPlan &plan = autopilot.plan();
+	s.plan.descentRate = plan.descentRate;
+	s.plan.cost = plan.cost;
+	s.plan.outcome = plan.outcome;
+	s.plan.fuelLeft = plan.fuelLeft;
+	s.plan.steps = plan.steps;
+	s.rollouts = autopilot.rollouts;
+	s.altitude = sim.altitude;
+	s.gameOver = sim.gameOver;
+	s.gameComplete = sim.gameComplete;
+	s.gameEnd = sim.gameEnd;
+	s.gamesFinished = gamesFinished;
+	if (s.particles.entries.size() != particleBatch.entries.size())
+		s.particles = particleBatch;
+	s.particles.capture();
+	snapshots.publish();
+}
 
-		// Update lander pos/rot
-		lander.setPosition(landerPos.x, landerPos.y, landerPos.z);
-		lander.setRotation(0, landerRot, 0, 1, 0);
-
-		// Add forces -----------------------------------------------------------------------------
-		landerForce += gravityForce->get() * landerMass; // Gravity
-
-		// Handle key presses -----------------------------------------------------------------------------
-		if (!gameOver && !gameComplete && !gameEnd) {
-			if (keysPressed.count(' ') && fuelLevel > 0) {
-				landerForce += glm::vec3(0, 10, 0);
-
-				// Start thrust particle effect
-				if (!thrust) {
-					thrustEmitter.start();
-					thrustWhoosh.play();
-				}
-				thrust = true;
-
-				// Turbulence effect
-				landerForce += glm::vec3(ofRandom(turbForce->getMin().x, turbForce->getMax().x)
-					, ofRandom(turbForce->getMin().y, turbForce->getMax().y)
-					, ofRandom(turbForce->getMin().y, turbForce->getMax().y));
-			}
-			else {
-				// End thrust particle effect
-				if (thrust) {
-					thrustEmitter.stop();
-					thrustEmitter.sys->reset();
-				}
-				thrust = false;
-				thrustWhoosh.stop();
-			}
-
-			if (fuelLevel > 0) {
-				if (keysPressed.count(OF_KEY_LEFT))
-					landerAngularForce += 100;
-				if (keysPressed.count(OF_KEY_RIGHT))
-					landerAngularForce -= 100;
-				if (keysPressed.count(OF_KEY_UP))
-					landerForce += glm::vec3(glm::rotate(glm::mat4(1.0), glm::radians(landerRot), glm::vec3(0, 1, 0)) * glm::vec4(1, 0, 0, 1)) * 10;
-				if (keysPressed.count(OF_KEY_DOWN))
-					landerForce -= glm::vec3(glm::rotate(glm::mat4(1.0), glm::radians(landerRot), glm::vec3(0, 1, 0)) * glm::vec4(1, 0, 0, 1)) * 10;
-			}
-
-			// Track fuel consumption
-			if ((keysPressed.count(' ') || keysPressed.count(OF_KEY_LEFT) || keysPressed.count(OF_KEY_RIGHT)
-				|| keysPressed.count(OF_KEY_UP) || keysPressed.count(OF_KEY_DOWN)) && fuelLevel > 0) {
-				if (!fuel) {
-					// Mark fuel start
-					fuelStart = ofGetElapsedTimef();
-				}
-				fuel = true;
-
-				// Update fuel level
-				usedFuel = ofGetElapsedTimef() - fuelStart;
-				fuelLevel = initialFuel - usedFuel;
-			}
-			else {
-				if (fuel) {
-					// Update fuel level
-					initialFuel -= usedFuel;
-				}
-				fuel = false;
-			}
-		}
-		else {
-			// End thrust effect if still playing
-			if (thrust) {
-				thrustEmitter.stop();
-				thrustEmitter.sys->reset();
-			}
-			thrust = false;
-			thrustWhoosh.stop();
-		}
+//  main thread: queue a command for the simulation thread
+//
+void ofApp::sendToSim(SimCommand command) {
+	if (!simCommands.push(command))
+		cout << "simulation command queue full" << endl;
+}
 
-		// Collision -----------------------------------------------------------------------------
-		ofVec3f min = lander.getSceneMin() + lander.getPosition();
-		ofVec3f max = lander.getSceneMax() + lander.getPosition();
-		Box bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+//  the outcome has been shown - save the recording, put the lander back
+//  and clear the effects.  The main thread sees gamesFinished go up in the
+//  next snapshot and resets the view (stopGame()).
+//
+void ofApp::endGame() {
+	simRunning = false;
+
+	// Save the recording of the game that just ended
+	if (replayLog.recording) {
+		replayLog.recording = false;
+		if (replayLog.save(ofToDataPath("replay.rec")))
+			cout << "replay saved: " << replayLog.steps << " steps" << endl;
+	}
 
-		colBoxList.clear();
-		octree.intersect(bounds, octree.root, colBoxList);
-
-		if (colBoxList.size() >= 5) {
-			// Explosion (return, end game if true)
-			if (glm::length(landerVelocity) > 3 && !gameOver && !gameComplete && !gameEnd) {
-				// Start explosion particle effect
-				if (!explosion)
-					explosionEmitter.start();
-					landerBoom.play();
-				explosionStart = ofGetElapsedTimef();
-
-				// Apply game over, explode lander in random upward direction
-				gameOver = true;
-				landerForce += glm::vec3((ofRandom(-1, 1) > 0 ? 1 : -1) * 3000, 3000, (ofRandom(-1, 1) > 0 ? 1 : -1) * 3000);
-				return;
-			} else if (glm::length(landerVelocity) < 3 && !gameOver && !gameComplete && !gameEnd) {
-				landingStart = ofGetElapsedTimef();
-				checkCollisionPosition(lander.getPosition());
-			}
-
-			// Resolution
-			glm::vec3 p2 = glm::vec3(bounds.center().x(), bounds.center().y(), bounds.center().z()); // Center of lander box
-
-			// Find closest box center
-			glm::vec3 p1;
-			float min = FLT_MAX;
-			for (Box box : colBoxList) {
-				Vector3 center = box.center();
-				glm::vec3 point = glm::vec3(center.x(), center.y(), center.z());
-				float distance = glm::length(p2 - point);
-				if (distance < min) {
-					min = distance;
-					p1 = point;
-				}
-			}
-
-			float e = 0.1; // Restitution (0-1)
-			glm::vec3 n = glm::normalize(p2 - p1); // Normal
-			glm::vec3 p = (e + 1) * (-glm::dot(landerVelocity, n)) * n; // Impulse force (assume mass 1, inf)
-
-			// Apply impulse directly to velocity (adjusts velocity, not forces)
-			landerVelocity = p;
-		}
-		else {
-			if (gameOver) {
-				// End explosion particle effect
-				if (explosion) {
-					explosionEmitter.stop();
-					explosionEmitter.sys->reset();
-					explosion = false;
-				}
-				// Stop game if explosion is done playing and game is over
-				if (ofGetElapsedTimef() - explosionStart > 3)
-					stopGame();
-			} else if (gameComplete) {
-				if (ofGetElapsedTimef() - landingStart > 3)
-					stopGame();
-			}
-			else if (gameEnd) {
-				if (ofGetElapsedTimef() - landingStart > 3)
-					stopGame();
-			}
+	sim.reset(glm::vec3(0, 50, 0));
+	prevLanderPos = sim.pos;
+	prevLanderRot = sim.rot;
+
+	// Remove particle effects
+	for (int i = thrustEmitter.sys->particles.size() - 1; i > -1; i--)
+		thrustEmitter.sys->remove(i);
+	for (int i = explosionEmitter.sys->particles.size() - 1; i > -1; i--)
+		explosionEmitter.sys->remove(i);
+	for (int i = vortexRingEmitter.sys->particles.size() - 1; i > -1; i--)
+		vortexRingEmitter.sys->remove(i);
+}
+
+//--------------------------------------------------------------
+// advance the simulation by one fixed step of clock.dt seconds
+//
+void ofApp::simulateStep() {
+	// Remember the previous state for render interpolation
+	prevLanderPos = sim.pos;
+	prevLanderRot = sim.rot;
+
+	// Update positions
+	thrustEmitter.position = sim.pos;
+	explosionEmitter.position = sim.pos;
+
+	// Call update
+	{
+		PROFILE_SCOPE("emitters");
+		thrustEmitter.update(clock);
+		explosionEmitter.update(clock);
+		vortexRingEmitter.update(clock);
+		landingRingEmitter.update(clock);
+		landingRingEmitter2.update(clock);
+		landingRingEmitter3.update(clock);
+	}
+
+	// Step the lander with the keys held during this step, or the
+	// autopilot's plan - until a key takes the controls back
+	inputQueue.fold(keys, clock.stepEnd);
+	LanderInput input;
+	input.thrust = keys.down(' ');
+	input.left = keys.down(OF_KEY_LEFT);
+	input.right = keys.down(OF_KEY_RIGHT);
+	input.forward = keys.down(OF_KEY_UP);
+	input.back = keys.down(OF_KEY_DOWN);
+	if (autopilotOn && input.any()) {
+		autopilotOn = false;
+		sim.measureAltitude = altitudeOn;
+	}
+	if (autopilotOn)
+		input = autopilot.next(sim);
+
+	{
+		PROFILE_SCOPE("lander sim");
+		sim.step(clock.dt, clock.now, input);
+	}
+	replayLog.record(input, sim);
+
+	// Update vortex ring
+	if (sim.altitude < 5) {
+		if (!vortexRing)
+			vortexRingEmitter.start();
+		vortexRing = true;
+		vortexRingEmitter.position = prevLanderPos + glm::vec3(0, -sim.altitude, 0);
+	}
+	else {
+		if (vortexRing) {
+			vortexRingEmitter.stop();
+			vortexRingEmitter.sys->reset();
 		}
+		vortexRing = false;
+	}
+
+	// Effects for what happened during the step; the main thread plays
+	// the sounds
+	const LanderEvents &events = sim.events;
+	if (events.thrustStarted)
+		thrustEmitter.start();
+	if (events.thrustStopped) {
+		thrustEmitter.stop();
+		thrustEmitter.sys->reset();
+	}
+	if (events.exploded)
+		explosionEmitter.start();
+	if (events.touchedDown)
+		cout << (sim.gameComplete ? "lander in spotlight" : "not in light") << endl;
+
+	// sounds for the main thread.  While the queue is full they are merged
+	// into pendingEvents (thrust by its latest change) and sent later.
+	if (events.thrustStarted || events.thrustStopped) {
+		pendingEvents.thrustStarted = events.thrustStarted;
+		pendingEvents.thrustStopped = events.thrustStopped;
+	}
+	pendingEvents.exploded |= events.exploded;
+	if (pendingEvents.thrustStarted || pendingEvents.thrustStopped || pendingEvents.exploded) {
+		if (simEvents.push(pendingEvents))
+			pendingEvents = LanderEvents();
+	}
+	if (events.finished) {
+		gamesFinished++;
+		endGame();
 	}
-	
 }
 
 //--------------------------------------------------------------
 void ofApp::draw() {
-	loadThrustVbo();
-	loadExplosionVbo();
-	loadVortexRingVbo();
-	loadLandingRingVbo();
-	loadLandingRingVbo2();
-	loadLandingRingVbo3();
+	PROFILE_SCOPE("draw");
+
+	// cull terrain chunks and particle emitters against the camera
+	//
+	{
+		PROFILE_SCOPE("culling");
+		culler.setup(cam.getModelViewProjectionMatrix(), cam.getPosition());
+		culler.cull(latest->particles);
+	}
+
+	// pack the visible particles of all emitters into the stream buffer
+	//
+	ParticleRange particles;
+	{
+		PROFILE_SCOPE("particle packing");
+		particleRenderer.begin();
+		particles = particleRenderer.add(latest->particles);
+		particleRenderer.upload();
+	}
 
 	// Handle lander light toggle
 	if (bLanderLight)
@@ -710,7 +695,10 @@ void ofApp::draw() {
 	ofPushMatrix();
 	
 	ofEnableLighting();              // shaded mode
-	moon.drawFaces();
+	{
+		PROFILE_SCOPE("terrain draw");
+		terrainTiles.draw(culler, cam.getPosition());
+	}
 	if (bLanderLoaded)
 		lander.drawFaces();
 	ofDisableLighting();
@@ -731,28 +719,20 @@ void ofApp::draw() {
 
 	particleTex.bind();
 
-	ofSetColor(230, 153, 255); // Thrust color
-	thrustVbo.draw(GL_POINTS, 0, (int)thrustEmitter.sys->particles.size());
-
-	ofSetColor(255, 166, 77); // Explosion color
-	explosionVbo.draw(GL_POINTS, 0, (int)explosionEmitter.sys->particles.size());
-
-	ofSetColor(230, 230, 230); // Vortex ring color
-	vortexRingVbo.draw(GL_POINTS, 0, (int)vortexRingEmitter.sys->particles.size());
-
-	//landing ring color
-	ofSetColor(133, 224, 133);
-	landingRingVbo.draw(GL_POINTS, 0, (int)landingRingEmitter.sys->particles.size());
-	ofSetColor(133, 224, 133); 
-	landingRingVbo2.draw(GL_POINTS, 0, (int)landingRingEmitter2.sys->particles.size());
-	ofSetColor(133, 224, 133);
-	landingRingVbo3.draw(GL_POINTS, 0, (int)landingRingEmitter3.sys->particles.size());
+	// colors and sizes come with each particle - one draw for all emitters
+	//
+	{
+		PROFILE_SCOPE("particle draw");
+		particleRenderer.draw(particles);
+	}
 
 	particleTex.unbind();
 
 	cam.end();
 	shader.end();
 
+	particleRenderer.end();
+
 	ofDisablePointSprites();
 	ofDisableBlendMode();
 	ofEnableAlphaBlending();
@@ -763,38 +743,58 @@ void ofApp::draw() {
 	glDepthMask(false);
 	ofSetColor(ofColor::white);
 
-	if (gameState && !gameOver && !gameComplete && !gameEnd) {
+	if (gameState && !latest->gameOver && !latest->gameComplete && !latest->gameEnd) {
 		// Draw top left info
-		ofDrawBitmapString("Velocity: " + ofToString(landerVelocity.x, 2) + " " + ofToString(landerVelocity.y, 2) + " " + ofToString(landerVelocity.z, 2), 15 * 2, 15 * 2);
-		ofDrawBitmapString((fuelLevel > 0) ? "Fuel: " + ofToString(fuelLevel, 2) : "Fuel: EMPTY!", 15 * 2, 30 * 2);
+		ofDrawBitmapString("Velocity: " + ofToString(latest->velocity.x, 2) + " " + ofToString(latest->velocity.y, 2) + " " + ofToString(latest->velocity.z, 2), 15 * 2, 15 * 2);
+		ofDrawBitmapString((latest->fuelLevel > 0) ? "Fuel: " + ofToString(latest->fuelLevel, 2) : "Fuel: EMPTY!", 15 * 2, 30 * 2);
 		if (bAGL)
-			ofDrawBitmapString("Altitude: " + ofToString(distance, 2), 15 * 2, 45 * 2);
+			ofDrawBitmapString("Altitude: " + ofToString(latest->altitude, 2), 15 * 2, 45 * 2);
+		if (latest->autopilot) {
+			string plan = latest->plan.evaluated() ? string(LanderSim::outcomeName(latest->plan.outcome)) + " in "
+				+ ofToString(latest->plan.steps * latest->stepSize, 1) + " sec, " + ofToString(latest->plan.fuelLeft, 1) + " fuel left"
+				: "planning";
+			ofDrawBitmapString("Autopilot: " + plan + " (" + ofToString(latest->rollouts) + " rollouts)", 15 * 2, 45 * 2 + 15);
+		}
+		if (!terrainTiles.ready(latest->pos)) {
+			ofBitmapFont font = ofBitmapFont();
+			string text = "Loading terrain...";
+			int width = font.getBoundingBox(text, 0, 0).getWidth();
+			ofDrawBitmapString(text, ofGetWidth() / 2 - width / 2, ofGetHeight() / 2);
+		}
+		if (bCullStats) {
+			const CullStats &cs = culler.stats;
+			ofDrawBitmapString("Terrain chunks: " + ofToString(cs.chunksDrawn) + "/" + ofToString(cs.chunks) + " (" + ofToString(cs.chunksCulled(), 0) + "% culled)", 15 * 2, 60 * 2);
+			ofDrawBitmapString("Particles: " + ofToString(cs.particlesDrawn) + "/" + ofToString(cs.particles) + " (" + ofToString(cs.particlesCulled(), 0) + "% culled)", 15 * 2, 60 * 2 + 15);
+			ofDrawBitmapString("Terrain vertices: " + ofToString(terrainTiles.verticesDrawn) + "  LOD meshes: " + ofToString(terrainTiles.lodsResident), 15 * 2, 60 * 2 + 30);
+			ofDrawBitmapString("Terrain tiles: " + ofToString(terrainTiles.tilesResident) + " loaded, " + ofToString(terrainTiles.tilesPending) + " pending, " + ofToString(terrainTiles.memoryUsed >> 20) + " MB", 15 * 2, 60 * 2 + 45);
+		}
 
 		// Draw bottom right info
 		ofBitmapFont font = ofBitmapFont();
 		string text = "x: Lander Light";
 		int width = font.getBoundingBox(text, 0, 0).getWidth();
+		ofDrawBitmapString("a: Autopilot", ofGetWidth() - width - 15 * 2, ofGetHeight() - 90 * 2);
 		ofDrawBitmapString("Space: Thrust", ofGetWidth() - width - 15 * 2, ofGetHeight() - 75 * 2);
 		ofDrawBitmapString("Arrows: Move", ofGetWidth() - width - 15 * 2, ofGetHeight() - 60 * 2);
 		ofDrawBitmapString("z: Cycle Views", ofGetWidth() - width - 15 * 2, ofGetHeight() - 45 * 2);
 		ofDrawBitmapString("x: Lander Light", ofGetWidth() - width - 15 * 2, ofGetHeight() - 30 * 2);
 		ofDrawBitmapString("n: AGL", ofGetWidth() - width - 15 * 2, ofGetHeight() - 15 * 2);
 	}
-	else if (gameState && gameOver && !gameComplete && !gameEnd) {
+	else if (gameState && latest->gameOver && !latest->gameComplete && !latest->gameEnd) {
 		ofBitmapFont font = ofBitmapFont();
 		string text = "Ship Exploded. Game Over!";
 		int width = font.getBoundingBox(text, 0, 0).getWidth();
 		int height = font.getBoundingBox(text, 0, 0).getHeight();
 		ofDrawBitmapString(text, ofGetWidth() / 2 - width / 2, ofGetHeight() / 2 - height / 2);
 	}
-	else if (gameState && gameComplete && !gameOver && !gameEnd) {
+	else if (gameState && latest->gameComplete && !latest->gameOver && !latest->gameEnd) {
 		ofBitmapFont font = ofBitmapFont();
 		string text = "Landed Successfully. Game Complete!";
 		int width = font.getBoundingBox(text, 0, 0).getWidth();
 		int height = font.getBoundingBox(text, 0, 0).getHeight();
 		ofDrawBitmapString(text, ofGetWidth() / 2 - width / 2, ofGetHeight() / 2 - height / 2);
 	}
-	else if (gameState && gameEnd && !gameOver && !gameComplete) {
+	else if (gameState && latest->gameEnd && !latest->gameOver && !latest->gameComplete) {
 		ofBitmapFont font = ofBitmapFont();
 		string text = "Lander did not land in a spotlight! Try again.";
 		int width = font.getBoundingBox(text, 0, 0).getWidth();
@@ -819,8 +819,10 @@ void ofApp::draw() {
 		ofDrawBitmapString(cMouse, ofGetWidth() / 2 - width / 2, ofGetHeight() / 2.5 - height / 2 + 100);
 		string rightClick = "Right click to set your own camera view";
 		ofDrawBitmapString(rightClick, ofGetWidth() / 2 - width / 2, ofGetHeight() / 2.5 - height / 2 + 120);
+		string autopilot = "a to let the autopilot land (any flight key takes over)";
+		ofDrawBitmapString(autopilot, ofGetWidth() / 2 - width / 2, ofGetHeight() / 2.5 - height / 2 + 140);
 		string start = "Press Enter to start";
-		ofDrawBitmapString(start, ofGetWidth() / 2 - width / 2, ofGetHeight() / 2.5 - height / 2 + 140);
+		ofDrawBitmapString(start, ofGetWidth() / 2 - width / 2, ofGetHeight() / 2.5 - height / 2 + 160);
 	}
 	else if (!gameState) {
 		startScreen = true;
@@ -832,12 +834,15 @@ void ofApp::draw() {
 		ofDrawBitmapString(title, ofGetWidth() / 1.75 - width / 2, ofGetHeight() / 2 - height / 2);
 		ofDrawBitmapString(text, ofGetWidth() / 2 - width / 2, ofGetHeight() / 2 - height / 2 + 20);
 	}
+
+	if (bProfiler)
+		Profiler::get().drawOverlay(ofGetWidth() - 330, 15 * 2);
 	
 	glDepthMask(true);
 }
 
 void ofApp::keyPressed(int key) {
-	keysPressed.insert(key);
+	inputQueue.push(key, true);
 
 	switch (key) {
 	case 'B':
@@ -908,16 +913,14 @@ void ofApp::keyPressed(int key) {
 		if (!gameState || gameInstructions) {
 			// Game state
 			gameState = true;
-			gameOver = false;
-			gameComplete = false;
-			gameEnd = false;
 			gameInstructions = false;
 			startScreen = false;
 
-			// Fuel
-			fuelLevel = 120;
-			initialFuel = 120;
-			usedFuel = 0;
+			// Lander, fuel and outcome are reset by the simulation
+			SimCommand command;
+			command.type = SimCommand::Start;
+			command.seed = ofGetSystemTimeMicros();
+			sendToSim(command);
 		}
 		break;
 	case 'p':
@@ -927,8 +930,30 @@ void ofApp::keyPressed(int key) {
 			cout << "instructions screen" << endl;
 		}
 		break;
-	case 'n':
+	case 'n': {
 		bAGL = !bAGL;
+		SimCommand command;
+		command.type = SimCommand::MeasureAltitude;
+		command.flag = bAGL;
+		sendToSim(command);
+		break;
+	}
+	case 'a': {
+		SimCommand command;
+		command.type = SimCommand::Autopilot;
+		command.flag = !latest->autopilot;
+		sendToSim(command);
+		break;
+	}
+	case 'v':
+		bCullStats = !bCullStats;
+		break;
+	case 'g':
+		bProfiler = !bProfiler;
+		Profiler::get().enabled.store(bProfiler, std::memory_order_relaxed);
+		break;
+	case 'G':
+		Profiler::get().writeTrace(ofToDataPath("trace.json"));
 		break;
 	default:
 		break;
@@ -936,7 +961,7 @@ void ofApp::keyPressed(int key) {
 }
 
 void ofApp::keyReleased(int key) {
-	keysPressed.erase(key);
+	inputQueue.push(key, false);
 
 	switch (key) {
 
@@ -978,8 +1003,8 @@ void ofApp::mousePressed(int x, int y, int button) {
 		ofVec3f min = lander.getSceneMin() + lander.getPosition();
 		ofVec3f max = lander.getSceneMax() + lander.getPosition();
 
-		Box bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
-		bool hit = bounds.intersect(Ray(Vector3(origin.x, origin.y, origin.z), Vector3(mouseDir.x, mouseDir.y, mouseDir.z)), 0, 10000);
+		Box bounds = Box(min, max);
+		bool hit = bounds.intersect(Ray(origin, mouseDir), 0, 10000);
 		if (hit) {
 			bLanderSelected = true;
 			mouseDownPos = getMousePointOnPlane(lander.getPosition(), cam.getZAxis());
@@ -1006,15 +1031,9 @@ bool ofApp::raySelectWithOctree(ofVec3f& pointRet) {
 	ofVec3f rayPoint = cam.screenToWorld(mouse);
 	ofVec3f rayDir = rayPoint - cam.getPosition();
 	rayDir.normalize();
-	Ray ray = Ray(Vector3(rayPoint.x, rayPoint.y, rayPoint.z),
-		Vector3(rayDir.x, rayDir.y, rayDir.z));
+	Ray ray = Ray(rayPoint, rayDir);
 
-	pointSelected = octree.intersect(ray, octree.root, selectedNode);
-	Vector3 center = selectedNode.box.center();
-
-	if (pointSelected) {
-		pointRet = octree.mesh.getVertex(selectedNode.points[0]);
-	}
+	pointSelected = terrainTiles.intersect(ray, pointRet);
 	return pointSelected;
 }
 
@@ -1033,16 +1052,20 @@ void ofApp::mouseDragged(int x, int y, int button) {
 		glm::vec3 delta = mousePos - mouseLastPos;
 
 		landerPos += delta;
+		SimCommand command;
+		command.type = SimCommand::Move;
+		command.pos = landerPos;
+		sendToSim(command);
 		lander.setPosition(landerPos.x, landerPos.y, landerPos.z);
 		mouseLastPos = mousePos;
 
 		ofVec3f min = lander.getSceneMin() + lander.getPosition();
 		ofVec3f max = lander.getSceneMax() + lander.getPosition();
 
-		Box bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+		Box bounds = Box(min, max);
 
 		colBoxList.clear();
-		octree.intersect(bounds, octree.root, colBoxList);
+		terrainTiles.intersect(bounds, colBoxList);
 
 
 		/*if (bounds.overlap(testBox)) {
@@ -1077,9 +1100,8 @@ void ofApp::setCameraTarget() {
 	if (bLanderLoaded) {
 		ofVec3f min = lander.getSceneMin() + lander.getPosition();
 		ofVec3f max = lander.getSceneMax() + lander.getPosition();
-		Box landerBounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
-		bool hit = landerBounds.intersect(
-			Ray(Vector3(origin.x, origin.y, origin.z), Vector3(mouseDir.x, mouseDir.y, mouseDir.z)), 0, 10000);
+		Box landerBounds = Box(min, max);
+		bool hit = landerBounds.intersect(Ray(origin, mouseDir), 0, 10000);
 
 		if (hit) {
 			target = lander.getPosition();
@@ -6,6 +6,16 @@
 #include "Octree.h"
 #include "Particle.h"
 #include "ParticleEmitter.h"
+#include "SimClock.h"
+#include "LanderSim.h"
+#include "Replay.h"
+#include "Autopilot.h"
+#include "InputQueue.h"
+#include "SimThread.h"
+#include "ParticleRenderer.h"
+#include "TerrainTiles.h"
+#include "Profiler.h"
+#include "Culling.h"
 
 class ofApp : public ofBaseApp {
 
@@ -13,6 +23,15 @@ public:
 	void setup();
 	void update();
 	void draw();
+	void exit();
+
+	// simulation thread
+	void simulationLoop();
+	void simulateStep();
+	void applySimCommand(SimCommand &command);
+	void publishSnapshot();
+	void endGame();
+	void sendToSim(SimCommand command);
 
 	void keyPressed(int key);
 	void keyReleased(int key);
@@ -30,28 +49,17 @@ public:
 	bool mouseIntersectPlane(ofVec3f planePoint, ofVec3f planeNorm, ofVec3f& point);
 	bool raySelectWithOctree(ofVec3f& pointRet);
 	glm::vec3 ofApp::getMousePointOnPlane(glm::vec3 p, glm::vec3 n);
-	bool inSpotlight(ofLight& spotlight, glm::vec3 landerPos, float angle, float radius);
 
 	void setupLandingRingEmitter(ParticleEmitter& emitter, glm::vec3 pos, glm::vec3 velocity);
-	void loadThrustVbo();
-	void loadExplosionVbo();
-	void loadVortexRingVbo();
-	void loadLandingRingVbo();
-	void loadLandingRingVbo2();
-	void loadLandingRingVbo3();
-	void checkCollisionPosition(glm::vec3 landerPos);
 	void stopGame();
 
-	bool inLight;
-
 	ofEasyCam cam;
-	ofxAssimpModelLoader moon, lander;
+	ofxAssimpModelLoader lander;
 	ofLight light, spotlight1, spotlight2, spotlight3, spotlight4, landerLight;
 	Box boundingBox, landerBounds;
 	Box testBox;
 	vector<Box> colBoxList;
 	bool bLanderSelected = false;
-	Octree octree;
 	TreeNode selectedNode;
 	glm::vec3 mouseDownPos, mouseLastPos;
 	bool bInDrag = false;
@@ -75,27 +83,39 @@ public:
 
 	const float selectionRange = 4.0;
 
-	// Lander variables
-	glm::vec3 landerPos = glm::vec3(0, 0, 0);
-	float landerRot = 0;
-
-	glm::vec3 landerVelocity = glm::vec3(0, 0, 0);
-	glm::vec3 landerAcceleration = glm::vec3(0, 0, 0);
-	glm::vec3 landerForce = glm::vec3(0, 0, 0);
-	float landerMass = 1.0;
-	float landerDamping = .99;
-	float landerAngularVelocity = 0;
-	float landerAngularAcceleration = 0;
-	float landerAngularForce = 0;
-
-	// Forces
-	TurbulenceForce* turbForce;
-	GravityForce* gravityForce;
-	ImpulseRadialForce* radialForce;
-
-	std::set<int> keysPressed;
-
-	float distance;
+	// Simulation thread.  Once setup() has started it, everything in this
+	// block belongs to that thread; the main thread only sends it commands
+	// and reads the snapshots and events it publishes (see SimThread.h).
+	//
+	std::thread simThread;
+	std::atomic<bool> simQuit{ false };
+
+	// Lander simulation (physics, collision, fuel and game outcome)
+	LanderSim sim;
+	bool simRunning = false;                        // a game is being simulated
+	bool simTerrainReady = false;                   // ground under the lander is loaded
+	vector<std::shared_ptr<const Octree>> simTerrain;   // keeps the octrees in sim.terrain alive
+	vector<std::shared_ptr<const HeightField>> simHeights;  // and the height fields in simGround
+	GroundHeight simGround;                         // ground for the particles to land on
+	glm::vec3 prevLanderPos = glm::vec3(0, 0, 0);   // state at the previous step, for render interpolation
+	float prevLanderRot = 0;
+
+	// Fixed step simulation clock, sampled once per loop
+	SimClock clock;
+
+	// Recording of the current game, written to data/replay.rec when it ends
+	ReplayLog replayLog;
+
+	// Keys folded in from inputQueue every step
+	KeyState keys;
+
+	// Autopilot ('a').  It flies while on, and plans for up to
+	// autopilotBudgetMs after each batch of steps; any flight key takes
+	// the controls back.
+	Autopilot autopilot;
+	bool autopilotOn = false;
+	bool altitudeOn = true;     // AGL shown ('n'); the sim also measures it while the autopilot flies
+	double autopilotBudgetMs = 4;
 
 	// Particle effects
 	ParticleEmitter thrustEmitter;
@@ -103,28 +123,54 @@ public:
 	ParticleEmitter vortexRingEmitter;
 	ParticleEmitter landingRingEmitter, landingRingEmitter2, landingRingEmitter3;
 
-	bool thrust;
-	bool explosion;
 	bool vortexRing;
 
+	// particle batch (all emitters), captured into each snapshot
+	ParticleBatch particleBatch;
+
+	// events not sent yet because simEvents was full, and games ended so far
+	LanderEvents pendingEvents;
+	uint64_t gamesFinished = 0;
+
+	// Exchange with the simulation thread
+	//
+	InputQueue inputQueue;                          // keys, from the event callbacks
+	SpscQueue<SimCommand, 64> simCommands;
+	SpscQueue<LanderEvents, 256> simEvents;
+	TripleBuffer<SimSnapshot> snapshots;
+
+	// Main thread: the latest snapshot and the terrain last sent to the sim
+	//
+	SimSnapshot *latest = NULL;
+	uint64_t gamesStopped = 0;      // latest->gamesFinished when stopGame() last ran
+	vector<std::shared_ptr<const Octree>> terrainOctrees;
+	bool terrainReady = false;
+
+	string terrainFile;     // .tiles or .obj the terrain came from
+
+	// Forces
+	TurbulenceForce* turbForce;
+	GravityForce* gravityForce;
+	ImpulseRadialForce* radialForce;
+
 	// textures
 	//
 	ofTexture  particleTex;
 
+	// stream buffer for the particles of a snapshot
+	//
+	ParticleRenderer particleRenderer;
+
+	// terrain (streamed tiles, or the whole .obj as one tile) and the view
+	// culling of terrain and particles
+	//
+	TerrainTiles terrainTiles;
+	ViewCuller culler;
+
 	// shaders
 	//
-	ofVbo thrustVbo;
-	ofVbo explosionVbo;
-	ofVbo vortexRingVbo;
-	ofVbo landingRingVbo;
-	ofVbo landingRingVbo2;
-	ofVbo landingRingVbo3;
 	ofShader shader;
 
-	// Fuel
-	float fuelLevel, initialFuel, usedFuel, fuelStart;
-	bool fuel;
-
 	// Camera view state
 	int view;
 	bool fPov = false;
@@ -134,12 +180,6 @@ public:
 
 	// Game state
 	bool gameState;
-	bool gameOver;
-	bool gameComplete;
-	bool gameEnd;
-
-	// Track explosion time
-	float explosionStart;
 
 	// Lander toggle
 	bool bLanderLight;
@@ -148,9 +188,6 @@ public:
 	glm::vec3 landing, landing2, landing3;
 	float landingRadius;
 
-	// Track time of landing completion
-	float landingStart;
-
 	const int groupSize = 50;
 	const int emitRate = 30;
 	const float particleRadius = 15.0f;
@@ -160,4 +197,10 @@ public:
 
 	// AGL toggle
 	bool bAGL = true;
+
+	// culling stats toggle
+	bool bCullStats = false;
+
+	// frame profiler overlay toggle ('g', 'G' writes a trace)
+	bool bProfiler = false;
 };
\ No newline at end of file
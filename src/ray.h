@@ -24,12 +24,6 @@ class Ray {
       sign[1] = (inv_direction.y() < 0);
       sign[2] = (inv_direction.z() < 0);
     }
-    Ray(const Ray &r) {
-      origin = r.origin;
-      direction = r.direction;
-      inv_direction = r.inv_direction;
-      sign[0] = r.sign[0]; sign[1] = r.sign[1]; sign[2] = r.sign[2];
-    }
 
     Vector3 origin;
     Vector3 direction;
@@ -37,4 +31,6 @@ class Ray {
     int sign[3];
 };
 
+static_assert(std::is_trivially_copyable<Ray>::value, "Ray must stay trivially copyable");
+
 #endif // _RAY_H_
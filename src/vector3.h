@@ -2,13 +2,39 @@
 #define _VECTOR3_H_
 
 #include <math.h>
+#include <type_traits>
+#include <utility>
+
+// The components are stored as four floats, 16 byte aligned, so a Vector3
+// is one SSE register (the 4th lane is padding and is ignored).  Vector3 is
+// trivially copyable - arrays of them can be memcpy'd and the compiler
+// keeps them in registers.
+//
+// Any vector type with float x, y, z members (glm::vec3, ofVec3f) converts
+// to a Vector3 implicitly, so Box and Ray take them as they are, and
+// to<V>() converts back:
+//
+//      Box b(glmMin, glmMax);
+//      glm::vec3 c = b.center().to<glm::vec3>();
+//
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VECTOR3_USE_SSE
+#include <emmintrin.h>
+#endif
 
 class Vector3 {
   public:
-    Vector3() { };
-    Vector3(float x, float y, float z) { d[0] = x; d[1] = y; d[2] = z; }
-    Vector3(const Vector3 &v)
-      { d[0] = v.d[0]; d[1] = v.d[1]; d[2] = v.d[2]; }
+    Vector3() = default;
+    Vector3(float x, float y, float z) { d[0] = x; d[1] = y; d[2] = z; d[3] = 0; }
+    template <class V, class = decltype(std::declval<const V &>().z)>
+    Vector3(const V &v) { d[0] = v.x; d[1] = v.y; d[2] = v.z; d[3] = 0; }
+
+    template <class V> V to() const { return V(d[0], d[1], d[2]); }
+
+#ifdef VECTOR3_USE_SSE
+    explicit Vector3(__m128 v) { _mm_store_ps(d, v); }
+    __m128 m128() const { return _mm_load_ps(d); }
+#endif
 
     float x() const { return d[0]; }
     float y() const { return d[1]; }
@@ -33,26 +59,41 @@ class Vector3 {
     // Overloaded operators
     /////////////////////////////////////////////////////////
   
+#ifdef VECTOR3_USE_SSE
+    Vector3 operator+(const Vector3 &op2) const {   // vector addition
+      return Vector3(_mm_add_ps(m128(), op2.m128()));
+    }
+    Vector3 operator-(const Vector3 &op2) const {   // vector subtraction
+      return Vector3(_mm_sub_ps(m128(), op2.m128()));
+    }
+    Vector3 operator*(float s) const {            // scalar multiplication
+      return Vector3(_mm_mul_ps(m128(), _mm_set1_ps(s)));
+    }
+    Vector3 operator/(float s) const {            // scalar division
+      return Vector3(_mm_div_ps(m128(), _mm_set1_ps(s)));
+    }
+#else
     Vector3 operator+(const Vector3 &op2) const {   // vector addition
       return Vector3(d[0] + op2.d[0], d[1] + op2.d[1], d[2] + op2.d[2]);
     }
     Vector3 operator-(const Vector3 &op2) const {   // vector subtraction
       return Vector3(d[0] - op2.d[0], d[1] - op2.d[1], d[2] - op2.d[2]);
     }
-    Vector3 operator-() const {                    // unary minus
-      return Vector3(-d[0], -d[1], -d[2]);
-    }
     Vector3 operator*(float s) const {            // scalar multiplication
       return Vector3(d[0] * s, d[1] * s, d[2] * s);
     }
+    Vector3 operator/(float s) const {            // scalar division
+      return Vector3(d[0] / s, d[1] / s, d[2] / s);
+    }
+#endif
+    Vector3 operator-() const {                    // unary minus
+      return Vector3(-d[0], -d[1], -d[2]);
+    }
     void operator*=(float s) {
       d[0] *= s;
       d[1] *= s;
       d[2] *= s;
     }
-    Vector3 operator/(float s) const {            // scalar division
-      return Vector3(d[0] / s, d[1] / s, d[2] / s);
-    }
     float operator*(const Vector3 &op2) const {   // dot product
       return d[0] * op2.d[0] + d[1] * op2.d[1] + d[2] * op2.d[2];
     }
@@ -74,7 +115,9 @@ class Vector3 {
     }
   
   private:
-    float d[3];
+    alignas(16) float d[4] = {};
 };
 
+static_assert(std::is_trivially_copyable<Vector3>::value, "Vector3 must stay trivially copyable");
+
 #endif // _VECTOR3_H_